@@ -80,6 +80,7 @@ bool AnalyticGrid::getConfigInfo(Configuration* mainConfig,
   kGridsp = mainConfig->getParam(cappi, "zgridsp").toFloat();
 
   // Reset Size of Data Grid
+  allocateGrid();
 
   // Determine what type of analytic storm is desired
   QString sourceString = analyticConfig->getRoot().firstChildElement("source").text();
@@ -291,7 +292,7 @@ void AnalyticGrid::gridWindFieldData()
 	//Message::toScreen("I = "+QString().setNum(i));
 	for(int a = 0; a < 3; a++) {
 	  // zero out all the points
-	  dataGrid[a][i][j][k] = 0;
+	  gridValue(a, i, j, k) = 0;
 	}
 
 	float vx = 0;
@@ -381,12 +382,12 @@ void AnalyticGrid::gridWindFieldData()
 	// Sample in direction of radar
 	if(radR != 0) {
       
-	  dataGrid[1][i][j][k] = -(delRX*vx+delRY*vy)/radR;
-	  //dataGrid[1][i][j][k] = envSpeed*radR/200;
+	  gridValue(1, i, j, k) = -(delRX*vx+delRY*vy)/radR;
+	  //gridValue(1, i, j, k) = envSpeed*radR/200;
      
 	}      	
-	dataGrid[0][i][j][k] = ref;
-	dataGrid[2][i][j][k] = -999;
+	gridValue(0, i, j, k) = ref;
+	gridValue(2, i, j, k) = -999;
 
 	// out << "("<<QString().setNum(i)<<","<<QString().setNum(j)<<")";
 	//out << int (dataGrid[0][i][j]) << " ";
@@ -410,7 +411,7 @@ void AnalyticGrid::gridLambData()
       for(int i = int(iDim) - 1; i >= 0; i--) {
 	for(int a = 0; a < 3; a++) {
 	  // zero out all the points
-	  dataGrid[a][i][j][k] = 0;
+	  gridValue(a, i, j, k) = 0;
 	}
 
 	float vx = 0;
@@ -531,10 +532,10 @@ void AnalyticGrid::gridLambData()
 	// Sample in direction of radar
 	if(radR != 0) {
 	  
-	  dataGrid[1][i][j][k] = -(delRX*vx-delRY*vy)/radR;
+	  gridValue(1, i, j, k) = -(delRX*vx-delRY*vy)/radR;
 	}      	
-	dataGrid[0][i][j][k] = ref;
-	dataGrid[2][i][j][k] = -999;
+	gridValue(0, i, j, k) = ref;
+	gridValue(2, i, j, k) = -999;
 
       }
     } 
@@ -555,7 +556,7 @@ void AnalyticGrid::gridDefFieldData()
       for(int i = int(iDim) - 1; i >= 0; i--) {
 	for(int a = 0; a < 3; a++) {
 	  // zero out all the points
-	  dataGrid[a][i][j][k] = 0;
+	  gridValue(a, i, j, k) = 0;
 	}
 
 	float vx = 0;
@@ -648,10 +649,10 @@ void AnalyticGrid::gridDefFieldData()
 	// Sample in direction of radar
 	if(radR != 0) {
 	  
-	  dataGrid[1][i][j][k] = -(delRX*vx-delRY*vy)/radR;
+	  gridValue(1, i, j, k) = -(delRX*vx-delRY*vy)/radR;
 	}      	
-	dataGrid[0][i][j][k] = ref;
-	dataGrid[2][i][j][k] = -999;
+	gridValue(0, i, j, k) = ref;
+	gridValue(2, i, j, k) = -999;
 
       }
     } 
@@ -771,7 +772,7 @@ void AnalyticGrid::writeAsi()
 			  out << reset << left << fieldNames.at(n) << endl;
 				int line = 0;
 				for (int i = 0; i < int(iDim);  i++){
-				    out << reset << qSetRealNumberPrecision(3) << scientific << qSetFieldWidth(10) << dataGrid[n][i][j][k];
+				    out << reset << qSetRealNumberPrecision(3) << scientific << qSetFieldWidth(10) << gridValue(n, i, j, k);
 					line++;
 					if (line == 8) {
 						out << endl;
@@ -818,12 +819,13 @@ void AnalyticGrid::testRange()
   iGridsp = 1;
   jGridsp = 1;
   kGridsp = 1;
+  allocateGrid();
   for(int i = 0; i < iDim; i++) {
     for(int j = 0; j < jDim; j++) {
       for(int k = 0; k < kDim; k++) {
 	for(int field = 0; field < 3; field++) {
 	  float range = sqrt((i-50)*(i-50)+(j-50)*(j-50)+k*k);
-	  dataGrid[field][i][j][k] = range;
+	  gridValue(field, i, j, k) = range;
 	}
       }
     }
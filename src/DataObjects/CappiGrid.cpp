@@ -14,6 +14,8 @@
 #include <QTextStream>
 #include <QFile>
 #include <QDir>
+#include <QThread>
+#include <QtConcurrent>
 
 CappiGrid::CappiGrid() : GriddedData()
 {
@@ -24,10 +26,23 @@ CappiGrid::CappiGrid() : GriddedData()
     // To make the cappi bigger but still compute it in a reasonable amount of time,
     // skip the reflectivity grid, otherwise set this to true
     gridReflectivity = true;
+
+    refValues = NULL;
+    velValues = NULL;
+    velMean = NULL;
+    foldChanges = NULL;
+    rayExtents = NULL;
+    cressmanRadar = NULL;
+    cressmanGeometry = NULL;
 }
 
 CappiGrid::~CappiGrid()
 {
+    delete[] refValues;
+    delete[] velValues;
+    delete[] velMean;
+    delete[] foldChanges;
+    delete[] rayExtents;
 }
 
 void CappiGrid::setDisplayIndex(QDomElement cappiConfig, float kSpacing) {
@@ -67,6 +82,9 @@ void CappiGrid::gridRadarData(RadarData *radarData, QDomElement cappiConfig,floa
     kGridsp = cappiConfig.firstChildElement("zgridsp").text().toFloat();
 
     setDisplayIndex(cappiConfig, kGridsp);
+
+    // Only allocate what the configured grid needs
+    allocateGrid();
     
     // Should this be get cartesian point? Don't we use the grid spacing
     // in that calculation? -LM 6/11/07
@@ -117,22 +135,27 @@ void CappiGrid::CressmanInterpolation(RadarData *radarData)
     float xRadius = (iGridsp * iGridsp) * (hROI*hROI);
     float yRadius = (jGridsp * jGridsp) * (hROI*hROI);
     float zRadius = (kGridsp * kGridsp) * (vROI*vROI);
-    float RSquare = xRadius + yRadius + zRadius;
-    int maxIplus = (int)(RSquare/iGridsp);
-    int maxJplus = (int)(RSquare/jGridsp);
-    int maxKplus = (int)(RSquare/kGridsp);
-
-    // Initialize weights
-    for (int k = 0; k < int(kDim); k++) {
-        for (int j = 0; j < int(jDim); j++) {
-            for (int i = 0; i < int(iDim); i++) {
-                refValues[i][j][k].sumRef = 0;
-                refValues[i][j][k].weight = 0;
-                velValues[i][j][k].sumVel = 0;
-                velValues[i][j][k].height = 0;
-                velValues[i][j][k].weight = 0;
-            }
-        }
+    RSquare = xRadius + yRadius + zRadius;
+    maxIplus = (int)(RSquare/iGridsp);
+    maxJplus = (int)(RSquare/jGridsp);
+    maxKplus = (int)(RSquare/kGridsp);
+    localArea = 10;
+    cressmanRadar = radarData;
+    cressmanGeometry = radarData->getGateGeometry();
+    cressmanRayExtents();
+
+    // Allocate and initialize weights
+    long numCells = long(gridISize) * gridJSize * gridKSize;
+    delete[] refValues;
+    delete[] velValues;
+    refValues = new goodRef[numCells];
+    velValues = new goodVel[numCells];
+    for (long n = 0; n < numCells; n++) {
+        refValues[n].sumRef = 0;
+        refValues[n].weight = 0;
+        velValues[n].sumVel = 0;
+        velValues[n].height = 0;
+        velValues[n].weight = 0;
     }
 
     // Find the maximum unambiguous range for the volume
@@ -149,43 +172,347 @@ void CappiGrid::CressmanInterpolation(RadarData *radarData)
             maxNyquist = nyquist;
     }
 
+    // The grid is split into slabs of i so that each thread owns the
+    // accumulators it writes to. Every slab sees the gates in the same
+    // order as a single pass would, so the result does not depend on
+    // the number of threads.
+    int numThreads = QThread::idealThreadCount();
+    if (numThreads < 1)
+        numThreads = 1;
+    int numSlabs = 2*numThreads;
+
     // Find good values
-    for (int n = 0; n < radarData->getNumRays(); n++) {
-        Ray* currentRay = radarData->getRay(n);
-        float theta = deg2rad * fmodf((450. - currentRay->getAzimuth()),360.);
-        float phi = deg2rad * (90. - (currentRay->getElevation()));
+    QList<CressmanTile> tiles = makeCressmanTiles(ScatterPass, (int)iDim, numSlabs);
+    QtConcurrent::blockingMap(tiles, &CappiGrid::runCressmanTile);
+
+    //Message::toScreen("# of Reflectivity gates used in CAPPI = "+QString().setNum(r));
+    //Message::toScreen("# of Velocity gates used in CAPPI = "+QString().setNum(v));
+
+    int maxfoldpasses = 1;
+    velMean = new goodMean[numCells];
+    foldChanges = new QVector<FoldChange>[radarData->getNumRays()];
+    for (int foldpass = 0; foldpass < maxfoldpasses; foldpass++) {
+        // Local average of the first guess used to unfold each gate
+        tiles = makeCressmanTiles(LocalMeanPass, (int)iDim, numSlabs);
+        QtConcurrent::blockingMap(tiles, &CappiGrid::runCressmanTile);
+
+        // Unfolding a gate depends on the grid points it has already
+        // been spread to, so record where each gate changes fold first
+        tiles = makeCressmanTiles(FoldPass, radarData->getNumRays(), numSlabs);
+        QtConcurrent::blockingMap(tiles, &CappiGrid::runCressmanTile);
+
+        // Then spread the refolded velocities onto the grid
+        tiles = makeCressmanTiles(FoldScatterPass, (int)iDim, numSlabs);
+        QtConcurrent::blockingMap(tiles, &CappiGrid::runCressmanTile);
+
+        // Finally keep the refolded velocities in the radar data
+        tiles = makeCressmanTiles(UnfoldPass, radarData->getNumRays(), numSlabs);
+        QtConcurrent::blockingMap(tiles, &CappiGrid::runCressmanTile);
+    }
+
+    delete[] foldChanges;
+    delete[] velMean;
+    delete[] refValues;
+    delete[] velValues;
+    delete[] rayExtents;
+    foldChanges = NULL;
+    rayExtents = NULL;
+    velMean = NULL;
+    refValues = NULL;
+    velValues = NULL;
+
+    // Smooth local outliers, each level is independent
+    tiles = makeCressmanTiles(SmoothPass, (int)kDim, numSlabs);
+    QtConcurrent::blockingMap(tiles, &CappiGrid::runCressmanTile);
+    cressmanRadar = NULL;
+    /* Remove global outliers
+ for (int k = 0; k < int(kDim); k++) {
+  // float sumtexture = 0;
+  // float maxtexture = 0;
+  float posCappi = 0;
+  float poscount = 0;
+  float negCappi = 0;
+  float negcount = 0;
+  for (int j = 1; j < int(jDim)-1; j++) {
+   abort = returnExitNow();
+   if(abort){
+    //Message::toScreen("ExitNow in Cressmand Interpolation in CappiGrid");
+    return;
+   }
+   for (int i = 1; i < int(iDim)-1; i++) {
+    if (gridValue(1, i, j, k) != -999) {
+     if (gridValue(1, i, j, k) > 0) {
+      posCappi += gridValue(1, i, j, k);
+      QString pos;
+      poscount++;
+     } else {
+      negCappi += gridValue(1, i, j, k);
+      negcount++;
+     }
+    }
+   }
+  }
+  if (poscount != 0) {
+   posCappi /= poscount;
+   float stdVel = 0;
+   for (int j = 1; j < int(jDim)-1; j++) {
+    abort = returnExitNow();
+    if(abort){
+     //Message::toScreen("ExitNow in Cressmand Interpolation in CappiGrid");
+     return;
+    }
+    for (int i = 1; i < int(iDim)-1; i++) {
+     if ((gridValue(1, i, j, k) != -999) and (gridValue(1, i, j, k) > 0)) {
+      stdVel += (gridValue(1, i, j, k)-posCappi)*
+      (gridValue(1, i, j, k)-posCappi);
+     }
+    }
+   }
+   stdVel = sqrt(stdVel/poscount);
+   for (int j = 1; j < int(jDim)-1; j++) {
+    abort = returnExitNow();
+    if(abort){
+     //Message::toScreen("ExitNow in Cressmand Interpolation in CappiGrid");
+     return;
+    }
+    for (int i = 1; i < int(iDim)-1; i++) {
+     float diffCappi = fabs(gridValue(1, i, j, k) - posCappi);
+     if ((diffCappi > stdVel*2) and (gridValue(1, i, j, k) != -999)
+      and (gridValue(1, i, j, k) > 0)) {
+      gridValue(1, i, j, k) = -999;
+     }
+    }
+   }
+  }
+  if (negcount != 0) {
+   negCappi /= negcount;
+   float stdVel = 0;
+   for (int j = 1; j < int(jDim)-1; j++) {
+    abort = returnExitNow();
+    if(abort){
+     //Message::toScreen("ExitNow in Cressmand Interpolation in CappiGrid");
+     return;
+    }
+    for (int i = 1; i < int(iDim)-1; i++) {
+     if ((gridValue(1, i, j, k) != -999) and (gridValue(1, i, j, k) < 0)) {
+      stdVel += (gridValue(1, i, j, k)-negCappi)*
+      (gridValue(1, i, j, k)-negCappi);
+     }
+    }
+   }
+   stdVel = sqrt(stdVel/negcount);
+   for (int j = 1; j < int(jDim)-1; j++) {
+    abort = returnExitNow();
+    if(abort){
+     //Message::toScreen("ExitNow in Cressmand Interpolation in CappiGrid");
+     return;
+    }
+    for (int i = 1; i < int(iDim)-1; i++) {
+     float diffCappi = fabs(gridValue(1, i, j, k) - negCappi);
+     if ((diffCappi > stdVel*2) and (gridValue(1, i, j, k) != -999)
+      and (gridValue(1, i, j, k) < 0)) {
+      gridValue(1, i, j, k) = -999;
+     }
+    }
+   }
+  }
+ } */
+
+
+}
+
+QList<CappiGrid::CressmanTile> CappiGrid::makeCressmanTiles(CressmanPass pass, int size, int numTiles)
+{
+    QList<CressmanTile> tiles;
+    if (numTiles > size)
+        numTiles = size;
+    for (int t = 0; t < numTiles; t++) {
+        CressmanTile tile;
+        tile.grid = this;
+        tile.pass = pass;
+        tile.begin = (int)((long(size) * t) / numTiles);
+        tile.end = (int)((long(size) * (t + 1)) / numTiles);
+        tiles.append(tile);
+    }
+    return tiles;
+}
+
+void CappiGrid::runCressmanTile(CressmanTile &tile)
+{
+    CappiGrid* grid = tile.grid;
+    switch (tile.pass) {
+    case ScatterPass:
+        grid->cressmanScatter(tile.begin, tile.end);
+        break;
+    case LocalMeanPass:
+        grid->cressmanLocalMean(tile.begin, tile.end);
+        break;
+    case FoldPass:
+        grid->cressmanFold(tile.begin, tile.end);
+        break;
+    case FoldScatterPass:
+        grid->cressmanFoldScatter(tile.begin, tile.end);
+        break;
+    case UnfoldPass:
+        grid->cressmanUnfold(tile.begin, tile.end);
+        break;
+    case SmoothPass:
+        grid->cressmanSmooth(tile.begin, tile.end);
+        break;
+    }
+}
+
+bool CappiGrid::cressmanGateIndex(float range, float sinPhi, float cosTheta, float sinTheta,
+                                  float z, float &i, float &j, float &k)
+{
+    float x = range*sinPhi*cosTheta;
+    if ((x < (xmin - iGridsp)) or x > (xmax + iGridsp)) { return false; }
+    float y = range*sinPhi*sinTheta;
+    if ((y < (ymin - jGridsp)) or y > (ymax + jGridsp)) { return false; }
+    if ((z < (zmin - kGridsp)) or z > (zmax + kGridsp)) { return false; }
+
+    // Looks like a good point, find its closest Cartesian index
+    i = (x - xmin)/iGridsp;
+    j = (y - ymin)/jGridsp;
+    k = (z - zmin)/kGridsp;
+    return true;
+}
+
+bool CappiGrid::cressmanSlabRange(float i, int iBegin, int iEnd, int &iplusMin, int &iplusMax)
+{
+    // Offsets that can truncate into [iBegin, iEnd). This is a superset,
+    // the exact test is still done on each index.
+    iplusMin = -maxIplus;
+    iplusMax = maxIplus;
+    int lower = (int)floorf(iBegin - 1 - i);
+    int upper = (int)ceilf(iEnd + 1 - i);
+    if (lower > iplusMin)
+        iplusMin = lower;
+    if (upper < iplusMax)
+        iplusMax = upper;
+    return (iplusMin <= iplusMax);
+}
+
+void CappiGrid::cressmanRayExtents()
+{
+    // One pass over the gate heights, instead of every slab pass walking
+    // every gate of the rays that fall outside it
+    int numRays = cressmanRadar->getNumRays();
+    delete[] rayExtents;
+    rayExtents = new RayExtent[numRays];
+    for (int n = 0; n < numRays; n++) {
+        Ray* currentRay = cressmanRadar->getRay(n);
+        float sinPhi = cressmanGeometry->getSinPhi(n);
+        float cosTheta = cressmanGeometry->getCosTheta(n);
+        cressmanGateExtent(currentRay->getRef_numgates(), currentRay->getFirst_ref_gate(),
+                           currentRay->getRef_gatesp(), cressmanGeometry->getRefHeight(n),
+                           sinPhi, cosTheta, rayExtents[n].refILow, rayExtents[n].refIHigh);
+        cressmanGateExtent(currentRay->getVel_numgates(), currentRay->getFirst_vel_gate(),
+                           currentRay->getVel_gatesp(), cressmanGeometry->getVelHeight(n),
+                           sinPhi, cosTheta, rayExtents[n].velILow, rayExtents[n].velIHigh);
+    }
+}
+
+void CappiGrid::cressmanGateExtent(int numGates, int firstGate, float gateSpacing,
+                                   const float* height, float sinPhi, float cosTheta,
+                                   float &iLow, float &iHigh)
+{
+    iLow = 1;
+    iHigh = 0;
+    if (numGates <= 0)
+        return;
+
+    float zLow = height[0];
+    float zHigh = height[0];
+    for (int g = 1; g < numGates; g++) {
+        if (height[g] < zLow)
+            zLow = height[g];
+        if (height[g] > zHigh)
+            zHigh = height[g];
+    }
+    if ((zHigh < (zmin - kGridsp)) or (zLow > (zmax + kGridsp)))
+        return;
+
+    // x only grows or shrinks along the ray, so the first and last gates
+    // bound every i the ray can have. Same arithmetic as cressmanGateIndex.
+    float firstRange = float(firstGate)/1000.;
+    float lastRange = float(firstGate + ((numGates - 1) * gateSpacing))/1000.;
+    float xFirst = firstRange*sinPhi*cosTheta;
+    float xLast = lastRange*sinPhi*cosTheta;
+    float iFirst = (xFirst - xmin)/iGridsp;
+    float iLast = (xLast - xmin)/iGridsp;
+    iLow = (iFirst < iLast) ? iFirst : iLast;
+    iHigh = (iFirst < iLast) ? iLast : iFirst;
+}
+
+bool CappiGrid::cressmanRayReaches(float iLow, float iHigh, int iBegin, int iEnd)
+{
+    // cressmanSlabRange rejects every gate with i <= iBegin - 2 - maxIplus
+    // or i >= iEnd + 2 + maxIplus
+    if (iLow > iHigh)
+        return false;
+    if (iHigh <= (iBegin - 2 - maxIplus))
+        return false;
+    if (iLow >= (iEnd + 2 + maxIplus))
+        return false;
+    return true;
+}
+
+float CappiGrid::unfoldVelocity(float vel, float nyquist, long cell)
+{
+    // Compare against the local average of the first guess and pick the
+    // fold that brings the gate closest to it
+    int minfold = 0;
+    if (velMean[cell].count != 0) { // Need at least one seed from the higher nyquist, otherwise use original
+        float velDiff = vel - velMean[cell].avg;
+        if (fabs(velDiff) > nyquist) {
+            // Potential folding problem
+            float mindiff = 999999;
+            for (int fold=-2; fold <=2; fold++) {
+                velDiff = vel+2*fold*nyquist - velMean[cell].avg;
+                if (fabs(velDiff) < mindiff) {
+                    mindiff = fabs(velDiff);
+                    minfold = fold;
+                }
+            }
+        }
+    }
+    return vel + 2*minfold*nyquist;
+}
+
+void CappiGrid::cressmanScatter(int iBegin, int iEnd)
+{
+    for (int n = 0; n < cressmanRadar->getNumRays(); n++) {
+        Ray* currentRay = cressmanRadar->getRay(n);
+        float sinPhi = cressmanGeometry->getSinPhi(n);
+        float cosTheta = cressmanGeometry->getCosTheta(n);
+        float sinTheta = cressmanGeometry->getSinTheta(n);
 
         if ((currentRay->getRef_numgates() > 0) and
-                (gridReflectivity)) {
+                (gridReflectivity) and
+                cressmanRayReaches(rayExtents[n].refILow, rayExtents[n].refIHigh, iBegin, iEnd)) {
 
-            float* refData = currentRay->getRefData();
+            const float* refHeight = cressmanGeometry->getRefHeight(n);
             for (int g = 0; g <= (currentRay->getRef_numgates()-1); g++) {
-                if (refData[g] == -999.) { continue; }
+                float ref = currentRay->getRef(g);
+                if (ref == -999.) { continue; }
                 float range = float(currentRay->getFirst_ref_gate() +
                                     (g * currentRay->getRef_gatesp()))/1000.;
 
-                float x = range*sin(phi)*cos(theta);
-                if ((x < (xmin - iGridsp)) or x > (xmax + iGridsp)) { continue; }
-                float y = range*sin(phi)*sin(theta);
-                if ((y < (ymin - jGridsp)) or y > (ymax + jGridsp)) { continue; }
-                float z = radarData->radarBeamHeight(range,
-                                                     currentRay->getElevation() );
-                if ((z < (zmin - kGridsp)) or z > (zmax + kGridsp)) { continue; }
-
-                // Looks like a good point, find its closest Cartesian index
-                float i = (x - xmin)/iGridsp;
-                float j = (y - ymin)/jGridsp;
-                float k = (z - zmin)/kGridsp;
+                float i, j, k;
+                if (!cressmanGateIndex(range, sinPhi, cosTheta, sinTheta, refHeight[g], i, j, k)) { continue; }
+                int iplusMin, iplusMax;
+                if (!cressmanSlabRange(i, iBegin, iEnd, iplusMin, iplusMax)) { continue; }
                 float RSquareLinear = RSquare*range*range / 30276.0;
                 for (int kplus = -maxKplus; kplus <= maxKplus; kplus++) {
                 for (int jplus = -maxJplus; jplus <= maxJplus; jplus++) {
-                    for (int iplus = -maxIplus; iplus <= maxIplus; iplus++) {
+                    for (int iplus = iplusMin; iplus <= iplusMax; iplus++) {
                         int iIndex = (int)(i+iplus);
                         int jIndex = (int)(j+jplus);
                         int kIndex = (int)(k+kplus);
-                        if ((iIndex < 0) or (iIndex > (int)iDim)) { continue; }
-                        if ((jIndex < 0) or (jIndex > (int)jDim)) { continue; }
-                        if ((kIndex < 0) or (kIndex > (int)kDim)) { continue; }
+                        if ((iIndex < iBegin) or (iIndex >= iEnd)) { continue; }
+                        if ((jIndex < 0) or (jIndex >= (int)jDim)) { continue; }
+                        if ((kIndex < 0) or (kIndex >= (int)kDim)) { continue; }
 
                         float dx = (i - (int)(i+iplus))*iGridsp;
                         float dy = (j - (int)(j+jplus))*jGridsp;
@@ -193,46 +520,40 @@ void CappiGrid::CressmanInterpolation(RadarData *radarData)
                         float rSquare = (dx*dx) + (dy*dy) + (dz*dz);
                         if (rSquare > RSquareLinear) { continue; }
                         float weight = (RSquareLinear - rSquare) / (RSquareLinear + rSquare);
-                        refValues[iIndex][jIndex][kIndex].weight += weight;
-                        refValues[iIndex][jIndex][kIndex].sumRef += weight*refData[g];
+                        refValues[cellIndex(iIndex, jIndex, kIndex)].weight += weight;
+                        refValues[cellIndex(iIndex, jIndex, kIndex)].sumRef += weight*ref;
                     }
                 }
                 }
             }
 
         }
-        if (currentRay->getVel_numgates() > 0) {
+        if ((currentRay->getVel_numgates() > 0) and
+                cressmanRayReaches(rayExtents[n].velILow, rayExtents[n].velIHigh, iBegin, iEnd)) {
                 // Just grab the lowest elevation sweeps
                 //and (currentRay->getElevation() < 0.75)) {
                 //and (fabs(currentRay->getNyquist_vel() - maxNyquist) < 0.1)) {
             float* velData = currentRay->getVelData();
-            float* swData = currentRay->getSwData();
+            const float* velHeight = cressmanGeometry->getVelHeight(n);
             float nyquist = currentRay->getNyquist_vel();
             for (int g = 0; g <= (currentRay->getVel_numgates()-1); g++) {
                 if (velData[g] == -999.) { continue; }
 
                 float range = float(currentRay->getFirst_vel_gate() +
                                     (g * currentRay->getVel_gatesp()))/1000.;
-                float x = range*sin(phi)*cos(theta);
-                if ((x < (xmin - iGridsp)) or x > (xmax + iGridsp)) { continue; }
-                float y = range*sin(phi)*sin(theta);
-                if ((y < (ymin - jGridsp)) or y > (ymax + jGridsp)) { continue; }
-                float z = radarData->radarBeamHeight(range,
-                                                     currentRay->getElevation() );
-                if ((z < (zmin - kGridsp)) or z > (zmax + kGridsp)) { continue; }
-
-                // Looks like a good point, find its closest Cartesian index
-                float i = (x - xmin)/iGridsp;
-                float j = (y - ymin)/jGridsp;
-                float k = (z - zmin)/kGridsp;
+                float i, j, k;
+                float z = velHeight[g];
+                if (!cressmanGateIndex(range, sinPhi, cosTheta, sinTheta, z, i, j, k)) { continue; }
+                int iplusMin, iplusMax;
+                if (!cressmanSlabRange(i, iBegin, iEnd, iplusMin, iplusMax)) { continue; }
                 float RSquareLinear = RSquare; //* range*range / 30276.0;
                 for (int kplus = -maxKplus; kplus <= maxKplus; kplus++) {
                 for (int jplus = -maxJplus; jplus <= maxJplus; jplus++) {
-                    for (int iplus = -maxIplus; iplus <= maxIplus; iplus++) {
+                    for (int iplus = iplusMin; iplus <= iplusMax; iplus++) {
                         int iIndex = (int)(i+iplus);
                         int jIndex = (int)(j+jplus);
                         int kIndex = (int)(k+kplus);
-                        if ((iIndex < 0) or (iIndex >= (int)iDim)) { continue; }
+                        if ((iIndex < iBegin) or (iIndex >= iEnd)) { continue; }
                         if ((jIndex < 0) or (jIndex >= (int)jDim)) { continue; }
                         if ((kIndex < 0) or (kIndex >= (int)kDim)) { continue; }
 
@@ -242,161 +563,220 @@ void CappiGrid::CressmanInterpolation(RadarData *radarData)
                         float rSquare = (dx*dx) + (dy*dy) + (dz*dz);
                         if (rSquare > RSquareLinear) { continue; }
                         float weight = (100*nyquist) *(RSquareLinear - rSquare) / (RSquareLinear + rSquare);
-                        velValues[iIndex][jIndex][kIndex].weight += weight;
-                        velValues[iIndex][jIndex][kIndex].sumVel += weight*velData[g];
-                        velValues[iIndex][jIndex][kIndex].height += weight*z;
+                        velValues[cellIndex(iIndex, jIndex, kIndex)].weight += weight;
+                        velValues[cellIndex(iIndex, jIndex, kIndex)].sumVel += weight*velData[g];
+                        velValues[cellIndex(iIndex, jIndex, kIndex)].height += weight*z;
                     }
                 }
                 }
             }
-
-            velData = NULL;
-            swData = NULL;
-            //delete velData;
-            //delete swData;
         }
-        currentRay = NULL;
-        //delete currentRay;
     }
 
-    //Message::toScreen("# of Reflectivity gates used in CAPPI = "+QString().setNum(r));
-    //Message::toScreen("# of Velocity gates used in CAPPI = "+QString().setNum(v));
-
-    for (int k = 0; k < int(kDim); k++) {
+    // The slab is complete, fill in its grid points
+    for (int i = iBegin; i < iEnd; i++) {
         for (int j = 0; j < int(jDim); j++) {
-            for (int i = 0; i < int(iDim); i++) {
-
-                dataGrid[0][i][j][k] = -999;
-                dataGrid[1][i][j][k] = -999;
-                dataGrid[2][i][j][k] = -999;
-
-                if (refValues[i][j][k].weight > 0) {
-                    dataGrid[0][i][j][k] = refValues[i][j][k].sumRef/refValues[i][j][k].weight;
+            for (int k = 0; k < int(kDim); k++) {
+                long cell = cellIndex(i, j, k);
+                gridValue(0, i, j, k) = -999;
+                gridValue(1, i, j, k) = -999;
+                gridValue(2, i, j, k) = -999;
+
+                if (refValues[cell].weight > 0) {
+                    gridValue(0, i, j, k) = refValues[cell].sumRef/refValues[cell].weight;
                 }
-                if (velValues[i][j][k].weight > 0) {
-                    dataGrid[1][i][j][k] = velValues[i][j][k].sumVel/velValues[i][j][k].weight;
-                    dataGrid[2][i][j][k] = velValues[i][j][k].height/velValues[i][j][k].weight;
+                if (velValues[cell].weight > 0) {
+                    gridValue(1, i, j, k) = velValues[cell].sumVel/velValues[cell].weight;
+                    gridValue(2, i, j, k) = velValues[cell].height/velValues[cell].weight;
                 }
-                velValues[i][j][k].sumVel = 0;
-                velValues[i][j][k].height = 0;
-                velValues[i][j][k].weight = 0;
+                velValues[cell].sumVel = 0;
+                velValues[cell].height = 0;
+                velValues[cell].weight = 0;
             }
         }
     }
+}
 
-    int maxfoldpasses = 1;
-    int localArea = 10;
-    for (int foldpass = 0; foldpass < maxfoldpasses; foldpass++) {
-        // Find good values
-        for (int n = 0; n < radarData->getNumRays(); n++) {
-            Ray* currentRay = radarData->getRay(n);
-            float theta = deg2rad * fmodf((450. - currentRay->getAzimuth()),360.);
-            float phi = deg2rad * (90. - (currentRay->getElevation()));
-
-            if ((currentRay->getVel_numgates() > 0)) {
-                    // Just grab the lowest elevation sweeps & try to adjust bad folds
-                    //and (currentRay->getElevation() < 0.75)) {
-                float* velData = currentRay->getVelData();
-                float* swData = currentRay->getSwData();
-                float nyquist = currentRay->getNyquist_vel();
-                for (int g = 0; g <= (currentRay->getVel_numgates()-1); g++) {
-                    if (velData[g] == -999.) { continue; }
-
-                    float range = float(currentRay->getFirst_vel_gate() +
-                                        (g * currentRay->getVel_gatesp()))/1000.;
-                    float x = range*sin(phi)*cos(theta);
-                    if ((x < (xmin - iGridsp)) or x > (xmax + iGridsp)) { continue; }
-                    float y = range*sin(phi)*sin(theta);
-                    if ((y < (ymin - jGridsp)) or y > (ymax + jGridsp)) { continue; }
-                    float z = radarData->radarBeamHeight(range,
-                                                         currentRay->getElevation() );
-                    if ((z < (zmin - kGridsp)) or z > (zmax + kGridsp)) { continue; }
-
-                    // Looks like a good point, find its closest Cartesian index
-                    float i = (x - xmin)/iGridsp;
-                    float j = (y - ymin)/jGridsp;
-                    float k = (z - zmin)/kGridsp;
-                    float RSquareLinear = RSquare; //* range*range / 30276.0;
-                    for (int kplus = -maxKplus; kplus <= maxKplus; kplus++) {
-                    for (int jplus = -maxJplus; jplus <= maxJplus; jplus++) {
-                        for (int iplus = -maxIplus; iplus <= maxIplus; iplus++) {
-                            int iIndex = (int)(i+iplus);
-                            int jIndex = (int)(j+jplus);
-                            int kIndex = (int)(k+kplus);
-                            if ((iIndex < 0) or (iIndex >= (int)iDim)) { continue; }
-                            if ((jIndex < 0) or (jIndex >= (int)jDim)) { continue; }
-                            if ((kIndex < 0) or (kIndex >= (int)kDim)) { continue; }
-
-                            float dx = (i - (int)(i+iplus))*iGridsp;
-                            float dy = (j - (int)(j+jplus))*jGridsp;
-                            float dz = (k - (int)(k+kplus))*kGridsp;
-                            float rSquare = (dx*dx) + (dy*dy) + (dz*dz);
-                            if (rSquare > RSquareLinear) { continue; }
-                            float avgCappi = 0;
-                            float quadcount = 0;
-                            for (int quadi = iIndex-localArea; quadi <= iIndex+localArea; quadi++) {
-                                for (int quadj = jIndex-localArea; quadj <= jIndex+localArea; quadj++) {
-                                    if ((quadi < 0) or (quadi >= (int)iDim)) { continue; }
-                                    if ((quadj < 0) or (quadj >= (int)jDim)) { continue; }
-                                    if (dataGrid[1][quadi][quadj][kIndex] != -999) {
-                                        avgCappi += dataGrid[1][quadi][quadj][kIndex];
-                                        quadcount++;
-                                    }
-                                }
-                            }
-                            int minfold = 0;
-                            if (quadcount != 0) { // Need at least one seed from the higher nyquist, otherwise use original
-                                avgCappi /= quadcount;
-                                float velDiff = velData[g] - avgCappi;
-                                if (fabs(velDiff) > nyquist) {
-                                    // Potential folding problem
-                                    float mindiff = 999999;
-                                    for (int fold=-2; fold <=2; fold++) {
-                                        velDiff = velData[g]+2*fold*nyquist - avgCappi;
-                                        if (fabs(velDiff) < mindiff) {
-                                            mindiff = fabs(velDiff);
-                                            minfold = fold;
-                                        }
-                                    }
-                                }
-                            }
-                            velData[g] += 2*minfold*nyquist;
-                            float newVel = velData[g];
-                            float weight = (100*nyquist) * (RSquareLinear - rSquare) / (RSquareLinear + rSquare);
-                            velValues[iIndex][jIndex][kIndex].weight += weight;
-                            velValues[iIndex][jIndex][kIndex].sumVel += weight*newVel;
+void CappiGrid::cressmanLocalMean(int iBegin, int iEnd)
+{
+    for (int iIndex = iBegin; iIndex < iEnd; iIndex++) {
+        for (int jIndex = 0; jIndex < int(jDim); jIndex++) {
+            for (int kIndex = 0; kIndex < int(kDim); kIndex++) {
+                float avgCappi = 0;
+                float quadcount = 0;
+                for (int quadi = iIndex-localArea; quadi <= iIndex+localArea; quadi++) {
+                    for (int quadj = jIndex-localArea; quadj <= jIndex+localArea; quadj++) {
+                        if ((quadi < 0) or (quadi >= (int)iDim)) { continue; }
+                        if ((quadj < 0) or (quadj >= (int)jDim)) { continue; }
+                        if (gridValue(1, quadi, quadj, kIndex) != -999) {
+                            avgCappi += gridValue(1, quadi, quadj, kIndex);
+                            quadcount++;
                         }
                     }
-                    }
                 }
+                if (quadcount != 0)
+                    avgCappi /= quadcount;
+                velMean[cellIndex(iIndex, jIndex, kIndex)].avg = avgCappi;
+                velMean[cellIndex(iIndex, jIndex, kIndex)].count = quadcount;
+            }
+        }
+    }
+}
+
+void CappiGrid::cressmanFold(int rayBegin, int rayEnd)
+{
+    // Try to adjust bad folds. Each grid point a gate is spread to can
+    // refold it, so walk the whole radius of influence in order and keep
+    // the places where the velocity changed.
+    for (int n = rayBegin; n < rayEnd; n++) {
+        foldChanges[n].clear();
+        Ray* currentRay = cressmanRadar->getRay(n);
+        float sinPhi = cressmanGeometry->getSinPhi(n);
+        float cosTheta = cressmanGeometry->getCosTheta(n);
+        float sinTheta = cressmanGeometry->getSinTheta(n);
+
+        if ((currentRay->getVel_numgates() > 0)) {
+                // Just grab the lowest elevation sweeps & try to adjust bad folds
+                //and (currentRay->getElevation() < 0.75)) {
+            float* velData = currentRay->getVelData();
+            const float* velHeight = cressmanGeometry->getVelHeight(n);
+            float nyquist = currentRay->getNyquist_vel();
+            for (int g = 0; g <= (currentRay->getVel_numgates()-1); g++) {
+                if (velData[g] == -999.) { continue; }
+
+                float range = float(currentRay->getFirst_vel_gate() +
+                                    (g * currentRay->getVel_gatesp()))/1000.;
+                float i, j, k;
+                float z = velHeight[g];
+                if (!cressmanGateIndex(range, sinPhi, cosTheta, sinTheta, z, i, j, k)) { continue; }
+                float RSquareLinear = RSquare; //* range*range / 30276.0;
+                float newVel = velData[g];
+                int position = 0;
+                for (int kplus = -maxKplus; kplus <= maxKplus; kplus++) {
+                for (int jplus = -maxJplus; jplus <= maxJplus; jplus++) {
+                    for (int iplus = -maxIplus; iplus <= maxIplus; iplus++, position++) {
+                        int iIndex = (int)(i+iplus);
+                        int jIndex = (int)(j+jplus);
+                        int kIndex = (int)(k+kplus);
+                        if ((iIndex < 0) or (iIndex >= (int)iDim)) { continue; }
+                        if ((jIndex < 0) or (jIndex >= (int)jDim)) { continue; }
+                        if ((kIndex < 0) or (kIndex >= (int)kDim)) { continue; }
 
-                velData = NULL;
-                swData = NULL;
-                //delete velData;
-                //delete swData;
+                        float dx = (i - (int)(i+iplus))*iGridsp;
+                        float dy = (j - (int)(j+jplus))*jGridsp;
+                        float dz = (k - (int)(k+kplus))*kGridsp;
+                        float rSquare = (dx*dx) + (dy*dy) + (dz*dz);
+                        if (rSquare > RSquareLinear) { continue; }
+                        float foldVel = unfoldVelocity(newVel, nyquist, cellIndex(iIndex, jIndex, kIndex));
+                        if (foldVel != newVel) {
+                            newVel = foldVel;
+                            FoldChange change;
+                            change.gate = g;
+                            change.position = position;
+                            change.vel = newVel;
+                            foldChanges[n].append(change);
+                        }
+                    }
+                }
+                }
             }
-            currentRay = NULL;
-            //delete currentRay;
         }
+    }
+}
 
+void CappiGrid::cressmanFoldScatter(int iBegin, int iEnd)
+{
+    for (int n = 0; n < cressmanRadar->getNumRays(); n++) {
+        Ray* currentRay = cressmanRadar->getRay(n);
+        float sinPhi = cressmanGeometry->getSinPhi(n);
+        float cosTheta = cressmanGeometry->getCosTheta(n);
+        float sinTheta = cressmanGeometry->getSinTheta(n);
+
+        if ((currentRay->getVel_numgates() > 0) and
+                cressmanRayReaches(rayExtents[n].velILow, rayExtents[n].velIHigh, iBegin, iEnd)) {
+            float* velData = currentRay->getVelData();
+            const float* velHeight = cressmanGeometry->getVelHeight(n);
+            float nyquist = currentRay->getNyquist_vel();
+            const QVector<FoldChange>& changes = foldChanges[n];
+            int c = 0;
+            for (int g = 0; g <= (currentRay->getVel_numgates()-1); g++) {
+                // Changes are stored in gate order
+                while ((c < changes.size()) and (changes[c].gate < g))
+                    c++;
+                if (velData[g] == -999.) { continue; }
 
+                float range = float(currentRay->getFirst_vel_gate() +
+                                    (g * currentRay->getVel_gatesp()))/1000.;
+                float i, j, k;
+                float z = velHeight[g];
+                if (!cressmanGateIndex(range, sinPhi, cosTheta, sinTheta, z, i, j, k)) { continue; }
+                int iplusMin, iplusMax;
+                if (!cressmanSlabRange(i, iBegin, iEnd, iplusMin, iplusMax)) { continue; }
+                float RSquareLinear = RSquare; //* range*range / 30276.0;
+                int rowLength = 2*maxIplus + 1;
+                int gateChange = c;
+                float newVel = velData[g];
+                for (int kplus = -maxKplus; kplus <= maxKplus; kplus++) {
+                for (int jplus = -maxJplus; jplus <= maxJplus; jplus++) {
+                    int rowPosition = ((kplus + maxKplus)*(2*maxJplus + 1) + (jplus + maxJplus))*rowLength;
+                    for (int iplus = iplusMin; iplus <= iplusMax; iplus++) {
+                        int position = rowPosition + iplus + maxIplus;
+                        while ((gateChange < changes.size()) and (changes[gateChange].gate == g)
+                               and (changes[gateChange].position <= position)) {
+                            newVel = changes[gateChange].vel;
+                            gateChange++;
+                        }
+                        int iIndex = (int)(i+iplus);
+                        int jIndex = (int)(j+jplus);
+                        int kIndex = (int)(k+kplus);
+                        if ((iIndex < iBegin) or (iIndex >= iEnd)) { continue; }
+                        if ((jIndex < 0) or (jIndex >= (int)jDim)) { continue; }
+                        if ((kIndex < 0) or (kIndex >= (int)kDim)) { continue; }
 
-        for (int k = 0; k < int(kDim); k++) {
-            for (int j = 0; j < int(jDim); j++) {
-                for (int i = 0; i < int(iDim); i++) {
-                    dataGrid[1][i][j][k] = -999;
-                    if (velValues[i][j][k].weight > 0) {
-                        dataGrid[1][i][j][k] = velValues[i][j][k].sumVel/velValues[i][j][k].weight;
+                        float dx = (i - (int)(i+iplus))*iGridsp;
+                        float dy = (j - (int)(j+jplus))*jGridsp;
+                        float dz = (k - (int)(k+kplus))*kGridsp;
+                        float rSquare = (dx*dx) + (dy*dy) + (dz*dz);
+                        if (rSquare > RSquareLinear) { continue; }
+                        float weight = (100*nyquist) * (RSquareLinear - rSquare) / (RSquareLinear + rSquare);
+                        velValues[cellIndex(iIndex, jIndex, kIndex)].weight += weight;
+                        velValues[cellIndex(iIndex, jIndex, kIndex)].sumVel += weight*newVel;
                     }
-                    velValues[i][j][k].sumVel = 0;
-                    velValues[i][j][k].weight = 0;
+                }
                 }
             }
         }
     }
 
-    // Smooth local outliers
-    for (int k = 0; k < int(kDim); k++) {
+    for (int i = iBegin; i < iEnd; i++) {
+        for (int j = 0; j < int(jDim); j++) {
+            for (int k = 0; k < int(kDim); k++) {
+                long cell = cellIndex(i, j, k);
+                gridValue(1, i, j, k) = -999;
+                if (velValues[cell].weight > 0) {
+                    gridValue(1, i, j, k) = velValues[cell].sumVel/velValues[cell].weight;
+                }
+                velValues[cell].sumVel = 0;
+                velValues[cell].weight = 0;
+            }
+        }
+    }
+}
+
+void CappiGrid::cressmanUnfold(int rayBegin, int rayEnd)
+{
+    // The last change for each gate is its refolded velocity
+    for (int n = rayBegin; n < rayEnd; n++) {
+        float* velData = cressmanRadar->getRay(n)->getVelData();
+        const QVector<FoldChange>& changes = foldChanges[n];
+        for (int c = 0; c < changes.size(); c++)
+            velData[changes[c].gate] = changes[c].vel;
+    }
+}
+
+void CappiGrid::cressmanSmooth(int kBegin, int kEnd)
+{
+    for (int k = kBegin; k < kEnd; k++) {
         // float sumtexture = 0;
         // float maxtexture = 0;
         for (int j = 1; j < int(jDim)-1; j++) {
@@ -407,8 +787,8 @@ void CappiGrid::CressmanInterpolation(RadarData *radarData)
                     for (int quadj = j-localArea; quadj <= j+localArea; quadj++) {
                         if ((quadi < 0) or (quadi >= (int)iDim)) { continue; }
                         if ((quadj < 0) or (quadj >= (int)jDim)) { continue; }
-                        if (dataGrid[1][quadi][quadj][k] != -999) {
-                            avgCappi += dataGrid[1][quadi][quadj][k];
+                        if (gridValue(1, quadi, quadj, k) != -999) {
+                            avgCappi += gridValue(1, quadi, quadj, k);
                             quadcount++;
                         }
                     }
@@ -420,116 +800,21 @@ void CappiGrid::CressmanInterpolation(RadarData *radarData)
                         for (int quadj = j-localArea; quadj <= j+localArea; quadj++) {
                             if ((quadi < 0) or (quadi >= (int)iDim)) { continue; }
                             if ((quadj < 0) or (quadj >= (int)jDim)) { continue; }
-                            if (dataGrid[1][quadi][quadj][k] != -999) {
-                                stdVel += (dataGrid[1][quadi][quadj][k]-avgCappi)*
-                                        (dataGrid[1][quadi][quadj][k]-avgCappi);
+                            if (gridValue(1, quadi, quadj, k) != -999) {
+                                stdVel += (gridValue(1, quadi, quadj, k)-avgCappi)*
+                                        (gridValue(1, quadi, quadj, k)-avgCappi);
                             }
                         }
                     }
                     stdVel = sqrt(stdVel/quadcount);
-                    float diffCappi = fabs(dataGrid[1][i][j][k] - avgCappi);
-                    if ((diffCappi > stdVel*2) and (dataGrid[1][i][j][k] != -999)) {
-                        dataGrid[1][i][j][k] =avgCappi;
+                    float diffCappi = fabs(gridValue(1, i, j, k) - avgCappi);
+                    if ((diffCappi > stdVel*2) and (gridValue(1, i, j, k) != -999)) {
+                        gridValue(1, i, j, k) =avgCappi;
                     }
                 }
             }
         }
     }
-
-    /* Remove global outliers
- for (int k = 0; k < int(kDim); k++) {
-  // float sumtexture = 0;
-  // float maxtexture = 0;
-  float posCappi = 0;
-  float poscount = 0;
-  float negCappi = 0;
-  float negcount = 0;
-  for (int j = 1; j < int(jDim)-1; j++) {
-   abort = returnExitNow();
-   if(abort){
-    //Message::toScreen("ExitNow in Cressmand Interpolation in CappiGrid");
-    return;
-   }
-   for (int i = 1; i < int(iDim)-1; i++) {
-    if (dataGrid[1][i][j][k] != -999) {
-     if (dataGrid[1][i][j][k] > 0) {
-      posCappi += dataGrid[1][i][j][k];
-      QString pos;
-      poscount++;
-     } else {
-      negCappi += dataGrid[1][i][j][k];
-      negcount++;
-     }
-    }
-   }
-  }
-  if (poscount != 0) {
-   posCappi /= poscount;
-   float stdVel = 0;
-   for (int j = 1; j < int(jDim)-1; j++) {
-    abort = returnExitNow();
-    if(abort){
-     //Message::toScreen("ExitNow in Cressmand Interpolation in CappiGrid");
-     return;
-    }
-    for (int i = 1; i < int(iDim)-1; i++) {
-     if ((dataGrid[1][i][j][k] != -999) and (dataGrid[1][i][j][k] > 0)) {
-      stdVel += (dataGrid[1][i][j][k]-posCappi)*
-      (dataGrid[1][i][j][k]-posCappi);
-     }
-    }
-   }
-   stdVel = sqrt(stdVel/poscount);
-   for (int j = 1; j < int(jDim)-1; j++) {
-    abort = returnExitNow();
-    if(abort){
-     //Message::toScreen("ExitNow in Cressmand Interpolation in CappiGrid");
-     return;
-    }
-    for (int i = 1; i < int(iDim)-1; i++) {
-     float diffCappi = fabs(dataGrid[1][i][j][k] - posCappi);
-     if ((diffCappi > stdVel*2) and (dataGrid[1][i][j][k] != -999)
-      and (dataGrid[1][i][j][k] > 0)) {
-      dataGrid[1][i][j][k] = -999;
-     }
-    }
-   }
-  }
-  if (negcount != 0) {
-   negCappi /= negcount;
-   float stdVel = 0;
-   for (int j = 1; j < int(jDim)-1; j++) {
-    abort = returnExitNow();
-    if(abort){
-     //Message::toScreen("ExitNow in Cressmand Interpolation in CappiGrid");
-     return;
-    }
-    for (int i = 1; i < int(iDim)-1; i++) {
-     if ((dataGrid[1][i][j][k] != -999) and (dataGrid[1][i][j][k] < 0)) {
-      stdVel += (dataGrid[1][i][j][k]-negCappi)*
-      (dataGrid[1][i][j][k]-negCappi);
-     }
-    }
-   }
-   stdVel = sqrt(stdVel/negcount);
-   for (int j = 1; j < int(jDim)-1; j++) {
-    abort = returnExitNow();
-    if(abort){
-     //Message::toScreen("ExitNow in Cressmand Interpolation in CappiGrid");
-     return;
-    }
-    for (int i = 1; i < int(iDim)-1; i++) {
-     float diffCappi = fabs(dataGrid[1][i][j][k] - negCappi);
-     if ((diffCappi > stdVel*2) and (dataGrid[1][i][j][k] != -999)
-      and (dataGrid[1][i][j][k] < 0)) {
-      dataGrid[1][i][j][k] = -999;
-     }
-    }
-   }
-  }
- } */
-
-
 }
 
 // TODO
@@ -660,6 +945,8 @@ void CappiGrid::loadPreGridded(RadarData *radarData, QDomElement cappiConfig)
     std::cerr << "Can't get z0 array from file" << std::endl;
 
   setDisplayIndex(cappiConfig, kGridsp);
+
+  allocateGrid();
   
   // TODO: Some debug stuff
   // std::cout << "x0: " << iDim << ", y0: " << jDim << ", z0: " << kDim << std::endl;
@@ -776,17 +1063,17 @@ void CappiGrid::loadPreGridded(RadarData *radarData, QDomElement cappiConfig)
 	v = *(ref + i * yDim + j);		// reflectivity (REF)
 	if (v <= ref_fill)
 	  v = -999;
-	dataGrid[0][j][i][k] = v;	
+	gridValue(0, j, i, k) = v;	
 
 	v = *(vel + i * yDim + j);		// dopler velocity magnitude (VU)
 	if (v <= vel_fill)
 	  v = -999;
-	dataGrid[1][j][i][k] = v;
+	gridValue(1, j, i, k) = v;
 
 	v = *(spec + i * yDim + j);		// spectral grid width (SW)
 	if (v <= spec_fill)
 	  v = -999;
-	dataGrid[2][j][i][k] = v;
+	gridValue(2, j, i, k) = v;
       }
     }
   }
@@ -820,9 +1107,9 @@ void CappiGrid::ClosestPointInterpolation()
    }
    for (int i = 0; i < int(iDim); i++) {
 
-    dataGrid[0][i][j][k] = -999.;
-    dataGrid[1][i][j][k] = -999.;
-    dataGrid[2][i][j][k] = -999.;
+    gridValue(0, i, j, k) = -999.;
+    gridValue(1, i, j, k) = -999.;
+    gridValue(2, i, j, k) = -999.;
 
     float minR = sqrt(iDim*iGridsp*iDim*iGridsp + jDim*jGridsp*jDim*jGridsp);
 
@@ -834,7 +1121,7 @@ void CappiGrid::ClosestPointInterpolation()
      if (r > gridsp) { continue; }
      if (r < minR) {
       minR = r;
-      dataGrid[0][i][j][k] = refValues[n].refValue;
+      gridValue(0, i, j, k) = refValues[n].refValue;
      }
      if (minR < gridsp/10) {
       // Close enough
@@ -851,8 +1138,8 @@ void CappiGrid::ClosestPointInterpolation()
      if (r > gridsp) { continue; }
      if (r < minR) {
       minR = r;
-      dataGrid[1][i][j][k] = velValues[n].velValue;
-      dataGrid[2][i][j][k] = velValues[n].swValue;
+      gridValue(1, i, j, k) = velValues[n].velValue;
+      gridValue(2, i, j, k) = velValues[n].swValue;
      }
      if (minR < gridsp/3) {
       // Close enough
@@ -882,9 +1169,9 @@ void CappiGrid::BilinearInterpolation(RadarData *radarData)
    }
    for (int i = 0; i < int(iDim); i++) {
 
-    dataGrid[0][i][j][k] = -999.;
-    dataGrid[1][i][j][k] = -999.;
-    dataGrid[2][i][j][k] = -999.;
+    gridValue(0, i, j, k) = -999.;
+    gridValue(1, i, j, k) = -999.;
+    gridValue(2, i, j, k) = -999.;
 
     float x = xmin + i*iGridsp;
     float y = ymin + j*jGridsp;
@@ -910,9 +1197,8 @@ void CappiGrid::BilinearInterpolation(RadarData *radarData)
      if ((currentRay->getRef_numgates() > 0) and
       (gridReflectivity)) {
 
-      float* refData = currentRay->getRefData();
       for (int g = 0; g <= (currentRay->getRef_numgates()-1); g++) {
-       if (refData[g] == -999.) { continue; }
+       if (currentRay->getRef(g) == -999.) { continue; }
        float range = float(currentRay->getFirst_ref_gate() +
             (g * currentRay->getRef_gatesp()))/1000.;
 
@@ -938,9 +1224,9 @@ void CappiGrid::BarnesInterpolation()
     for (int j = 0; j < int(jDim); j++) {
       for (int i = 0; i < int(iDim); i++) {
 
- dataGrid[0][i][j][k] = -999.;
- dataGrid[1][i][j][k] = -999.;
- dataGrid[2][i][j][k] = -999.;
+ gridValue(0, i, j, k) = -999.;
+ gridValue(1, i, j, k) = -999.;
+ gridValue(2, i, j, k) = -999.;
 
  float sumRef = 0;
  float sumVel = 0;
@@ -989,11 +1275,11 @@ void CappiGrid::BarnesInterpolation()
  }
 
  if (refWeight > 0) {
-   dataGrid[0][i][j][k] = sumRef/refWeight;
+   gridValue(0, i, j, k) = sumRef/refWeight;
  }
  if (velWeight > 0) {
-   dataGrid[1][i][j][k] = sumVel/velWeight;
-   dataGrid[2][i][j][k] = sumSw/velWeight;
+   gridValue(1, i, j, k) = sumVel/velWeight;
+   gridValue(2, i, j, k) = sumSw/velWeight;
  }
       }
     }
@@ -1055,11 +1341,11 @@ void CappiGrid::BarnesInterpolation()
  }
 
  if (refWeight > 0) {
-   dataGrid[0][i][j][k] += sumRef/refWeight;
+   gridValue(0, i, j, k) += sumRef/refWeight;
  }
  if (velWeight > 0) {
-   dataGrid[1][i][j][k] += sumVel/velWeight;
-   dataGrid[2][i][j][k] += sumSw/velWeight;
+   gridValue(1, i, j, k) += sumVel/velWeight;
+   gridValue(2, i, j, k) += sumSw/velWeight;
  }
       }
     }
@@ -1119,29 +1405,29 @@ float CappiGrid::trilinear(const float &x, const float &y,
   }
 
   float interpValue = 0;
-  if (dataGrid[param][x0][y0][z0] != -999) {
-    interpValue += omdx*omdy*omdz*dataGrid[param][x0][y0][z0];
+  if (gridValue(param, x0, y0, z0) != -999) {
+    interpValue += omdx*omdy*omdz*gridValue(param, x0, y0, z0);
   }
-  if (dataGrid[param][x0][y1][z0] != -999) {
-    interpValue += omdx*dy*omdz*dataGrid[param][x0][y1][z0];
+  if (gridValue(param, x0, y1, z0) != -999) {
+    interpValue += omdx*dy*omdz*gridValue(param, x0, y1, z0);
   }
-  if (dataGrid[param][x1][y0][z0] != -999) {
-    interpValue += dx*omdy*omdz*dataGrid[param][x1][y0][z0];
+  if (gridValue(param, x1, y0, z0) != -999) {
+    interpValue += dx*omdy*omdz*gridValue(param, x1, y0, z0);
   }
-  if (dataGrid[param][x1][y1][z0] != -999) {
-    interpValue += dx*dy*omdz*dataGrid[param][x1][y1][z0];
+  if (gridValue(param, x1, y1, z0) != -999) {
+    interpValue += dx*dy*omdz*gridValue(param, x1, y1, z0);
   }
-  if (dataGrid[param][x0][y0][z1] != -999) {
-    interpValue += omdx*omdy*dz*dataGrid[param][x0][y0][z1];
+  if (gridValue(param, x0, y0, z1) != -999) {
+    interpValue += omdx*omdy*dz*gridValue(param, x0, y0, z1);
   }
-  if (dataGrid[param][x0][y1][z1] != -999) {
-    interpValue += omdx*dy*dz*dataGrid[param][x0][y1][z1];
+  if (gridValue(param, x0, y1, z1) != -999) {
+    interpValue += omdx*dy*dz*gridValue(param, x0, y1, z1);
   }
-  if (dataGrid[param][x1][y0][z1] != -999) {
-    interpValue += dx*omdy*dz*dataGrid[param][x1][y0][z1];
+  if (gridValue(param, x1, y0, z1) != -999) {
+    interpValue += dx*omdy*dz*gridValue(param, x1, y0, z1);
   }
-  if (dataGrid[param][x1][y1][z1] != -999) {
-    interpValue += dx*dy*dz*dataGrid[param][x1][y1][z1];
+  if (gridValue(param, x1, y1, z1) != -999) {
+    interpValue += dx*dy*dz*gridValue(param, x1, y1, z1);
   }
 
   return interpValue;
@@ -1253,7 +1539,7 @@ void CappiGrid::writeAsi()
                 out << reset << left << fieldNames.at(n) << endl;
                 int line = 0;
                 for (int i = 0; i < int(iDim);  i++){
-                    out << reset << qSetRealNumberPrecision(3) << scientific << qSetFieldWidth(10) << dataGrid[n][i][j][k];
+                    out << reset << qSetRealNumberPrecision(3) << scientific << qSetFieldWidth(10) << gridValue(n, i, j, k);
                     line++;
                     if (line == 8) {
                         out << endl;
@@ -13,6 +13,8 @@
 
 #include <QDomElement>
 #include <QFile>
+#include <QList>
+#include <QVector>
 #include <netcdfcpp.h>
 
 #include "Radar/RadarData.h"
@@ -58,12 +60,82 @@ private:
         float height;
         float weight;
     };
+    class goodMean {
+    public:
+        float avg;
+        float count;
+    };
+    class FoldChange {
+    public:
+        int gate;
+        int position;   // offset in the radius of influence walk
+        float vel;
+    };
 
     bool gridReflectivity;
     long maxRefIndex;
     long maxVelIndex;
-    goodRef refValues[maxIDim][maxJDim][maxKDim];
-    goodVel velValues[maxIDim][maxJDim][maxKDim];
+
+    // Cressman accumulators, only allocated while gridding
+    goodRef *refValues;
+    goodVel *velValues;
+    goodMean *velMean;
+    QVector<FoldChange> *foldChanges;
+
+    // Fractional i index of the first and last gate of each ray's
+    // reflectivity and velocity, so the slab passes can skip the rays that
+    // cannot reach their slab. Empty (low > high) when the ray has no gates
+    // or none of them are at a height inside the grid.
+    class RayExtent {
+    public:
+        float refILow, refIHigh;
+        float velILow, velIHigh;
+    };
+    RayExtent *rayExtents;
+    long cellIndex(int i, int j, int k) const
+    { return (long(i) * gridJSize + j) * gridKSize + k; }
+
+    // The Cressman passes are run on slabs of the grid (or groups of rays)
+    // on the global thread pool
+    enum CressmanPass {
+        ScatterPass,
+        LocalMeanPass,
+        FoldPass,
+        FoldScatterPass,
+        UnfoldPass,
+        SmoothPass
+    };
+    class CressmanTile {
+    public:
+        CappiGrid* grid;
+        CressmanPass pass;
+        int begin;
+        int end;
+    };
+    QList<CressmanTile> makeCressmanTiles(CressmanPass pass, int size, int numTiles);
+    static void runCressmanTile(CressmanTile &tile);
+
+    bool  cressmanGateIndex(float range, float sinPhi, float cosTheta, float sinTheta,
+                            float z, float &i, float &j, float &k);
+    bool  cressmanSlabRange(float i, int iBegin, int iEnd, int &iplusMin, int &iplusMax);
+    void  cressmanRayExtents();
+    void  cressmanGateExtent(int numGates, int firstGate, float gateSpacing,
+                             const float* height, float sinPhi, float cosTheta,
+                             float &iLow, float &iHigh);
+    bool  cressmanRayReaches(float iLow, float iHigh, int iBegin, int iEnd);
+    float unfoldVelocity(float vel, float nyquist, long cell);
+    void  cressmanScatter(int iBegin, int iEnd);
+    void  cressmanLocalMean(int iBegin, int iEnd);
+    void  cressmanFold(int rayBegin, int rayEnd);
+    void  cressmanFoldScatter(int iBegin, int iEnd);
+    void  cressmanUnfold(int rayBegin, int rayEnd);
+    void  cressmanSmooth(int kBegin, int kEnd);
+
+    RadarData* cressmanRadar;
+    GateGeometry* cressmanGeometry;
+    float RSquare;
+    int maxIplus, maxJplus, maxKplus;
+    int localArea;
 
 };
 
@@ -15,7 +15,7 @@ Coefficient::Coefficient()
     level = -999;
     radius = -999;
     value = -999;
-    parameter = QString("NULL");
+    parameter = NullParameter;
 }
 
 Coefficient::Coefficient(float newLevel, float newRadius, float newValue,QString name)
@@ -23,16 +23,47 @@ Coefficient::Coefficient(float newLevel, float newRadius, float newValue,QString
     level = newLevel;
     radius = newRadius;
     value = newValue;
-    parameter = name;
+    parameter = parameterIndex(name);
 
 }
 
-Coefficient::Coefficient(const Coefficient &other)
+static const QString* parameterTable()
 {
-    this->level = other.level;
-    this->radius = other.radius;
-    this->value = other.value;
-    this->parameter = other.parameter;
+    // Built once, in Parameter order
+    static const QString names[Coefficient::NumParameters] = {
+        "NULL",
+        "VTC0", "VRC0", "VMC0",
+        "VTC1", "VTS1", "VTC2", "VTS2", "VTC3", "VTS3", "VTC4", "VTS4",
+        "VTC5", "VTS5", "VTC6", "VTS6", "VTC7", "VTS7"
+    };
+    return names;
+}
+
+QString Coefficient::parameterName(Parameter index)
+{
+    return parameterTable()[index];
+}
+
+Coefficient::Parameter Coefficient::parameterIndex(const QString &name)
+{
+    const QString* names = parameterTable();
+    for (int i = 1; i < NumParameters; i++) {
+        if (names[i] == name)
+            return Parameter(i);
+    }
+    return NullParameter;
+}
+
+Coefficient::Parameter Coefficient::cosineParameter(int wave)
+{
+    if (wave == 0)
+        return VTC0;
+    return Parameter(VTC1 + 2 * (wave - 1));
+}
+
+Coefficient::Parameter Coefficient::sineParameter(int wave)
+{
+    return Parameter(VTS1 + 2 * (wave - 1));
 }
 
 bool Coefficient::isValid() const {
@@ -58,14 +89,14 @@ void Coefficient::setValue(const float &newValue)
 
 void Coefficient::setParameter(const QString &newParameter)
 {
-    parameter = newParameter;
+    parameter = parameterIndex(newParameter);
 }
 
 bool Coefficient::operator == (const Coefficient &other)
 {
     if(level == other.getLevel())
         if(radius == other.getRadius())
-            if(parameter == other.getParameter())
+            if(parameter == other.getParameterIndex())
                 if(value == other.getValue())
                     return true;
     return false;
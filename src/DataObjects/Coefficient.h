@@ -17,9 +17,19 @@ class Coefficient
 {
 
 public:
+    // Parameter names live in one shared table and a coefficient only
+    // keeps the index, so coefficients are plain values that copy cheaply.
+    // The wavenumber terms alternate VTCn, VTSn, see cosineParameter.
+    enum Parameter {
+        NullParameter = 0,
+        VTC0, VRC0, VMC0,
+        VTC1, VTS1, VTC2, VTS2, VTC3, VTS3, VTC4, VTS4,
+        VTC5, VTS5, VTC6, VTS6, VTC7, VTS7,
+        NumParameters
+    };
+
     Coefficient();
     Coefficient(float newLevel, float newRadius, float newValue, QString name);
-    Coefficient(const Coefficient &other);
 
     bool isValid() const;
     
@@ -32,8 +42,18 @@ public:
     float getValue() const { return value; }
     void setValue(const float &newValue);
 
-    QString getParameter() const { return parameter; }
+    QString getParameter() const { return parameterName(parameter); }
     void setParameter(const QString &newParameter);
+    Parameter getParameterIndex() const { return parameter; }
+    void setParameter(Parameter newParameter) { parameter = newParameter; }
+
+    // Resolve between names and the shared table. Unknown names are
+    // NullParameter, whose name is "NULL".
+    static QString parameterName(Parameter index);
+    static Parameter parameterIndex(const QString &name);
+    // VTCn and VTSn for wavenumber n
+    static Parameter cosineParameter(int wave);
+    static Parameter sineParameter(int wave);
 
     bool operator == (const Coefficient &other);
 
@@ -44,7 +64,7 @@ private:
     float level;
     float radius;
     float value;
-    QString parameter;
+    Parameter parameter;
 
 };
 
@@ -44,11 +44,46 @@ GriddedData::GriddedData()
 
     // TODO:
     kDisplayIndex = 0;
+
+    dataGrid = NULL;
+    gridISize = gridJSize = gridKSize = 0;
+
+    ringIndexRadius = 0;
+    ringIndexIGridsp = ringIndexJGridsp = ringIndexSpacing = 0;
+    ringIndexIDim = ringIndexJDim = 0;
 }
 
 GriddedData::~GriddedData()
 {
+    delete[] dataGrid;
+}
+
+void GriddedData::allocateGrid()
+{
+    // Size the grid to what was actually requested rather than the
+    // maximum dimensions, so a volume only costs what the grid needs
+    int ni = (int)iDim;
+    int nj = (int)jDim;
+    int nk = (int)kDim;
+    if ((ni <= 0) or (nj <= 0) or (nk <= 0)) {
+        Message::toScreen("GriddedData: allocateGrid: invalid grid dimensions "+QString().setNum(ni)+" x "+QString().setNum(nj)+" x "+QString().setNum(nk));
+        ni = nj = nk = 0;
+    }
+
+    if ((dataGrid == NULL) or (ni != gridISize) or (nj != gridJSize) or (nk != gridKSize)) {
+        delete[] dataGrid;
+        dataGrid = NULL;
+        gridISize = ni;
+        gridJSize = nj;
+        gridKSize = nk;
+        long size = long(maxFields) * ni * nj * nk;
+        if (size > 0)
+            dataGrid = new float[size];
+    }
 
+    long size = long(maxFields) * gridISize * gridJSize * gridKSize;
+    for (long n = 0; n < size; n++)
+        dataGrid[n] = -999;
 }
 
 void GriddedData::writeAsi()
@@ -77,7 +112,7 @@ void GriddedData::setLatLonOrigin(float *knownLat, float *knownLon, float *relX,
     // testing Message::toScreen("Set Zero: ZeroLat = "+QString().setNum(zeroLat)+" ZeroLon = "+QString().setNum(zeroLon));
 }
 
-float GriddedData::fixAngle(float angle) {
+float GriddedData::fixAngle(float angle) const {
     // Takes and angle in radians and puts it in the 0-2Pi range
 
     float fixangle = angle;
@@ -96,7 +131,7 @@ void GriddedData::setReferencePoint(int ii, int jj, int kk)
 
     //Message::toScreen("GriddedData: Using the Index Based Reference Assignment");
 
-    if((ii > iDim)||(ii < 0)||(jj > jDim)||(jj < 0)||(kk > kDim)||(kk < 0))
+    if((ii >= iDim)||(ii < 0)||(jj >= jDim)||(jj < 0)||(kk >= kDim)||(kk < 0))
         //Message::toScreen("GriddedData: trying to examine point outside cappi for setReferencePoint: i = "+QString().setNum(ii)+" j = "+QString().setNum(jj)+" k = "+QString().setNum(kk));
         refPointI = ii;
     refPointJ = jj;
@@ -106,9 +141,10 @@ void GriddedData::setReferencePoint(int ii, int jj, int kk)
 void GriddedData::setCartesianReferencePoint(float ii, float jj, float kk)
 {
     // The reference point is coming in in km
-    refPointI = int(floor((ii- xmin)/iGridsp+.5));
-    refPointJ = int(floor((jj -ymin)/jGridsp+.5));
-    refPointK = int(floor((kk -zmin)/kGridsp+.5));
+    RingQuery query = getCartesianRingQuery(ii, jj, kk);
+    refPointI = query.refI;
+    refPointJ = query.refJ;
+    refPointK = query.refK;
     //  Message::toScreen("idim = "+QString().setNum(iDim)+" jdim "+QString().setNum(jDim)+" kdim "+QString().setNum(kDim));
     //  Message::toScreen("refPointI = "+QString().setNum(refPointI)+" refPointJ = "+QString().setNum(refPointJ)+" refPointK = "+QString().setNum(refPointK));
     //  Message::toScreen("iGridsp = "+QString().setNum(iGridsp)+" jGridsp = "+QString().setNum(jGridsp)+" kGridSp = "+QString().setNum(kGridsp));
@@ -125,29 +161,59 @@ void GriddedData::setCartesianReferencePoint(float ii, float jj, float kk)
    */
 }
 
-// TODO What if Lat and/or Lon is -999. refPoint* will be non-sensical
+RingQuery GriddedData::getCartesianRingQuery(float ii, float jj, float kk) const
+{
+    // Same rounding as setCartesianReferencePoint, without moving the
+    // grid's reference point
+    RingQuery query;
+    query.refI = int(floor((ii- xmin)/iGridsp+.5));
+    query.refJ = int(floor((jj -ymin)/jGridsp+.5));
+    query.refK = int(floor((kk -zmin)/kGridsp+.5));
+    query.cartesianI = query.refI * iGridsp + xmin;
+    query.cartesianJ = query.refJ * jGridsp + ymin;
+    query.cartesianK = query.refK * kGridsp + zmin;
+    return query;
+}
 
-void GriddedData::setAbsoluteReferencePoint(float Lat, float Lon, float Height) 
+RingQuery GriddedData::getAbsoluteRingQuery(float Lat, float Lon, float Height) const
 {
-    // Overloaded version of setCartesianReferencePoint used when Latitude and
-    // Longitude data is known.
+    // Same as setAbsoluteReferencePoint, without moving the grid's
+    // reference point
 
   if(Lat == -999)
-    std::cout << "** GriddedData::setAbsoluteReferencePoint: Lat is -999" << std::endl;
+    std::cout << "** GriddedData::getAbsoluteRingQuery: Lat is -999" << std::endl;
   if(Lon == -999)
-    std::cout << "** GriddedData::setAbsoluteReferencePoint: Lon is -999" << std::endl;
+    std::cout << "** GriddedData::getAbsoluteRingQuery: Lon is -999" << std::endl;
 
   // This assumes that the originLat and originLon are the radar coordinates.
-  
-  float *locations = getCartesianPoint(&originLat, &originLon, &Lat, &Lon);
-  
-    // Floor is used to round to the nearest integer
 
-    refPointI = int(floor((locations[0] - xmin) / iGridsp + .5));
-    refPointJ = int(floor((locations[1] - ymin) / jGridsp + .5));
-    refPointK = int(floor((Height - zmin) / kGridsp + .5));
-    // testing Message::toScreen("I = "+QString().setNum(refPointI)+" J = "+QString().setNum(refPointJ)+" K = "+QString().setNum(refPointK));
+    float lat = originLat;
+    float lon = originLon;
+    float *locations = getCartesianPoint(&lat, &lon, &Lat, &Lon);
+
+    RingQuery query;
+    query.refI = int(floor((locations[0] - xmin) / iGridsp + .5));
+    query.refJ = int(floor((locations[1] - ymin) / jGridsp + .5));
+    query.refK = int(floor((Height - zmin) / kGridsp + .5));
+    query.cartesianI = query.refI * iGridsp + xmin;
+    query.cartesianJ = query.refJ * jGridsp + ymin;
+    query.cartesianK = query.refK * kGridsp + zmin;
     delete[] locations;
+    return query;
+}
+
+// TODO What if Lat and/or Lon is -999. refPoint* will be non-sensical
+
+void GriddedData::setAbsoluteReferencePoint(float Lat, float Lon, float Height) 
+{
+    // Overloaded version of setCartesianReferencePoint used when Latitude and
+    // Longitude data is known.
+
+    RingQuery query = getAbsoluteRingQuery(Lat, Lon, Height);
+    refPointI = query.refI;
+    refPointJ = query.refJ;
+    refPointK = query.refK;
+    // testing Message::toScreen("I = "+QString().setNum(refPointI)+" J = "+QString().setNum(refPointJ)+" K = "+QString().setNum(refPointK));
 }
 
 float* GriddedData::getCartesianPoint(float *Lat, float *Lon, float *relLat, float *relLon)
@@ -367,10 +433,10 @@ float GriddedData::getIndexValue(QString& fieldName, float& ii, float& jj, float
     // a point on the defined cartesian grid in km.
     // It is a simple accessor function.
 
-    if((ii > iDim)||(ii < 0)||(jj > jDim)||(jj < 0)||(kk > kDim)||(kk < 0))
+    if((ii >= iDim)||(ii < 0)||(jj >= jDim)||(jj < 0)||(kk >= kDim)||(kk < 0))
         return -999.;
     int field = getFieldIndex(fieldName);
-    return dataGrid[field][(int)ii][(int)jj][(int)kk];
+    return gridValue(field, (int)ii, (int)jj, (int)kk);
 
 }
 
@@ -401,10 +467,10 @@ float* GriddedData::getCartesianXslice(const QString& fieldName,
 
     for(int i = 0; i < iDim; i++) {
         float ave = 0;
-        ave += (1-jjMaxDiff)*(1-kkMinDiff)*dataGrid[field][i][jjMax][kkMin];
-        ave += (1-jjMinDiff)*(1-kkMinDiff)*dataGrid[field][i][jjMin][kkMin];
-        ave += (1-jjMaxDiff)*(1-kkMaxDiff)*dataGrid[field][i][jjMax][kkMax];
-        ave += (1-jjMinDiff)*(1-kkMaxDiff)*dataGrid[field][i][jjMin][kkMax];
+        ave += (1-jjMaxDiff)*(1-kkMinDiff)*gridValue(field, i, jjMax, kkMin);
+        ave += (1-jjMinDiff)*(1-kkMinDiff)*gridValue(field, i, jjMin, kkMin);
+        ave += (1-jjMaxDiff)*(1-kkMaxDiff)*gridValue(field, i, jjMax, kkMax);
+        ave += (1-jjMinDiff)*(1-kkMaxDiff)*gridValue(field, i, jjMin, kkMax);
         values[i] = ave;
     }
     return values;
@@ -438,10 +504,10 @@ float* GriddedData::getCartesianYslice(const QString& fieldName,
 
     for(int j = 0; j < jDim; j++) {
         float ave = 0;
-        ave += (1-iiMinDiff)*(1-kkMaxDiff)*dataGrid[field][iiMin][j][kkMax];
-        ave += (1-iiMaxDiff)*(1-kkMaxDiff)*dataGrid[field][iiMax][j][kkMax];
-        ave += (1-iiMinDiff)*(1-kkMinDiff)*dataGrid[field][iiMin][j][kkMin];
-        ave += (1-iiMaxDiff)*(1-kkMinDiff)*dataGrid[field][iiMax][j][kkMin];
+        ave += (1-iiMinDiff)*(1-kkMaxDiff)*gridValue(field, iiMin, j, kkMax);
+        ave += (1-iiMaxDiff)*(1-kkMaxDiff)*gridValue(field, iiMax, j, kkMax);
+        ave += (1-iiMinDiff)*(1-kkMinDiff)*gridValue(field, iiMin, j, kkMin);
+        ave += (1-iiMaxDiff)*(1-kkMinDiff)*gridValue(field, iiMax, j, kkMin);
         values[j] = ave;
     }
     return values;
@@ -474,10 +540,10 @@ float* GriddedData::getCartesianZslice(const QString& fieldName,
 
     for(int k = 0; k < kDim; k++) {
         float ave = 0;
-        ave += (1-jjMinDiff)*(1-iiMaxDiff)*dataGrid[field][iiMax][jjMin][k];
-        ave += (1-jjMaxDiff)*(1-iiMaxDiff)*dataGrid[field][iiMax][jjMax][k];
-        ave += (1-jjMinDiff)*(1-iiMinDiff)*dataGrid[field][iiMin][jjMin][k];
-        ave += (1-jjMaxDiff)*(1-iiMinDiff)*dataGrid[field][iiMin][jjMax][k];
+        ave += (1-jjMinDiff)*(1-iiMaxDiff)*gridValue(field, iiMax, jjMin, k);
+        ave += (1-jjMaxDiff)*(1-iiMaxDiff)*gridValue(field, iiMax, jjMax, k);
+        ave += (1-jjMinDiff)*(1-iiMinDiff)*gridValue(field, iiMin, jjMin, k);
+        ave += (1-jjMaxDiff)*(1-iiMinDiff)*gridValue(field, iiMin, jjMax, k);
         values[k] = ave;
     }
     return values;
@@ -513,14 +579,14 @@ float GriddedData::getCartesianValue(const QString& fieldName, const float& x,
     float iiMaxDiff = iiMax - iiIndex;
 
     float ave = 0;
-    ave += (1-jjMinDiff)*(1-iiMaxDiff)*(1-kkMinDiff)*dataGrid[field][iiMax][jjMin][kkMin];
-    ave += (1-jjMaxDiff)*(1-iiMaxDiff)*(1-kkMinDiff)*dataGrid[field][iiMax][jjMax][kkMin];
-    ave += (1-jjMinDiff)*(1-iiMinDiff)*(1-kkMinDiff)*dataGrid[field][iiMin][jjMin][kkMin];
-    ave += (1-jjMaxDiff)*(1-iiMinDiff)*(1-kkMinDiff)*dataGrid[field][iiMin][jjMax][kkMin];
-    ave += (1-jjMinDiff)*(1-iiMaxDiff)*(1-kkMaxDiff)*dataGrid[field][iiMax][jjMin][kkMax];
-    ave += (1-jjMaxDiff)*(1-iiMaxDiff)*(1-kkMaxDiff)*dataGrid[field][iiMax][jjMax][kkMax];
-    ave += (1-jjMinDiff)*(1-iiMinDiff)*(1-kkMaxDiff)*dataGrid[field][iiMin][jjMin][kkMax];
-    ave += (1-jjMaxDiff)*(1-iiMinDiff)*(1-kkMaxDiff)*dataGrid[field][iiMin][jjMax][kkMax];
+    ave += (1-jjMinDiff)*(1-iiMaxDiff)*(1-kkMinDiff)*gridValue(field, iiMax, jjMin, kkMin);
+    ave += (1-jjMaxDiff)*(1-iiMaxDiff)*(1-kkMinDiff)*gridValue(field, iiMax, jjMax, kkMin);
+    ave += (1-jjMinDiff)*(1-iiMinDiff)*(1-kkMinDiff)*gridValue(field, iiMin, jjMin, kkMin);
+    ave += (1-jjMaxDiff)*(1-iiMinDiff)*(1-kkMinDiff)*gridValue(field, iiMin, jjMax, kkMin);
+    ave += (1-jjMinDiff)*(1-iiMaxDiff)*(1-kkMaxDiff)*gridValue(field, iiMax, jjMin, kkMax);
+    ave += (1-jjMaxDiff)*(1-iiMaxDiff)*(1-kkMaxDiff)*gridValue(field, iiMax, jjMax, kkMax);
+    ave += (1-jjMinDiff)*(1-iiMinDiff)*(1-kkMaxDiff)*gridValue(field, iiMin, jjMin, kkMax);
+    ave += (1-jjMaxDiff)*(1-iiMinDiff)*(1-kkMaxDiff)*gridValue(field, iiMin, jjMax, kkMax);
     return ave;
 
 }
@@ -575,7 +641,7 @@ float* GriddedData::getSphericalRangeData(QString& fieldName, float azimuth,
                         && (pAzimuth > (azimuth-sphericalAzimuthSpacing/2.))) {
                     if((pElevation <=(elevation+sphericalElevationSpacing/2.))
                             && (pElevation > (elevation-sphericalElevationSpacing/2.))) {
-                        values[count] = dataGrid[field][i][j][k];
+                        values[count] = gridValue(field, i, j, k);
                         count++;
                     }
                 }
@@ -659,7 +725,7 @@ float* GriddedData::getSphericalAzimuthData(QString& fieldName,
                         && (r > (range-sphericalRangeSpacing/2.))) {
                     if((pElevation <=(elevation+sphericalElevationSpacing/2.))
                             && (pElevation > (elevation-sphericalElevationSpacing/2.))) {
-                        values[count] = dataGrid[field][i][j][k];
+                        values[count] = gridValue(field, i, j, k);
                         count++;
                     }
                 }
@@ -736,7 +802,7 @@ float* GriddedData::getSphericalElevationData(QString& fieldName, float range,
                         && (pAzimuth > (azimuth-sphericalAzimuthSpacing/2.))) {
                     if((r <= (range+sphericalRangeSpacing/2.))
                             && (r > (range-sphericalRangeSpacing/2.))) {
-                        values[count] = dataGrid[field][i][j][k];
+                        values[count] = gridValue(field, i, j, k);
                         count++;
                     }
                 }
@@ -810,7 +876,7 @@ float* GriddedData::getCylindricalRadiusData(QString& fieldName, float azimuth,
                         && (pAzimuth > (azimuth-cylindricalAzimuthSpacing/2.))) {
                     if((k*kGridsp <= ((height/kGridsp)-zmin+cylindricalHeightSpacing/2.))
                             && (k*kGridsp > ((height/kGridsp)-zmin-cylindricalHeightSpacing/2.))) {
-                        values[count] = dataGrid[field][i][j][k];
+                        values[count] = gridValue(field, i, j, k);
                         count++;
                     }
                 }
@@ -872,38 +938,7 @@ int GriddedData::getCylindricalAzimuthLength(float radius, float height)
 
 int GriddedData::getCylindricalAzimuthLength(float radius, float height)
 {
-    int count = 0;
-    float r = 0;
-    // 2 is for a little extra :)
-    int iLow = int(refPointI)-int((radius+cylindricalRadiusSpacing)/iGridsp)-2;
-    int iHigh = int(refPointI) + int((radius+cylindricalRadiusSpacing)/iGridsp) + 2;
-    if(iLow < 0)
-        iLow = 0;
-    if(iHigh > iDim)
-        iHigh = int(iDim);
-    int jLow = int(refPointJ)-int((radius+cylindricalRadiusSpacing)/jGridsp)-2;
-    int jHigh = int(refPointJ)+int((radius+cylindricalRadiusSpacing)/jGridsp)+2;
-    if(jLow < 0)
-        jLow = 0;
-    if(jHigh > jDim)
-        jHigh = int(jDim);
-    // Do k too!
-    for(int i = iLow; i < iHigh; i ++) {
-        for(int j = jLow; j < jHigh; j ++) {
-            for(int k = 0; k < kDim; k ++) {
-                r = sqrt(iGridsp*iGridsp*(i-refPointI)*(i-refPointI)+jGridsp*jGridsp*(j-refPointJ)*(j-refPointJ));
-                if((r <= (radius+cylindricalRadiusSpacing/2.))
-                        && (r > (radius-cylindricalRadiusSpacing/2.))) {
-                    if((k <= (((height-zmin)/kGridsp)+cylindricalHeightSpacing/2))
-                            && (k > (((height-zmin)/kGridsp)-cylindricalHeightSpacing/2))) {
-                        count++;
-                    }
-                }
-            }
-        }
-    }
-    return count;
-
+    return cylindricalRing(refPointI, refPointJ, -1, 0, radius, height, NULL, NULL);
 }
 
 int GriddedData::getCylindricalAzimuthLengthTest2(float radius, float height)
@@ -1029,7 +1064,7 @@ void GriddedData::getCylindricalAzimuthData(QString& fieldName, int numPoints,
     && (r > (radius-cylindricalRadiusSpacing/2.))) {
    if((k <= (((height-zmin)/kGridsp)+cylindricalHeightSpacing/2))
       && (k > (((height-zmin)/kGridsp)-cylindricalHeightSpacing/2))) {
-     values[count] = dataGrid[field][i][j][k];
+     values[count] = gridValue(field, i, j, k);
      count++;
      if(count > numPoints) {
        // Memory overflow ... bail out
@@ -1048,50 +1083,8 @@ void GriddedData::getCylindricalAzimuthData(QString& fieldName,
                                             int numPoints,float radius,
                                             float height, float* values)
 {
-    //  int numPoints = getCylindricalAzimuthLength(radius, height);
     int field = getFieldIndex(fieldName);
-
-    //  float *values = new float[numPoints];
-
-    int count = 0;
-    float r = 0;
-
-    // 2 is for a little extra :)
-    int iLow = int(refPointI)-int((radius+cylindricalRadiusSpacing)/iGridsp)-2;
-    int iHigh = int(refPointI) + int((radius+cylindricalRadiusSpacing)/iGridsp) + 2;
-    if(iLow < 0)
-        iLow = 0;
-    if(iHigh > iDim)
-        iHigh = int(iDim);
-    int jLow = int(refPointJ)-int((radius+cylindricalRadiusSpacing)/jGridsp)-2;
-    int jHigh = int(refPointJ)+int((radius+cylindricalRadiusSpacing)/jGridsp)+2;
-    if(jLow < 0)
-        jLow = 0;
-    if(jHigh > jDim)
-        jHigh = int(jDim);
-    // Do k too!
-    for(int i = iLow; i < iHigh; i ++) {
-        for(int j = jLow; j < jHigh; j ++) {
-            for(int k = 0; k < kDim; k ++) {
-                r = sqrt(iGridsp*iGridsp*(i-refPointI)*(i-refPointI)+jGridsp*jGridsp*(j-refPointJ)*(j-refPointJ));
-                if((r <= (radius+cylindricalRadiusSpacing/2.))
-                        && (r > (radius-cylindricalRadiusSpacing/2.))) {
-                    if((k <= (((height-zmin)/kGridsp)+cylindricalHeightSpacing/2))
-                            && (k > (((height-zmin)/kGridsp)-cylindricalHeightSpacing/2))) {
-                        values[count] = dataGrid[field][i][j][k];
-			// TODO debug
-			// std::cout << "val[" << count << "] = " << values[count] << std::endl;
-                        count++;
-                        if(count > numPoints) {
-                            // Memory overflow ... bail out
-                            Message::toScreen("GriddedData: getCylindricalAzimuthData: HUGE Problems!");
-                        }
-                    }
-                }
-            }
-        }
-    }
-    //return values;
+    cylindricalRing(refPointI, refPointJ, field, numPoints, radius, height, values, NULL);
 }
 
 void GriddedData::getCylindricalAzimuthDataTest2(QString& fieldName, 
@@ -1155,7 +1148,7 @@ void GriddedData::getCylindricalAzimuthDataTest2(QString& fieldName,
                         && (r > (radius-cylindricalRadiusSpacing/2.))) {
                     if((k <= (((height-zmin)/kGridsp)+cylindricalHeightSpacing/2))
                             && (k > (((height-zmin)/kGridsp)-cylindricalHeightSpacing/2))) {
-                        values[count] = dataGrid[field][i][j][k];
+                        values[count] = gridValue(field, i, j, k);
                         count++;
                         if(count > numPoints) {
                             // Memory overflow ... bail out
@@ -1174,7 +1167,7 @@ void GriddedData::getCylindricalAzimuthDataTest2(QString& fieldName,
                         && (r > (radius-cylindricalRadiusSpacing/2.))) {
                     if((k <= (((height-zmin)/kGridsp)+cylindricalHeightSpacing/2))
                             && (k > (((height-zmin)/kGridsp)-cylindricalHeightSpacing/2))) {
-                        values[count] = dataGrid[field][i][j][k];
+                        values[count] = gridValue(field, i, j, k);
                         count++;
                         if(count > numPoints) {
                             // Memory overflow ... bail out
@@ -1191,7 +1184,7 @@ void GriddedData::getCylindricalAzimuthDataTest2(QString& fieldName,
                         && (r > (radius-cylindricalRadiusSpacing/2.))) {
                     if((k <= (((height-zmin)/kGridsp)+cylindricalHeightSpacing/2))
                             && (k > (((height-zmin)/kGridsp)-cylindricalHeightSpacing/2))) {
-                        values[count] = dataGrid[field][i][j][k];
+                        values[count] = gridValue(field, i, j, k);
                         count++;
                         if(count > numPoints) {
                             // Memory overflow ... bail out
@@ -1210,7 +1203,7 @@ void GriddedData::getCylindricalAzimuthDataTest2(QString& fieldName,
                         && (r > (radius-cylindricalRadiusSpacing/2.))) {
                     if((k <= (((height-zmin)/kGridsp)+cylindricalHeightSpacing/2))
                             && (k > (((height-zmin)/kGridsp)-cylindricalHeightSpacing/2))) {
-                        values[count] = dataGrid[field][i][j][k];
+                        values[count] = gridValue(field, i, j, k);
                         count++;
                         if(count > numPoints) {
                             // Memory overflow ... bail out
@@ -1261,50 +1254,232 @@ void GriddedData::getCylindricalAzimuthPosition(int numPoints, float radius, flo
 
 void GriddedData::getCylindricalAzimuthPosition(int numPoints, float radius, float height, float* positions) 
 {
-    //  int numPoints = getCylindricalAzimuthLength(radius, height);
+    cylindricalRing(refPointI, refPointJ, -1, numPoints, radius, height, NULL, positions);
+}
 
-    //  float *positions = new float[numPoints];
+int GriddedData::getCylindricalAzimuthRing(QString& fieldName, int numPoints,
+                                           float radius, float height,
+                                           float* values, float* positions)
+{
+    int field = getFieldIndex(fieldName);
+    return cylindricalRing(refPointI, refPointJ, field, numPoints, radius, height, values, positions);
+}
+
+int GriddedData::getCylindricalAzimuthLength(const RingQuery& query, float radius, float height) const
+{
+    return cylindricalRing(query.refI, query.refJ, -1, 0, radius, height, NULL, NULL);
+}
+
+int GriddedData::getCylindricalAzimuthRing(const RingQuery& query, const QString& fieldName,
+                                           int numPoints, float radius, float height,
+                                           float* values, float* positions) const
+{
+    int field = getFieldIndex(fieldName);
+    return cylindricalRing(query.refI, query.refJ, field, numPoints, radius, height, values, positions);
+}
+
+void GriddedData::buildRingIndex() const
+{
+    // Every ring query walks this instead of rescanning a bounding box
+    // with a sqrt per cell. It covers any offset that can land in the grid
+    // from a reference point inside it, and is rebuilt only when the
+    // horizontal geometry changes.
+    if (cylindricalRadiusSpacing <= 0) {
+        // No rings to bucket, cylindricalRing scans the grid instead
+        ringOffsets.clear();
+        ringBucketStart.clear();
+        ringIndexRadius = 0;
+        return;
+    }
+    int iExt = int(iDim) - 1;
+    int jExt = int(jDim) - 1;
+    if (iExt < 0)
+        iExt = 0;
+    if (jExt < 0)
+        jExt = 0;
+    ringIndexRadius = iExt * iGridsp;
+    if (jExt * jGridsp < ringIndexRadius)
+        ringIndexRadius = jExt * jGridsp;
+    int numBuckets = int(floor(double(ringIndexRadius) / double(cylindricalRadiusSpacing))) + 1;
+
+    QVector<QVector<RingOffset> > buckets(numBuckets);
+    for (int di = -iExt; di <= iExt; di++) {
+        for (int dj = -jExt; dj <= jExt; dj++) {
+            float i = di;
+            float j = dj;
+            float r = sqrt(iGridsp*iGridsp*i*i+jGridsp*jGridsp*j*j);
+            if (r > ringIndexRadius)
+                continue;
+            RingOffset offset;
+            offset.di = di;
+            offset.dj = dj;
+            offset.radius = r;
+            offset.azimuth = fixAngle(atan2(j,i))*rad2deg;
+            buckets[int(floor(double(r) / double(cylindricalRadiusSpacing)))].append(offset);
+        }
+    }
+
+    ringOffsets.clear();
+    ringBucketStart.resize(numBuckets + 1);
+    for (int b = 0; b < numBuckets; b++) {
+        ringBucketStart[b] = ringOffsets.size();
+        ringOffsets += buckets[b];
+    }
+    ringBucketStart[numBuckets] = ringOffsets.size();
 
+    ringIndexIGridsp = iGridsp;
+    ringIndexJGridsp = jGridsp;
+    ringIndexSpacing = cylindricalRadiusSpacing;
+    ringIndexIDim = int(iDim);
+    ringIndexJDim = int(jDim);
+}
+
+int GriddedData::cylindricalRing(float refI, float refJ, int field, int numPoints,
+                                 float radius, float height,
+                                 float* values, float* positions) const
+{
+    // Collects the cells of the ring around (refI, refJ) in i, j, k order.
+    // Only counts them if both values and positions are NULL.
+    if (cylindricalRadiusSpacing <= 0)
+        return scanCylindricalRing(refI, refJ, field, numPoints, radius, height, values, positions);
+
+    {
+        QMutexLocker locker(&ringIndexLock);
+        if ((ringIndexIGridsp != iGridsp) || (ringIndexJGridsp != jGridsp)
+                || (ringIndexSpacing != cylindricalRadiusSpacing)
+                || (ringIndexIDim != int(iDim)) || (ringIndexJDim != int(jDim)))
+            buildRingIndex();
+    }
+
+    double rLow = radius-cylindricalRadiusSpacing/2.;
+    double rHigh = radius+cylindricalRadiusSpacing/2.;
+    if (rHigh > ringIndexRadius)
+        return scanCylindricalRing(refI, refJ, field, numPoints, radius, height, values, positions);
+
+    int kLow = int(kDim);
+    int kHigh = 0;
+    for (int k = 0; k < kDim; k++) {
+        if ((k <= (((height-zmin)/kGridsp)+cylindricalHeightSpacing/2))
+                && (k > (((height-zmin)/kGridsp)-cylindricalHeightSpacing/2))) {
+            if (k < kLow)
+                kLow = k;
+            kHigh = k + 1;
+        }
+    }
+    if (kLow >= kHigh)
+        return 0;
+
+    // A ring is one spacing wide so it spans at most three buckets
+    int bLow = int(floor(rLow / cylindricalRadiusSpacing));
+    int bHigh = int(floor(rHigh / cylindricalRadiusSpacing));
+    if (bLow < 0)
+        bLow = 0;
+    if (bHigh > ringBucketStart.size() - 2)
+        bHigh = ringBucketStart.size() - 2;
+    int numCursors = 0;
+    int cursor[4], cursorEnd[4];
+    for (int b = bLow; (b <= bHigh) && (numCursors < 4); b++) {
+        cursor[numCursors] = ringBucketStart[b];
+        cursorEnd[numCursors] = ringBucketStart[b + 1];
+        numCursors++;
+    }
+
+    const RingOffset* offsets = ringOffsets.constData();
+    int originI = int(refI);
+    int originJ = int(refJ);
     int count = 0;
-    float r = 0;
+    while (true) {
+        // Merge the buckets back into (di, dj) order
+        int next = -1;
+        for (int c = 0; c < numCursors; c++) {
+            if (cursor[c] >= cursorEnd[c])
+                continue;
+            if ((next < 0)
+                    || (offsets[cursor[c]].di < offsets[cursor[next]].di)
+                    || ((offsets[cursor[c]].di == offsets[cursor[next]].di)
+                        && (offsets[cursor[c]].dj < offsets[cursor[next]].dj)))
+                next = c;
+        }
+        if (next < 0)
+            break;
+        const RingOffset& offset = offsets[cursor[next]++];
+
+        float r = offset.radius;
+        if ((r > rHigh) || (r <= rLow))
+            continue;
+        int i = originI + offset.di;
+        int j = originJ + offset.dj;
+        if ((i < 0) || (i >= iDim) || (j < 0) || (j >= jDim))
+            continue;
+        for (int k = kLow; k < kHigh; k++) {
+            if ((values == NULL) && (positions == NULL)) {
+                count++;
+                continue;
+            }
+            if (count >= numPoints) {
+                // Memory overflow ... bail out
+                Message::toScreen("GriddedData: getCylindricalAzimuthRing: HUGE Problems!");
+                return count;
+            }
+            if (values != NULL)
+                values[count] = gridValue(field, i, j, k);
+            if (positions != NULL)
+                positions[count] = offset.azimuth;
+            count++;
+        }
+    }
+    return count;
+}
 
+int GriddedData::scanCylindricalRing(float refI, float refJ, int field, int numPoints,
+                                     float radius, float height,
+                                     float* values, float* positions) const
+{
+    // Brute force version of cylindricalRing for rings reaching past the index
+    int count = 0;
+    float r = 0;
 
     // 2 is for a little extra :)
-    int iLow = int(refPointI)-int((radius+cylindricalRadiusSpacing)/iGridsp)-2;
-    int iHigh = int(refPointI) + int((radius+cylindricalRadiusSpacing)/iGridsp) + 2;
+    int iLow = int(refI)-int((radius+cylindricalRadiusSpacing)/iGridsp)-2;
+    int iHigh = int(refI) + int((radius+cylindricalRadiusSpacing)/iGridsp) + 2;
     if(iLow < 0)
         iLow = 0;
     if(iHigh > iDim)
         iHigh = int(iDim);
-    int jLow = int(refPointJ)-int((radius+cylindricalRadiusSpacing)/jGridsp)-2;
-    int jHigh = int(refPointJ)+int((radius+cylindricalRadiusSpacing)/jGridsp)+2;
+    int jLow = int(refJ)-int((radius+cylindricalRadiusSpacing)/jGridsp)-2;
+    int jHigh = int(refJ)+int((radius+cylindricalRadiusSpacing)/jGridsp)+2;
     if(jLow < 0)
         jLow = 0;
     if(jHigh > jDim)
         jHigh = int(jDim);
-    // Do k too!
     for(int i = iLow; i < iHigh; i ++) {
         for(int j = jLow; j < jHigh; j ++) {
             for(int k = 0; k < kDim; k ++) {
-                r = sqrt(iGridsp*iGridsp*(i-refPointI)*(i-refPointI)
-                         + jGridsp*jGridsp*(j-refPointJ)*(j-refPointJ));
+                r = sqrt(iGridsp*iGridsp*(i-refI)*(i-refI)+jGridsp*jGridsp*(j-refJ)*(j-refJ));
                 if((r <= (radius+cylindricalRadiusSpacing/2.))
                         && (r > (radius-cylindricalRadiusSpacing/2.))) {
                     if((k <= (((height-zmin)/kGridsp)+cylindricalHeightSpacing/2))
                             && (k > (((height-zmin)/kGridsp)-cylindricalHeightSpacing/2))) {
-                        float azimuth = fixAngle(atan2((j-refPointJ),(i-refPointI)))*rad2deg;
-                        if (count > numPoints) {
-                            // Memory overflow, bail out
-                            return;
-                        } else {
-                            positions[count] = azimuth;
+                        if ((values == NULL) && (positions == NULL)) {
                             count++;
+                            continue;
                         }
+                        if (count >= numPoints) {
+                            // Memory overflow ... bail out
+                            Message::toScreen("GriddedData: getCylindricalAzimuthRing: HUGE Problems!");
+                            return count;
+                        }
+                        if (values != NULL)
+                            values[count] = gridValue(field, i, j, k);
+                        if (positions != NULL)
+                            positions[count] = fixAngle(atan2((j-refJ),(i-refI)))*rad2deg;
+                        count++;
                     }
                 }
             }
         }
     }
+    return count;
 }
 
 void GriddedData::getCylindricalAzimuthPositionTest2(int numPoints, float radius, float height, float* positions) 
@@ -1485,7 +1660,7 @@ float* GriddedData::getCylindricalHeightData(QString& fieldName, float radius,
                 if((pAzimuth <= azimuth+cylindricalAzimuthSpacing/2.)
                         && (pAzimuth > azimuth-cylindricalAzimuthSpacing/2.)) {
                     for(int k = 0; k < kDim; k++){
-                        data[count] = dataGrid[field][i][j][k];
+                        data[count] = gridValue(field, i, j, k);
                         count++;
                     }
                 }
@@ -1534,11 +1709,12 @@ bool GriddedData::test()
     iGridsp = 2;
     jGridsp = 2;
     kGridsp = 1;
+    allocateGrid();
     for(int i = 0; i < iDim; i++) {
         for(int j = 0; j < jDim; j++) {
             for(int k = 0; k < kDim; k++) {
                 for(int dataField = 0; dataField < 3; dataField++) {
-                    dataGrid[dataField][i][j][k] = dataField*j;
+                    gridValue(dataField, i, j, k) = dataField*j;
                 }
             }
         }
@@ -1555,8 +1731,8 @@ bool GriddedData::test()
                     QString message("TEST: Value not what is expected "+fieldName+" x:"+QString().setNum(i)+" y:"+QString().setNum(j)+" z:"+QString().setNum(k)+" value:"+QString().setNum(xValues[i])+" from getCartesianValue");
                     Message::toScreen(message);
                 }
-                if(xValues[i]!=(dataGrid[0][i][j][k]+dataGrid[0][i][j+1][k])) {
-                    QString message("TEST: Value not what is expected "+fieldName+" x:"+QString().setNum(i)+" y:"+QString().setNum(j)+" z:"+QString().setNum(k)+" value:"+QString().setNum(xValues[i])+" actual: "+QString().setNum(dataGrid[0][i][j][k]));
+                if(xValues[i]!=(gridValue(0, i, j, k)+gridValue(0, i, j+1, k))) {
+                    QString message("TEST: Value not what is expected "+fieldName+" x:"+QString().setNum(i)+" y:"+QString().setNum(j)+" z:"+QString().setNum(k)+" value:"+QString().setNum(xValues[i])+" actual: "+QString().setNum(gridValue(0, i, j, k)));
                     Message::toScreen(message);
                 }
             }
@@ -1565,8 +1741,8 @@ bool GriddedData::test()
             xValues = getCartesianXslice(fieldName,(j+ymin)*jGridsp,
                                          (k+zmin)*kGridsp);
             for(int i = 0; i < iDim; i++) {
-                if(xValues[i]!=dataGrid[1][i][j][k]) {
-                    QString message("TEST: Value not what is expected "+fieldName+" x:"+QString().setNum(i)+" y:"+QString().setNum(j)+" z:"+QString().setNum(j)+" value:"+QString().setNum(xValues[i])+" actual: "+QString().setNum(dataGrid[1][i][j][k]));
+                if(xValues[i]!=gridValue(1, i, j, k)) {
+                    QString message("TEST: Value not what is expected "+fieldName+" x:"+QString().setNum(i)+" y:"+QString().setNum(j)+" z:"+QString().setNum(j)+" value:"+QString().setNum(xValues[i])+" actual: "+QString().setNum(gridValue(1, i, j, k)));
                     Message::toScreen(message);
                 }
             }
@@ -1575,8 +1751,8 @@ bool GriddedData::test()
             xValues = getCartesianXslice(fieldName,(j+ymin)*jGridsp,
                                          (k+zmin)*kGridsp);
             for(int i = 0; i < iDim; i++) {
-                if(xValues[i]!=dataGrid[2][i][j][k]) {
-                    QString message("TEST: Value not what is expected "+fieldName+" x:"+QString().setNum(i)+" y:"+QString().setNum(j)+" z:"+QString().setNum(k)+" value:"+QString().setNum(xValues[i])+" actual: "+QString().setNum(dataGrid[2][i][j][k]));
+                if(xValues[i]!=gridValue(2, i, j, k)) {
+                    QString message("TEST: Value not what is expected "+fieldName+" x:"+QString().setNum(i)+" y:"+QString().setNum(j)+" z:"+QString().setNum(k)+" value:"+QString().setNum(xValues[i])+" actual: "+QString().setNum(gridValue(2, i, j, k)));
                     Message::toScreen(message);
                 }
             }
@@ -1591,8 +1767,8 @@ bool GriddedData::test()
             yValues = getCartesianYslice(fieldName,(i+xmin)*iGridsp,
                                          (k+zmin)*kGridsp);
             for(int j = 0; j < jDim; j++) {
-                if(yValues[j]!=dataGrid[0][i][j][k]) {
-                    QString message("TEST: Value not what is expected "+fieldName+" x:"+QString().setNum(i)+" y:"+QString().setNum(j)+" z:"+QString().setNum(k)+" value:"+QString().setNum(yValues[j])+" actual: "+QString().setNum(dataGrid[0][i][j][k]));
+                if(yValues[j]!=gridValue(0, i, j, k)) {
+                    QString message("TEST: Value not what is expected "+fieldName+" x:"+QString().setNum(i)+" y:"+QString().setNum(j)+" z:"+QString().setNum(k)+" value:"+QString().setNum(yValues[j])+" actual: "+QString().setNum(gridValue(0, i, j, k)));
                     Message::toScreen(message);
                 }
             }
@@ -1600,8 +1776,8 @@ bool GriddedData::test()
             yValues = getCartesianYslice(fieldName,(i+xmin)*iGridsp,
                                          (k+zmin)*kGridsp);
             for(int j = 0; j < jDim; j++) {
-                if(yValues[j]!=dataGrid[1][i][j][k]) {
-                    QString message("TEST: Value not what is expected "+fieldName+" x:"+QString().setNum(i)+" y:"+QString().setNum(j)+" z:"+QString().setNum(k)+" value:"+QString().setNum(yValues[j])+" actual "+QString().setNum(dataGrid[1][i][j][k]));
+                if(yValues[j]!=gridValue(1, i, j, k)) {
+                    QString message("TEST: Value not what is expected "+fieldName+" x:"+QString().setNum(i)+" y:"+QString().setNum(j)+" z:"+QString().setNum(k)+" value:"+QString().setNum(yValues[j])+" actual "+QString().setNum(gridValue(1, i, j, k)));
                     Message::toScreen(message);
                 }
             }
@@ -1609,8 +1785,8 @@ bool GriddedData::test()
             yValues = getCartesianYslice(fieldName,(i+xmin)*iGridsp,
                                          (k+zmin)*kGridsp);
             for(int j = 0; j < jDim; j++) {
-                if(yValues[j]!=dataGrid[2][i][j][k]) {
-                    QString message("TEST: Value not what is expected "+fieldName+" x:"+QString().setNum(i)+" y:"+QString().setNum(j)+" z:"+QString().setNum(k)+" value:"+QString().setNum(yValues[j])+" actual "+QString().setNum(dataGrid[2][i][j][k]));
+                if(yValues[j]!=gridValue(2, i, j, k)) {
+                    QString message("TEST: Value not what is expected "+fieldName+" x:"+QString().setNum(i)+" y:"+QString().setNum(j)+" z:"+QString().setNum(k)+" value:"+QString().setNum(yValues[j])+" actual "+QString().setNum(gridValue(2, i, j, k)));
                     Message::toScreen(message);
                 }
             }
@@ -1624,7 +1800,7 @@ bool GriddedData::test()
             float *zValues = new float[int(floor(kDim))];
             zValues= getCartesianZslice(fieldName,(i+xmin)*iGridsp,(j+ymin)*jGridsp);
             for(int k = 0; k < kDim; k++) {
-                if(zValues[k]!=dataGrid[0][i][j][k]) {
+                if(zValues[k]!=gridValue(0, i, j, k)) {
                     QString message("TEST: Value not what is expected "+fieldName+" x:"+QString().setNum(i)+" y:"+QString().setNum(j)+" z:"+QString().setNum(k)+" value:"+QString().setNum(zValues[k]));
                     Message::toScreen(message);
                 }
@@ -1633,7 +1809,7 @@ bool GriddedData::test()
             zValues = getCartesianZslice(fieldName,(i+xmin)*iGridsp,
                                          (j+ymin)*jGridsp);
             for(int k = 0; k < kDim; k++) {
-                if(zValues[k]!=dataGrid[1][i][j][k]) {
+                if(zValues[k]!=gridValue(1, i, j, k)) {
                     QString message("TEST: Value not what is expected "+fieldName+" x:"+QString().setNum(i)+" y:"+QString().setNum(j)+" z:"+QString().setNum(k)+" value:"+QString().setNum(zValues[k]));
                     Message::toScreen(message);
                 }
@@ -1642,7 +1818,7 @@ bool GriddedData::test()
             zValues = getCartesianZslice(fieldName,(i+xmin)*iGridsp,
                                          (j+ymin)*jGridsp);
             for(int k = 0; k < kDim; k++) {
-                if(zValues[k]!=dataGrid[2][i][j][k]) {
+                if(zValues[k]!=gridValue(2, i, j, k)) {
                     QString message("TEST: Value not what is expected "+fieldName+" x:"+QString().setNum(i)+" y:"+QString().setNum(j)+" z:"+QString().setNum(k)+" value:"+QString().setNum(zValues[k]));
                     Message::toScreen(message);
                 }
@@ -1737,7 +1913,7 @@ float* GriddedData::getSphericalRangeDataTest(QString& fieldName,
                         && (pAzimuth > (azimuth-sphericalAzimuthSpacing/2.))) {
                     if((pElevation <=(elevation+sphericalElevationSpacing/2.))
                             && (pElevation > (elevation-sphericalElevationSpacing/2.))) {
-                        values[count] = dataGrid[field][i][j][k];
+                        values[count] = gridValue(field, i, j, k);
                         count++;
                     }
                 }
@@ -15,6 +15,37 @@
 #include "IO/Message.h"
 #include <QDomElement>
 #include <QStringList>
+#include <QVector>
+#include <QMutex>
+
+// A grid cell offset from a reference point, with its horizontal
+// distance (km) and azimuth (degrees) from that point
+class RingOffset
+{
+ public:
+  short di, dj;
+  float radius;
+  float azimuth;
+};
+
+// Center of a cylindrical query in grid indices. The ring functions that
+// take one leave the grid's own reference point alone, so several threads
+// can query the same grid at once.
+class RingQuery
+{
+ public:
+  RingQuery() : refI(0), refJ(0), refK(0),
+    cartesianI(0), cartesianJ(0), cartesianK(0) {}
+  bool isInsideGrid() const { return (refI >= 0) && (refJ >= 0) && (refK >= 0); }
+  // Center as grid indices
+  float refI;
+  float refJ;
+  float refK;
+  // Same center in km, as returned by getCartesianRefPoint*
+  float cartesianI;
+  float cartesianJ;
+  float cartesianK;
+};
 
 class GriddedData 
 {
@@ -40,7 +71,7 @@ class GriddedData
   //void setIGridsp(const float& iSpacing);
   //void setJGridsp(const float& jSpacing);
   //void setKGridsp(const float& kSpacing);
-  float fixAngle(float angle);
+  float fixAngle(float angle) const;
   
   void setLatLonOrigin(float *knownLat, float *knownLon, float *relX,float *relY);
   float getOriginLat()	{ return originLat; }
@@ -49,6 +80,8 @@ class GriddedData
   void setReferencePoint(int ii, int jj, int kk);
   void setCartesianReferencePoint(float ii, float jj, float kk); 
   void setAbsoluteReferencePoint(float Lat, float Lon, float Height);
+  RingQuery getCartesianRingQuery(float ii, float jj, float kk) const;
+  RingQuery getAbsoluteRingQuery(float Lat, float Lon, float Height) const;
 
   static float* getCartesianPoint(float *Lat, float *Lon,float *relLat, float* relLon);
   static float  getCartesianDistance(float Lat, float Lon,float relLat, float relLon);
@@ -122,6 +155,10 @@ class GriddedData
   int    getCylindricalAzimuthLength(float radius, float height);
   void   getCylindricalAzimuthData(QString& fieldName,int numPoints, float radius, float height, float* values);
   void   getCylindricalAzimuthPosition(int numPoints, float radius, float height, float* positions);
+  // Fills values and positions for the same ring in one pass, returns the number of points filled
+  int    getCylindricalAzimuthRing(QString& fieldName, int numPoints, float radius, float height, float* values, float* positions);
+  int    getCylindricalAzimuthLength(const RingQuery& query, float radius, float height) const;
+  int    getCylindricalAzimuthRing(const RingQuery& query, const QString& fieldName, int numPoints, float radius, float height, float* values, float* positions) const;
   int    getCylindricalHeightLength(float radius, float height);
   float* getCylindricalHeightData(QString& fieldName, float radius,float height);
   float* getCylindricalHeightPosition(float radius, float height);
@@ -161,15 +198,27 @@ class GriddedData
   float numFields;
   QStringList fieldNames;
 
+  // Upper bounds accepted from the configuration. The grid itself is
+  // allocated from the actual iDim/jDim/kDim by allocateGrid()
   static const int maxFields = 3;
   static const int maxIDim = 1024; // 256;
   static const int maxJDim = 1024; // 256;
   static const int maxKDim = 40;   // 20;
 
-  float dataGrid[maxFields][maxIDim][maxJDim][maxKDim];
+  // Allocate (or reallocate) dataGrid for the current iDim, jDim and kDim
+  void allocateGrid();
+
+  // dataGrid is stored contiguously as [field][i][j][k]
+  float& gridValue(int field, int i, int j, int k)
+  { return dataGrid[((long(field) * gridISize + i) * gridJSize + j) * gridKSize + k]; }
+  float  gridValue(int field, int i, int j, int k) const
+  { return dataGrid[((long(field) * gridISize + i) * gridJSize + j) * gridKSize + k]; }
+
+  float *dataGrid;
   //dataGrid[0] = reflectivity
   //dataGrid[1] = doppler velocity magnitude
   //dataGrid[2] = spectral width
+  int gridISize, gridJSize, gridKSize;
 
   float sphericalRangeSpacing;
   float sphericalAzimuthSpacing;
@@ -197,6 +246,30 @@ class GriddedData
   int kDisplayIndex;
   
   bool test();
+
+ private:
+  // Ring-membership index: every cell offset within ringIndexRadius of a
+  // reference point, bucketed by int(radius / cylindricalRadiusSpacing).
+  // Offsets within a bucket are kept in (di, dj) order so a ring walk
+  // returns cells in the same order as a scan over i, j, k would.
+  // The index is built lazily under ringIndexLock, so it is mutable to
+  // keep ring queries const.
+  void buildRingIndex() const;
+  int  cylindricalRing(float refI, float refJ, int field, int numPoints,
+                       float radius, float height, float* values, float* positions) const;
+  int  scanCylindricalRing(float refI, float refJ, int field, int numPoints,
+                           float radius, float height, float* values, float* positions) const;
+
+  mutable QVector<RingOffset> ringOffsets;
+  mutable QVector<int> ringBucketStart;
+  mutable float ringIndexRadius;
+  mutable float ringIndexIGridsp, ringIndexJGridsp, ringIndexSpacing;
+  mutable int ringIndexIDim, ringIndexJDim;
+  mutable QMutex ringIndexLock;
+
+  // dataGrid is owned by the object, don't allow copies
+  GriddedData(const GriddedData&);
+  GriddedData& operator=(const GriddedData&);
   
 };
 
@@ -44,6 +44,8 @@ VortexData::VortexData()
     _aveRMW = -999.0;
     _aveRMWUncertainty = -999.0;
     _maxValidRadius = -999;
+    coefficients = NULL;
+    _coefficientOffset = -1;
 }
 
 VortexData::VortexData(int availLevels, int availRadii, int availWaveNum)
@@ -73,6 +75,8 @@ VortexData::VortexData(int availLevels, int availRadii, int availWaveNum)
     _aveRMW = -999.0;
     _aveRMWUncertainty = -999.0;
     _maxValidRadius = -999;
+    coefficients = NULL;
+    _coefficientOffset = -1;
 }
 
 VortexData::VortexData(const VortexData &other)
@@ -91,13 +95,18 @@ VortexData::VortexData(const VortexData &other)
         this->_RMW[i] = other._RMW[i];
         this->_RMWUncertainty[i] = other._RMWUncertainty[i];
         this->_centerSD[i] = other._centerSD[i];
-        for(int j = 0; j < _numRadii; j++) {
-            for(int k = 0; k < _numWaveNum; k++) {
-                this->coefficients[i][j][k] = coefficients[i][j][k];
-            }
-        }
     }
 
+    this->coefficients = NULL;
+    if(other.coefficients != NULL) {
+        this->coefficients = new Coefficient[MAXLEVELS*MAXRADII*(MAXWAVENUM*2+3)];
+        for(int i = 0; i < _numLevels; i++)
+            for(int j = 0; j < _numRadii; j++)
+                for(int k = 0; k < MAXWAVENUM*2+3; k++)
+                    this->coefficients[coefficientIndex(i, j, k)] = other.coefficients[coefficientIndex(i, j, k)];
+    }
+    this->_coefficientOffset = other._coefficientOffset;
+
     this->_time = other._time;
 
     this->centralPressure = other.centralPressure;
@@ -110,8 +119,59 @@ VortexData::VortexData(const VortexData &other)
     this->_maxValidRadius = other._maxValidRadius;
 }
 
+VortexData& VortexData::operator=(const VortexData &other)
+{
+    if(this == &other)
+        return *this;
+
+    // Same as the copy constructor, with the old coefficients released
+    VortexData copy(other);
+    Coefficient* swap = this->coefficients;
+    this->coefficients = copy.coefficients;
+    copy.coefficients = swap;
+
+    this->_numLevels = copy._numLevels;
+    this->_numRadii  = copy._numRadii;
+    this->_numWaveNum = copy._numWaveNum;
+    this->_bestLevel = copy._bestLevel;
+    for(int i = 0; i < MAXLEVELS; i++)
+    {
+        this->_centerLat[i] = copy._centerLat[i];
+        this->_centerLon[i] = copy._centerLon[i];
+        this->_centerAlt[i] = copy._centerAlt[i];
+        this->_maxVT[i] = copy._maxVT[i];
+        this->_RMW[i] = copy._RMW[i];
+        this->_RMWUncertainty[i] = copy._RMWUncertainty[i];
+        this->_centerSD[i] = copy._centerSD[i];
+    }
+    this->_time = copy._time;
+    this->centralPressure = copy.centralPressure;
+    this->centralPressureUncertainty = copy.centralPressureUncertainty;
+    this->pressureDeficit = copy.pressureDeficit;
+    this->pressureDeficitUncertainty = copy.pressureDeficitUncertainty;
+    this->maxSfcWind = copy.maxSfcWind;
+    this->_aveRMW = copy._aveRMW;
+    this->_aveRMWUncertainty = copy._aveRMWUncertainty;
+    this->_maxValidRadius = copy._maxValidRadius;
+    this->_coefficientOffset = copy._coefficientOffset;
+    return *this;
+}
+
 VortexData::~VortexData()
 {
+    delete[] coefficients;
+}
+
+void VortexData::allocateCoefficients()
+{
+    if(coefficients == NULL)
+        coefficients = new Coefficient[MAXLEVELS*MAXRADII*(MAXWAVENUM*2+3)];
+}
+
+void VortexData::clearCoefficients()
+{
+    delete[] coefficients;
+    coefficients = NULL;
 }
 
 // TODO
@@ -146,21 +206,48 @@ int VortexData::getHeightIndex(const float& height) const
 Coefficient VortexData::getCoefficient(const int& lev, const int& rad, 
                                        const int& waveNum) const
 {
-    return coefficients[lev][rad][waveNum];
+    if(coefficients == NULL)
+        return Coefficient();
+    return coefficients[coefficientIndex(lev, rad, waveNum)];
 }
 
 Coefficient VortexData::getCoefficient(const int& lev, const int& rad,
                                        const QString& parameter) const
 {
+    return getCoefficient(lev, rad, Coefficient::parameterIndex(parameter));
+}
+
+Coefficient VortexData::getCoefficient(const float& height, const int& rad,
+                                       const QString& parameter) const
+{
+    return getCoefficient(height, rad, Coefficient::parameterIndex(parameter));
+}
+
+Coefficient VortexData::getCoefficient(const float& height, const float& rad,
+                                       const QString& parameter) const
+{
+    return getCoefficient(height, rad, Coefficient::parameterIndex(parameter));
+}
+
+Coefficient VortexData::getCoefficient(const int& lev, const int& rad,
+                                       Coefficient::Parameter parameter) const
+{
+    // The geometry decides which slot holds which parameter, so compare
+    // indices rather than assuming a layout
+    if(parameter == Coefficient::NullParameter)
+        return Coefficient();
+    if(coefficients == NULL)
+        return Coefficient();
+    const Coefficient* ring = coefficients + coefficientIndex(lev, rad, 0);
     for(int i = 0; i < _numWaveNum; i++) {
-        if(coefficients[lev][rad][i].getParameter() == parameter)
-            return coefficients[lev][rad][i];
+        if(ring[i].getParameterIndex() == parameter)
+            return ring[i];
     }
     return Coefficient();
 }
 
 Coefficient VortexData::getCoefficient(const float& height, const int& rad,
-                                       const QString& parameter) const
+                                       Coefficient::Parameter parameter) const
 {
     int level = getHeightIndex(height);
     if((level == -1) || (rad == -1)) {
@@ -171,7 +258,7 @@ Coefficient VortexData::getCoefficient(const float& height, const int& rad,
 }
 
 Coefficient VortexData::getCoefficient(const float& height, const float& rad,
-                                       const QString& parameter) const
+                                       Coefficient::Parameter parameter) const
 {
     int level = getHeightIndex(height);
     if (level < 0) return Coefficient();
@@ -189,7 +276,8 @@ Coefficient VortexData::getCoefficient(const float& height, const float& rad,
 void VortexData::setCoefficient(const int& lev, const int& rad, 
                                 const int& coeffNum, const Coefficient &coefficient)
 {
-    coefficients[lev][rad][coeffNum] = coefficient;
+    allocateCoefficients();
+    coefficients[coefficientIndex(lev, rad, coeffNum)] = coefficient;
 }
 
 bool VortexData::operator ==(const VortexData &other)
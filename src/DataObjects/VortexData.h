@@ -21,6 +21,7 @@ public:
     VortexData();
     VortexData(int availLevels, int availRadii, int availWaveNum);
     VortexData(const VortexData &other);
+    VortexData& operator=(const VortexData &other);
     ~VortexData();
 
     static constexpr float _fillv  =-999.0f;
@@ -87,9 +88,25 @@ public:
     Coefficient getCoefficient(const int& lev, const int& rad,const QString& parameter) const;
     Coefficient getCoefficient(const float& height, const int& rad,const QString& parameter) const;
     Coefficient getCoefficient(const float& height, const float& rad,const QString& parameter) const;
+    // Same lookups with the parameter already resolved, see Coefficient::parameterIndex
+    Coefficient getCoefficient(const int& lev, const int& rad, Coefficient::Parameter parameter) const;
+    Coefficient getCoefficient(const float& height, const int& rad, Coefficient::Parameter parameter) const;
+    Coefficient getCoefficient(const float& height, const float& rad, Coefficient::Parameter parameter) const;
     void	setCoefficient(const int& lev, const int& rad,const int& coeffNum, const Coefficient &coefficient);
     void	saveCoefficients(QString &fname);
 
+    // The coefficients are only allocated once one is set. A summary record
+    // drops them and remembers where VortexList stored them instead, and
+    // getCoefficient returns null coefficients for it. Callers check
+    // isSummary and reload through VortexList::recordWithCoefficients.
+    bool hasCoefficients() const { return coefficients != NULL; }
+    bool isSummary() const { return (coefficients == NULL) && (_coefficientOffset >= 0); }
+    void allocateCoefficients();
+    void clearCoefficients();
+    static int getNumCoefficientSlots() { return MAXWAVENUM*2+3; }
+    inline qint64 getCoefficientOffset() const       { return _coefficientOffset; }
+    inline void   setCoefficientOffset(qint64 offset) { _coefficientOffset = offset; }
+
     // void operator = (const VortexData &other);
     bool operator ==(const VortexData &other);
     bool operator < (const VortexData &other);
@@ -128,7 +145,13 @@ private:
     float _RMW[MAXLEVELS];
     float _RMWUncertainty[MAXLEVELS];
     float _centerSD[MAXLEVELS];
-    Coefficient coefficients[MAXLEVELS][MAXRADII][MAXWAVENUM*2+3];
+    // MAXLEVELS x MAXRADII x (MAXWAVENUM*2+3), or NULL until a coefficient
+    // is set. Coefficients hold no strings, so this is one dense block of
+    // floats and parameter indices.
+    Coefficient* coefficients;
+    qint64 _coefficientOffset;
+    inline int coefficientIndex(int lev, int rad, int coeffNum) const
+    { return (lev*MAXRADII + rad)*(MAXWAVENUM*2+3) + coeffNum; }
 
     QDateTime _time;
     float _maxValidRadius;
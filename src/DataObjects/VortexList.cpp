@@ -11,17 +11,20 @@
 
 #include <QDir>
 #include <QXmlStreamWriter>
+#include <QDataStream>
 #include <QFile>
 #include <QStringList>
 #include <QString>
 #include <math.h>
 #include <iostream>
 #include "VortexList.h"
+#include "Message.h"
 
 
-VortexList::VortexList(QString filePath) : QList<VortexData>()
+VortexList::VortexList(QString filePath)
 {
     _filePath = filePath;
+    _storeGarbage = 0;
 }
 
 VortexList::~VortexList()
@@ -72,9 +75,192 @@ bool VortexList::restore()
     return false;
 }
 
-void VortexList::setFilePath(QString newFileName)
+bool VortexList::setFilePath(QString newFileName)
 {
+    QString oldStorePath = coefficientStorePath();
     _filePath = newFileName;
+
+    // The store only backs records in this list, start it over with the
+    // list or take it along to the new path
+    if(isEmpty()) {
+        QFile::remove(coefficientStorePath());
+        _storeGarbage = 0;
+    } else if(!oldStorePath.isEmpty() && (oldStorePath != coefficientStorePath())) {
+        QFile::remove(coefficientStorePath());
+        if(QFile::exists(oldStorePath) && !QFile::rename(oldStorePath, coefficientStorePath())) {
+            Message::toScreen("VortexList: Cannot move "+oldStorePath+" to "+coefficientStorePath());
+            return false;
+        }
+    }
+    return true;
+}
+
+QString VortexList::coefficientStorePath() const
+{
+    if(_filePath.isEmpty())
+        return QString();
+    QString path = _filePath;
+    if(path.endsWith(".xml"))
+        path.chop(4);
+    return path + "_coefficients.dat";
+}
+
+bool VortexList::append(const VortexData &record)
+{
+    records.append(record);
+    if(_filePath.isEmpty() || !record.hasCoefficients())
+        return true;
+    // Without a store the full record stays in memory as before
+    if(!storeCoefficients(records.last(), coefficientStorePath())) {
+        Message::toScreen("VortexList: Cannot store coefficients in "+coefficientStorePath());
+        return false;
+    }
+    return true;
+}
+
+bool VortexList::removeAt(int i)
+{
+    if(records.at(i).getCoefficientOffset() >= 0)
+        _storeGarbage += storedSize(records.at(i));
+    records.removeAt(i);
+
+    // Rewrite the store once most of it belongs to removed records, so
+    // removing is cheap but the file does not grow without bound
+    if(_storeGarbage > 0) {
+        qint64 storeSize = QFileInfo(coefficientStorePath()).size();
+        if(2*_storeGarbage >= storeSize)
+            return compactCoefficients();
+    }
+    return true;
+}
+
+void VortexList::clear()
+{
+    records.clear();
+    if(!_filePath.isEmpty())
+        QFile::remove(coefficientStorePath());
+    _storeGarbage = 0;
+}
+
+bool VortexList::recordWithCoefficients(int i, VortexData &record) const
+{
+    record = records.at(i);
+    if(record.hasCoefficients() || (record.getCoefficientOffset() < 0))
+        return true;
+    if(!loadCoefficients(record)) {
+        Message::toScreen("VortexList: Cannot read coefficients from "+coefficientStorePath());
+        return false;
+    }
+    return true;
+}
+
+qint64 VortexList::storedSize(const VortexData &record)
+{
+    // Three counts, then level, radius, value and parameter for each slot
+    return 3*sizeof(qint32) + qint64(record.getNumLevels()) * record.getNumRadii()
+        * VortexData::getNumCoefficientSlots() * (3*sizeof(float) + sizeof(qint32));
+}
+
+bool VortexList::compactCoefficients()
+{
+    // Copy the live records into a new store one at a time, and only
+    // switch the offsets over once it is complete
+    QString storePath = coefficientStorePath();
+    QString newStorePath = storePath + ".tmp";
+    QFile::remove(newStorePath);
+    QList<qint64> newOffsets;
+    for(int i = 0; i < records.count(); i++) {
+        VortexData record = records.at(i);
+        if(record.getCoefficientOffset() < 0) {
+            newOffsets.append(-1);
+            continue;
+        }
+        if(!loadCoefficients(record) || !storeCoefficients(record, newStorePath)) {
+            Message::toScreen("VortexList: Cannot compact coefficients in "+storePath);
+            QFile::remove(newStorePath);
+            return false;
+        }
+        newOffsets.append(record.getCoefficientOffset());
+    }
+
+    QFile::remove(storePath);
+    if((newOffsets.count(-1) < newOffsets.count()) && !QFile::rename(newStorePath, storePath)) {
+        Message::toScreen("VortexList: Cannot replace "+storePath);
+        return false;
+    }
+    for(int i = 0; i < records.count(); i++)
+        records[i].setCoefficientOffset(newOffsets.at(i));
+    _storeGarbage = 0;
+    return true;
+}
+
+bool VortexList::storeCoefficients(VortexData &record, const QString &storePath)
+{
+    // Records are appended as the level, ring and slot counts followed by
+    // level, radius, value and parameter index for every slot
+    QFile file(storePath);
+    if(!file.open(QIODevice::WriteOnly|QIODevice::Append))
+        return false;
+    qint64 offset = file.size();
+    QDataStream out(&file);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    int numSlots = VortexData::getNumCoefficientSlots();
+    out << qint32(record.getNumLevels()) << qint32(record.getNumRadii()) << qint32(numSlots);
+    for(int lev = 0; lev < record.getNumLevels(); lev++)
+        for(int rad = 0; rad < record.getNumRadii(); rad++)
+            for(int slot = 0; slot < numSlots; slot++) {
+                Coefficient current = record.getCoefficient(lev, rad, slot);
+                out << current.getLevel() << current.getRadius() << current.getValue()
+                    << qint32(current.getParameterIndex());
+            }
+    if(out.status() != QDataStream::Ok)
+        return false;
+
+    record.setCoefficientOffset(offset);
+    record.clearCoefficients();
+    return true;
+}
+
+bool VortexList::loadCoefficients(VortexData &record) const
+{
+    if(record.hasCoefficients())
+        return true;
+    if(record.getCoefficientOffset() < 0)
+        return false;
+
+    QFile file(coefficientStorePath());
+    if(!file.open(QIODevice::ReadOnly) || !file.seek(record.getCoefficientOffset()))
+        return false;
+    QDataStream in(&file);
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    qint32 numLevels, numRadii, numSlots;
+    in >> numLevels >> numRadii >> numSlots;
+    if((numLevels > VortexData::getMaxLevels()) || (numRadii > VortexData::getMaxRadii())
+       || (numSlots != VortexData::getNumCoefficientSlots()))
+        return false;
+    record.allocateCoefficients();
+    for(int lev = 0; lev < numLevels; lev++)
+        for(int rad = 0; rad < numRadii; rad++)
+            for(int slot = 0; slot < numSlots; slot++) {
+                float level, radius, value;
+                qint32 parameter;
+                in >> level >> radius >> value >> parameter;
+                if((parameter < 0) || (parameter >= Coefficient::NumParameters))
+                    parameter = Coefficient::NullParameter;
+                Coefficient current;
+                current.setLevel(level);
+                current.setRadius(radius);
+                current.setValue(value);
+                current.setParameter(Coefficient::Parameter(parameter));
+                record.setCoefficient(lev, rad, slot, current);
+            }
+    if(in.status() != QDataStream::Ok) {
+        record.clearCoefficients();
+        return false;
+    }
+    return true;
 }
 
 
@@ -83,5 +269,5 @@ void VortexList::timeSort()
     for(int i = 0; i < this->count(); i++)
         for(int j = i+1; j < this->count(); j++)
             if(this->at(i).getTime()>this->at(j).getTime())
-                this->swap(j,i);
+                records.swap(j,i);
 }
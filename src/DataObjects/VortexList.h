@@ -17,7 +17,7 @@
 
 class QString;
 
-class VortexList : public QList<VortexData>
+class VortexList
 {
 
 public:
@@ -26,11 +26,49 @@ public:
      
      bool saveXML();
      bool restore();
-     void setFilePath(QString filePath);
+     bool setFilePath(QString filePath);
      void timeSort();
 
+     // Read access to the records. Once a file path is set the records
+     // are summaries, their coefficients are in a store next to the XML
+     // file, see recordWithCoefficients.
+     const VortexData &at(int i) const       { return records.at(i); }
+     VortexData value(int i) const           { return records.value(i); }
+     const VortexData &first() const         { return records.first(); }
+     const VortexData &last() const          { return records.last(); }
+     int count() const                       { return records.count(); }
+     int size() const                        { return records.size(); }
+     bool isEmpty() const                    { return records.isEmpty(); }
+
+     // Records are only added and removed through these, so every record
+     // with coefficients goes through the store and removed records are
+     // dropped from it. append moves the record's coefficients to the
+     // store, so memory stays flat over long runs. It returns false if
+     // the store could not be written, the record is then kept whole.
+     // removeAt returns false if the store could not be compacted, the
+     // record is removed either way.
+     bool append(const VortexData &record);
+     VortexList &operator<<(const VortexData &record) { append(record); return *this; }
+     bool removeAt(int i);
+     void clear();
+
+     // Copies record i into record with its coefficients, read back from
+     // the store if they were moved there. Returns false if they could
+     // not be read, record is then the summary. Coefficient consumers go
+     // through this, getCoefficient on a summary returns null coefficients.
+     bool recordWithCoefficients(int i, VortexData &record) const;
+     bool loadCoefficients(VortexData &record) const;
+     QString coefficientStorePath() const;
+
 private:
+     QList<VortexData> records;
      QString _filePath;
+     // Bytes of the store that belong to removed records
+     qint64 _storeGarbage;
+
+     bool storeCoefficients(VortexData &record, const QString &storePath);
+     static qint64 storedSize(const VortexData &record);
+     bool compactCoefficients();
 };
 
 #endif
@@ -0,0 +1,158 @@
+/*
+ *  DirectoryWatcher.cpp
+ *  VORTRAC
+ *
+ *  Reports files as they are finished in a data directory.
+ *
+ */
+
+#include "DirectoryWatcher.h"
+#include <QtGlobal>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <unistd.h>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
+
+DirectoryWatcher::DirectoryWatcher(const QString& path)
+{
+  notifyDescriptor = -1;
+  watchDescriptor = -1;
+  overflowed = false;
+
+#ifdef Q_OS_LINUX
+  notifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (notifyDescriptor < 0)
+    return;
+  QByteArray nativePath = QFile::encodeName(path);
+  watchDescriptor = inotify_add_watch(notifyDescriptor, nativePath.constData(),
+				      IN_CLOSE_WRITE | IN_MOVED_TO | IN_MODIFY);
+  if (watchDescriptor < 0) {
+    close(notifyDescriptor);
+    notifyDescriptor = -1;
+  }
+#else
+  Q_UNUSED(path);
+#endif
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+  if (notifyDescriptor >= 0)
+    close(notifyDescriptor);
+}
+
+QStringList DirectoryWatcher::finishedFiles()
+{
+  readEvents();
+  QStringList files = pending;
+  pending.clear();
+  return files;
+}
+
+bool DirectoryWatcher::takeMovedIn(const QString& name)
+{
+  return movedIn.remove(name);
+}
+
+bool DirectoryWatcher::needsRescan()
+{
+  readEvents();
+  bool rescan = overflowed;
+  overflowed = false;
+  return rescan;
+}
+
+bool DirectoryWatcher::waitForFiles(int msecs)
+{
+  readEvents();
+  if (!pending.isEmpty())
+    return true;
+
+#ifdef Q_OS_LINUX
+  if (notifyDescriptor >= 0) {
+    // Writes to a file still open wake the poll too, keep waiting until
+    // one is finished
+    QElapsedTimer timer;
+    timer.start();
+    int remaining = msecs;
+    while (remaining > 0) {
+      struct pollfd request;
+      request.fd = notifyDescriptor;
+      request.events = POLLIN;
+      request.revents = 0;
+      if (poll(&request, 1, remaining) > 0)
+	readEvents();
+      if (!pending.isEmpty())
+	return true;
+      remaining = msecs - int(timer.elapsed());
+    }
+    return false;
+  }
+#endif
+
+  usleep(msecs * 1000);
+  return false;
+}
+
+void DirectoryWatcher::waitForChange(int msecs)
+{
+#ifdef Q_OS_LINUX
+  if (notifyDescriptor >= 0) {
+    struct pollfd request;
+    request.fd = notifyDescriptor;
+    request.events = POLLIN;
+    request.revents = 0;
+    if (poll(&request, 1, msecs) > 0)
+      readEvents();
+    return;
+  }
+#endif
+
+  usleep(msecs * 1000);
+}
+
+bool DirectoryWatcher::isQuiet(const QString& path)
+{
+  QFileInfo info(path);
+  if (!info.exists())
+    return true;
+  return info.lastModified().msecsTo(QDateTime::currentDateTime()) >= 2000;
+}
+
+void DirectoryWatcher::readEvents()
+{
+#ifdef Q_OS_LINUX
+  if (notifyDescriptor < 0)
+    return;
+
+  // Aligned for the event structs, large enough for a burst of names
+  char buffer[16384] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  while (true) {
+    ssize_t length = read(notifyDescriptor, buffer, sizeof(buffer));
+    if (length <= 0)
+      break;
+    for (char *ptr = buffer; ptr < buffer + length; ) {
+      const struct inotify_event *event = (const struct inotify_event *) ptr;
+      if (event->mask & IN_Q_OVERFLOW) {
+	overflowed = true;
+      } else if (event->mask & IN_MODIFY) {
+	// Only wakes waitForChange, the file is not finished
+      } else if ((event->len > 0) && !(event->mask & IN_ISDIR)) {
+	QString name = QFile::decodeName(event->name);
+	pending.append(name);
+	if (event->mask & IN_MOVED_TO)
+	  movedIn.insert(name);
+	else
+	  movedIn.remove(name);
+      }
+      ptr += sizeof(struct inotify_event) + event->len;
+    }
+  }
+#endif
+}
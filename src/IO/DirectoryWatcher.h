@@ -0,0 +1,71 @@
+/*
+ *  DirectoryWatcher.h
+ *  VORTRAC
+ *
+ *  Reports files as they are finished in a data directory.
+ *
+ */
+
+#ifndef DIRECTORYWATCHER_H
+#define DIRECTORYWATCHER_H
+
+#include <QString>
+#include <QStringList>
+#include <QSet>
+
+// Watches one directory with inotify for files that are closed after
+// writing or moved in, so the factories can pick up new data without
+// listing the directory. Either event is taken to mean the file is
+// complete; only the streaming ingest, which reads a file while it is
+// written, needs to tell a move from a close. Only available on Linux,
+// elsewhere isValid() is false and the caller keeps scanning the
+// directory.
+class DirectoryWatcher
+{
+
+public:
+  DirectoryWatcher(const QString& path);
+  ~DirectoryWatcher();
+
+  bool isValid() const { return watchDescriptor >= 0; }
+
+  QStringList finishedFiles();
+  // The names of the files closed after writing or moved in since the
+  // last call, in the order the events arrived. Does not block.
+
+  bool takeMovedIn(const QString& name);
+  // True if the last event for name was a move into the directory, so the
+  // file was written elsewhere and is complete. Forgets the name.
+
+  bool needsRescan();
+  // True if events were lost since the last call, the directory should
+  // be listed again to catch up. Clears the flag.
+
+  bool waitForFiles(int msecs);
+  // Blocks until a file is finished or msecs have passed, returns true
+  // if there is something to read with finishedFiles.
+
+  void waitForChange(int msecs);
+  // Blocks until the next event in the directory or msecs have passed,
+  // whether or not earlier files are still to be read. Writes to a file
+  // still being written count, for readers that follow one as it grows.
+
+  static bool isQuiet(const QString& path);
+  // True if the file has not been written for a couple of seconds, for
+  // files found by listing the directory that no event vouches for.
+
+private:
+  DirectoryWatcher(const DirectoryWatcher &);
+  DirectoryWatcher &operator=(const DirectoryWatcher &);
+
+  void readEvents();
+
+  int notifyDescriptor;
+  int watchDescriptor;
+  bool overflowed;
+  QStringList pending;
+  QSet<QString> movedIn;
+
+};
+
+#endif
@@ -0,0 +1,191 @@
+/*
+ *  RunningMedian.h
+ *  VORTRAC
+ *
+ *  Order statistic of a sliding window, used by the BB dealiasing.
+ *
+ */
+
+#ifndef RUNNINGMEDIAN_H
+#define RUNNINGMEDIAN_H
+
+// Keeps a multiset of up to capacity values split across two heaps so the
+// value of a fixed rank can be read in constant time and any value can be
+// inserted or removed in O(log n). The lower heap is a max heap holding the
+// rank+1 smallest values, the upper heap a min heap holding the rest. All
+// storage is allocated by the constructor, nothing is allocated per value.
+class RunningMedian
+{
+
+public:
+
+  // capacity is the most values held at once, rank is the zero based
+  // position in sorted order returned by value()
+  RunningMedian(int capacity, int rank)
+  {
+    _capacity = capacity;
+    _rank = rank;
+    _values = new float[capacity];
+    _lower = new int[capacity];
+    _upper = new int[capacity];
+    _heapIndex = new int[capacity];
+    _inLower = new bool[capacity];
+    _free = new int[capacity];
+    clear();
+  }
+
+  ~RunningMedian()
+  {
+    delete[] _values;
+    delete[] _lower;
+    delete[] _upper;
+    delete[] _heapIndex;
+    delete[] _inLower;
+    delete[] _free;
+  }
+
+  // Remove all values
+  void clear()
+  {
+    _lowerSize = _upperSize = 0;
+    for (int id = 0; id < _capacity; id++)
+      _free[id] = _capacity - 1 - id;
+    _freeSize = _capacity;
+  }
+
+  int size() const { return _lowerSize + _upperSize; }
+
+  // Add v and return a handle that can be passed to remove()
+  int insert(float v)
+  {
+    int id = _free[--_freeSize];
+    _values[id] = v;
+    if ((_lowerSize == 0) || (v <= _values[_lower[0]]))
+      push(true, id);
+    else
+      push(false, id);
+    rebalance();
+    return id;
+  }
+
+  // Remove the value with handle id
+  void remove(int id)
+  {
+    bool lower = _inLower[id];
+    int *heap = lower ? _lower : _upper;
+    int &heapSize = lower ? _lowerSize : _upperSize;
+    int index = _heapIndex[id];
+    heapSize--;
+    if (index != heapSize) {
+      int moved = heap[heapSize];
+      place(lower, index, moved);
+      siftUp(lower, index);
+      siftDown(lower, _heapIndex[moved]);
+    }
+    _free[_freeSize++] = id;
+    rebalance();
+  }
+
+  // The value at position rank in sorted order, or the largest value if
+  // fewer than rank+1 values are held
+  float value() const { return _values[_lower[0]]; }
+
+private:
+
+  RunningMedian(const RunningMedian &);
+  RunningMedian &operator=(const RunningMedian &);
+
+  // True if a belongs above b in the given heap
+  bool before(bool lower, int a, int b) const
+  {
+    return lower ? (_values[a] > _values[b]) : (_values[a] < _values[b]);
+  }
+
+  void place(bool lower, int index, int id)
+  {
+    (lower ? _lower : _upper)[index] = id;
+    _heapIndex[id] = index;
+    _inLower[id] = lower;
+  }
+
+  void push(bool lower, int id)
+  {
+    int index = lower ? _lowerSize++ : _upperSize++;
+    place(lower, index, id);
+    siftUp(lower, index);
+  }
+
+  int pop(bool lower)
+  {
+    int *heap = lower ? _lower : _upper;
+    int &heapSize = lower ? _lowerSize : _upperSize;
+    int top = heap[0];
+    heapSize--;
+    if (heapSize > 0) {
+      place(lower, 0, heap[heapSize]);
+      siftDown(lower, 0);
+    }
+    return top;
+  }
+
+  void siftUp(bool lower, int index)
+  {
+    int *heap = lower ? _lower : _upper;
+    int id = heap[index];
+    while (index > 0) {
+      int parent = (index - 1) / 2;
+      if (!before(lower, id, heap[parent]))
+        break;
+      place(lower, index, heap[parent]);
+      index = parent;
+    }
+    place(lower, index, id);
+  }
+
+  void siftDown(bool lower, int index)
+  {
+    int *heap = lower ? _lower : _upper;
+    int heapSize = lower ? _lowerSize : _upperSize;
+    int id = heap[index];
+    while (true) {
+      int child = 2 * index + 1;
+      if (child >= heapSize)
+        break;
+      if ((child + 1 < heapSize) && before(lower, heap[child + 1], heap[child]))
+        child++;
+      if (!before(lower, heap[child], id))
+        break;
+      place(lower, index, heap[child]);
+      index = child;
+    }
+    place(lower, index, id);
+  }
+
+  // Move heap tops across until the lower heap holds rank+1 values, or
+  // all of them if there are fewer
+  void rebalance()
+  {
+    int target = _rank + 1;
+    if (target > size())
+      target = size();
+    while (_lowerSize > target)
+      push(false, pop(true));
+    while (_lowerSize < target)
+      push(true, pop(false));
+  }
+
+  int _capacity;
+  int _rank;
+  float *_values;
+  int *_lower;
+  int *_upper;
+  int *_heapIndex;
+  bool *_inLower;
+  int *_free;
+  int _lowerSize;
+  int _upperSize;
+  int _freeSize;
+
+};
+
+#endif
@@ -0,0 +1,103 @@
+/*
+ *  SmallMatrix.h
+ *  VORTRAC
+ *
+ *  Fixed size least squares kernels for the VTD ring fits.
+ *
+ */
+
+#ifndef SMALLMATRIX_H
+#define SMALLMATRIX_H
+
+#include <math.h>
+
+// Solves numCoeffs x numCoeffs normal equations, see SmallMatrix::solveNormal
+typedef bool (*NormalSolver)(int numCoeffs, const float* a, float* b);
+
+class SmallMatrix
+{
+
+public:
+
+  // Largest coefficient count with a compiled kernel, maxWave 7
+  static const int maxCoeffs = 17;
+
+  // Solve a x = b for symmetric positive definite a by Cholesky
+  // factorization. a is N x N, row major and contiguous, and only its
+  // lower triangle is read. b is replaced by x only if the solve
+  // succeeds, so the caller can fall back to Matrix::gaussJordan when a
+  // is not positive definite.
+  template <int N>
+  static bool choleskySolve(const float* a, float* b)
+  {
+    // Factor a = L L' in double, the normal equations square the
+    // condition number of the ring fit
+    double L[N][N];
+    for (int row = 0; row < N; row++) {
+      for (int col = 0; col <= row; col++) {
+        double sum = a[row * N + col];
+        for (int k = 0; k < col; k++)
+          sum -= L[row][k] * L[col][k];
+        if (row == col) {
+          if (sum <= 0.0)
+            return false;
+          L[row][row] = sqrt(sum);
+        } else {
+          L[row][col] = sum / L[col][col];
+        }
+      }
+    }
+
+    // Forward substitution L y = b
+    double y[N];
+    for (int row = 0; row < N; row++) {
+      double sum = b[row];
+      for (int k = 0; k < row; k++)
+        sum -= L[row][k] * y[k];
+      y[row] = sum / L[row][row];
+    }
+
+    // Back substitution L' x = y
+    double x[N];
+    for (int row = N - 1; row >= 0; row--) {
+      double sum = y[row];
+      for (int k = row + 1; k < N; k++)
+        sum -= L[k][row] * x[k];
+      x[row] = sum / L[row][row];
+    }
+
+    for (int row = 0; row < N; row++)
+      b[row] = float(x[row]);
+    return true;
+  }
+
+  // Dispatch to the kernel compiled for numCoeffs. The VTD fits always
+  // use an odd number of coefficients, 1 + 2 per wavenumber.
+  static bool solveNormal(int numCoeffs, const float* a, float* b)
+  {
+    switch (numCoeffs) {
+    case 1:  return choleskySolve<1>(a, b);
+    case 3:  return choleskySolve<3>(a, b);
+    case 5:  return choleskySolve<5>(a, b);
+    case 7:  return choleskySolve<7>(a, b);
+    case 9:  return choleskySolve<9>(a, b);
+    case 11: return choleskySolve<11>(a, b);
+    case 13: return choleskySolve<13>(a, b);
+    case 15: return choleskySolve<15>(a, b);
+    case 17: return choleskySolve<17>(a, b);
+    default: return false;
+    }
+  }
+
+  // The solver to use for fits up to maxWave, or NULL if the coefficient
+  // count is too large for the compiled kernels
+  static NormalSolver normalSolver(int maxWave)
+  {
+    if ((maxWave < 0) || (maxWave * 2 + 3 > maxCoeffs))
+      return NULL;
+    return &SmallMatrix::solveNormal;
+  }
+
+};
+
+#endif
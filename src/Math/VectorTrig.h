@@ -0,0 +1,208 @@
+/*
+ *  VectorTrig.h
+ *  VORTRAC
+ *
+ *  sin, cos and atan2 over arrays for the VTD ring fits.
+ *
+ */
+
+#ifndef VECTORTRIG_H
+#define VECTORTRIG_H
+
+#include <float.h>
+#include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// The polynomials are the single precision ones from Cephes (sinf, cosf
+// and atanf), good to a few ulp for the angles of a ring. Four points
+// are done at a time with SSE2 where it is available; the scalar code
+// evaluates the same polynomials in the same order, so the result does
+// not depend on which path a point takes.
+class VectorTrig
+{
+
+public:
+
+  // s[i] = sin(x[i]) and c[i] = cos(x[i]) for |x[i]| below about 8000
+  static void sinCos(const float* x, float* s, float* c, int n)
+  {
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= n; i += 4) {
+      __m128 sv, cv;
+      sinCos4(_mm_loadu_ps(x + i), sv, cv);
+      _mm_storeu_ps(s + i, sv);
+      _mm_storeu_ps(c + i, cv);
+    }
+#endif
+    for (; i < n; i++)
+      sinCos1(x[i], s[i], c[i]);
+  }
+
+  // a[i] = atan2(y[i], x[i]). a may be the same array as y or x.
+  static void atan2(const float* y, const float* x, float* a, int n)
+  {
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= n; i += 4)
+      _mm_storeu_ps(a + i, atan2_4(_mm_loadu_ps(y + i), _mm_loadu_ps(x + i)));
+#endif
+    for (; i < n; i++)
+      a[i] = atan2_1(y[i], x[i]);
+  }
+
+private:
+
+  // Reduce by multiples of Pi/4 in three parts so the reduction is exact
+  // for the angles we see
+  static float fourOverPi() { return 1.27323954473516f; }
+  static float dp1() { return 0.78515625f; }
+  static float dp2() { return 2.4187564849853515625e-4f; }
+  static float dp3() { return 3.77489497744594108e-8f; }
+  static float tanPiOver8() { return 0.4142135623730950f; }
+  static float piOver4() { return 0.785398163397448f; }
+  static float piOver2() { return 1.5707963267948966f; }
+  static float pi() { return 3.14159265358979f; }
+
+  static void sinCos1(float x, float& s, float& c)
+  {
+    float ax = (x < 0) ? -x : x;
+    int j = int(ax * fourOverPi());
+    j = (j + 1) & ~1;
+    float y = float(j);
+    float r = ((ax - y * dp1()) - y * dp2()) - y * dp3();
+    float z = r * r;
+
+    float cosPoly = 2.443315711809948e-5f * z - 1.388731625493765e-3f;
+    cosPoly = cosPoly * z + 4.166664568298827e-2f;
+    cosPoly = cosPoly * z * z;
+    cosPoly = cosPoly - 0.5f * z;
+    cosPoly = cosPoly + 1.f;
+    float sinPoly = -1.9515295891e-4f * z + 8.3321608736e-3f;
+    sinPoly = sinPoly * z - 1.6666654611e-1f;
+    sinPoly = sinPoly * z * r;
+    sinPoly = sinPoly + r;
+
+    bool swap = (j & 2) != 0;
+    bool sinNegative = (x < 0) != ((j & 4) != 0);
+    bool cosNegative = ((j - 2) & 4) == 0;
+    s = swap ? cosPoly : sinPoly;
+    c = swap ? sinPoly : cosPoly;
+    if (sinNegative)
+      s = -s;
+    if (cosNegative)
+      c = -c;
+  }
+
+  // atan of t in [0, 1]
+  static float atanUnit(float t)
+  {
+    float offset = 0;
+    if (t > tanPiOver8()) {
+      offset = piOver4();
+      t = (t - 1.f) / (t + 1.f);
+    }
+    float z = t * t;
+    float p = 8.05374449538e-2f * z - 1.38776856032e-1f;
+    p = p * z + 1.99777106478e-1f;
+    p = p * z - 3.33329491539e-1f;
+    p = p * z * t;
+    p = p + t;
+    return offset + p;
+  }
+
+  static float atan2_1(float y, float x)
+  {
+    float ax = (x < 0) ? -x : x;
+    float ay = (y < 0) ? -y : y;
+    float big = (ax > ay) ? ax : ay;
+    float small = (ax > ay) ? ay : ax;
+    if (big < FLT_MIN)
+      big = FLT_MIN;
+    float a = atanUnit(small / big);
+    if (ay > ax)
+      a = piOver2() - a;
+    if (x < 0)
+      a = pi() - a;
+    // a is not negative here, so this only takes the sign of y
+    return copysignf(a, y);
+  }
+
+#if defined(__SSE2__)
+  static void sinCos4(__m128 x, __m128& s, __m128& c)
+  {
+    const __m128 signBit = _mm_set1_ps(-0.f);
+    __m128 sinSign = _mm_and_ps(x, signBit);
+    __m128 ax = _mm_andnot_ps(signBit, x);
+
+    __m128i j = _mm_cvttps_epi32(_mm_mul_ps(ax, _mm_set1_ps(fourOverPi())));
+    j = _mm_add_epi32(j, _mm_set1_epi32(1));
+    j = _mm_and_si128(j, _mm_set1_epi32(~1));
+    __m128 y = _mm_cvtepi32_ps(j);
+    __m128 r = _mm_sub_ps(ax, _mm_mul_ps(y, _mm_set1_ps(dp1())));
+    r = _mm_sub_ps(r, _mm_mul_ps(y, _mm_set1_ps(dp2())));
+    r = _mm_sub_ps(r, _mm_mul_ps(y, _mm_set1_ps(dp3())));
+    __m128 z = _mm_mul_ps(r, r);
+
+    __m128 cosPoly = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), z),
+                                _mm_set1_ps(1.388731625493765e-3f));
+    cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(4.166664568298827e-2f));
+    cosPoly = _mm_mul_ps(_mm_mul_ps(cosPoly, z), z);
+    cosPoly = _mm_sub_ps(cosPoly, _mm_mul_ps(_mm_set1_ps(0.5f), z));
+    cosPoly = _mm_add_ps(cosPoly, _mm_set1_ps(1.f));
+    __m128 sinPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), z),
+                                _mm_set1_ps(8.3321608736e-3f));
+    sinPoly = _mm_sub_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(1.6666654611e-1f));
+    sinPoly = _mm_mul_ps(_mm_mul_ps(sinPoly, z), r);
+    sinPoly = _mm_add_ps(sinPoly, r);
+
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)),
+                                                   _mm_set1_epi32(2)));
+    __m128 sinFlip = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29));
+    __m128 cosFlip = _mm_castsi128_ps(_mm_slli_epi32(
+        _mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+
+    s = _mm_or_ps(_mm_and_ps(swap, cosPoly), _mm_andnot_ps(swap, sinPoly));
+    c = _mm_or_ps(_mm_and_ps(swap, sinPoly), _mm_andnot_ps(swap, cosPoly));
+    s = _mm_xor_ps(s, _mm_xor_ps(sinSign, sinFlip));
+    c = _mm_xor_ps(c, cosFlip);
+  }
+
+  static __m128 atan2_4(__m128 y, __m128 x)
+  {
+    const __m128 signBit = _mm_set1_ps(-0.f);
+    const __m128 one = _mm_set1_ps(1.f);
+    __m128 ax = _mm_andnot_ps(signBit, x);
+    __m128 ay = _mm_andnot_ps(signBit, y);
+    __m128 big = _mm_max_ps(_mm_max_ps(ax, ay), _mm_set1_ps(FLT_MIN));
+    __m128 t = _mm_div_ps(_mm_min_ps(ax, ay), big);
+
+    __m128 reduce = _mm_cmpgt_ps(t, _mm_set1_ps(tanPiOver8()));
+    __m128 tReduced = _mm_div_ps(_mm_sub_ps(t, one), _mm_add_ps(t, one));
+    t = _mm_or_ps(_mm_and_ps(reduce, tReduced), _mm_andnot_ps(reduce, t));
+    __m128 offset = _mm_and_ps(reduce, _mm_set1_ps(piOver4()));
+
+    __m128 z = _mm_mul_ps(t, t);
+    __m128 p = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(8.05374449538e-2f), z),
+                          _mm_set1_ps(1.38776856032e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, z), _mm_set1_ps(1.99777106478e-1f));
+    p = _mm_sub_ps(_mm_mul_ps(p, z), _mm_set1_ps(3.33329491539e-1f));
+    p = _mm_mul_ps(_mm_mul_ps(p, z), t);
+    p = _mm_add_ps(p, t);
+    __m128 a = _mm_add_ps(offset, p);
+
+    __m128 steep = _mm_cmpgt_ps(ay, ax);
+    a = _mm_or_ps(_mm_and_ps(steep, _mm_sub_ps(_mm_set1_ps(piOver2()), a)),
+                  _mm_andnot_ps(steep, a));
+    __m128 left = _mm_cmplt_ps(x, _mm_setzero_ps());
+    a = _mm_or_ps(_mm_and_ps(left, _mm_sub_ps(_mm_set1_ps(pi()), a)),
+                  _mm_andnot_ps(left, a));
+    return _mm_or_ps(a, _mm_and_ps(y, signBit));
+  }
+#endif
+
+};
+
+#endif
@@ -191,6 +191,9 @@ long Hvvp::hvvpPrep(int m) {
 
 	//  out << " num sweeps = " << volume->getNumSweeps();
 
+	// Gate heights are shared with the gridding and QC
+	GateGeometry* geometry = volume->getGateGeometry();
+
 	for(int s = 0; s < volume->getNumSweeps(); s++) {
 		currentSweep = volume->getSweep(s);
 		//float elevation = currentSweep->getElevation();     // deg
@@ -217,6 +220,8 @@ long Hvvp::hvvpPrep(int m) {
 				aa = rotateAzimuth(aa)*deg2rad;
 				float sinaa = sin(aa);
 				float cosaa = cos(aa);
+				double cosElev = cos(elevation*deg2rad);
+				const float* velHeight = geometry->getVelHeight(r);
 				for(int v = first; v < numGates; v++) {
 					if(vel[v]!=velNull) {
 						// PH 10/2007.  need accurate range - previously missing first gate distance 
@@ -225,12 +230,12 @@ long Hvvp::hvvpPrep(int m) {
 						float srange =  float(currentRay->getFirst_vel_gate()+(v*currentRay->getVel_gatesp()))/1000.;
 
 						//	    float srange = (rangeStart+float(v)*vGateSpace);
-						float cu = srange/rt * cos(elevation*deg2rad);    // unitless
+						float cu = srange/rt * cosElev;    // unitless
 						//float alt = volume->absoluteRadarBeamHeight(srange, elevation);  // km
-						float alt = volume->radarBeamHeight(srange, elevation);  // km
+						float alt = velHeight[v];  // km
 						if((cu > cumin)&&(cu < cuthr)&&(alt >= hLow)&&(alt < hHigh)) {
 							float ee = elevation*deg2rad;
-							ee+=asin(srange*cos(elevation*deg2rad)/(ae+alt));
+							ee+=asin(srange*cosElev/(ae+alt));
 							float cosee = cos(ee);
 							float xx = srange*cosee*sinaa;
 							float yy = srange*cosee*cosaa;
@@ -10,13 +10,17 @@
 
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include <QInputDialog>
 #include <QString>
+#include <QtConcurrent>
+#include <QtAlgorithms>
 
 #include "RadarQC.h"
 #include "RadarData.h"
 #include "Message.h"
 #include "Math/Matrix.h"
+#include "Math/RunningMedian.h"
 
 RadarQC::RadarQC(RadarData *radarPtr, QObject *parent)
     :QObject(parent)
@@ -34,22 +38,74 @@ RadarQC::RadarQC(RadarData *radarPtr, QObject *parent)
     numCoEff = 3;
     vadLevels = 20;
     deg2rad = acos(-1.)/180.;
-    int vcp = radarData->getVCP();
     float zero = 0.0;
     radarHeight = radarData->absoluteRadarBeamHeight(zero,zero);
 
     //Message::toScreen("Radar Height = "+QString().setNum(radarHeight)+" check units and values");
 
-    // Allocate memory for the bincount
-    int numSweeps = radarData->getNumSweeps();
-    validBinCount = new float*[numSweeps];
+    // The sweeps are set up as they are QC'd, see prepareSweep, so the
+    // sweeps of a volume that is still arriving can be QC'd early
+    sweepsDone = 0;
+    wholeVolume = false;
+    splitCut = false;
+    clockwise = false;
+    q = 0;
+    qinc = 1;
+
+    // Reflectivity powers in the terminal fall speed for each Level II
+    // reflectivity code, codes 0 and 1 are missing data
+    for(int code = 0; code < 256; code++) {
+        fallDBZ[code] = (((float)code - 2.)/2.) - 32.0;
+        float zData = pow(10.0,(fallDBZ[code]/10.0));
+        fallRainFactor[code] = pow(zData,0.107);
+        fallIceFactor[code] = pow(zData,0.063);
+    }
+}
 
-    for (int i = 0; i < numSweeps; i++) {
-        Sweep *currentSweep = radarData->getSweep(i);
-        int numBins = (currentSweep->getVel_numgates() > 0) ? currentSweep->getVel_numgates() : 1;
-        validBinCount[i] = new float[numBins];
+void RadarQC::prepareSweeps(int count)
+{
+    for (int n = validBinCount.size(); n < count; n++)
+        prepareSweep(n);
+}
+
+void RadarQC::prepareSweep(int n)
+{
+    // Allocate memory for the bincount
+    Sweep *currentSweep = radarData->getSweep(n);
+    int numBins = (currentSweep->getVel_numgates() > 0) ? currentSweep->getVel_numgates() : 1;
+    validBinCount.append(new float[numBins]);
+
+    // Once the second sweep is in, see if the low sweeps are split cuts.
+    // The reflectivity of each surveillance sweep goes onto the Doppler
+    // sweep above it, which is set up next.
+    if (n == 1)
+        findSplitCuts();
+    if (splitCut && (n >= 1) && (n - 1 < q) && ((n - 1) % qinc == 0))
+        fillSplitCut(n - 1);
+
+    // Get maximum number of velocity gates in the sweep to get
+    // aveVADHeight, which is an average height in each sweep for each gate index
+    int sweepNumVelGates = currentSweep->getVel_numgates();
+    int first = currentSweep->getFirstRay();
+    int last = currentSweep->getLastRay();
+    float *heights = new float[sweepNumVelGates > 0 ? sweepNumVelGates : 1];
+    for(int v = 0; v < sweepNumVelGates; v++) {
+        heights[v] = 0;
+        int count = 0;
+        for(int r = first; r <= last; r++) {
+            Ray *currentRay = radarData->getRay(r);
+            if(v < currentRay->getVel_numgates()) {
+                count++;
+                heights[v] += findHeight(r,v);
+            }
+        }
+        heights[v] /= float(count);
     }
+    aveVADHeight.append(heights);
+}
 
+void RadarQC::findSplitCuts()
+{
     // (Paul Harasti 4/2009)
     // Reflectivity does not need to be interpolated if
     // the super resolution vcp is not recombined to legacy,
@@ -62,232 +118,249 @@ RadarQC::RadarQC(RadarData *radarPtr, QObject *parent)
     currentSweep = radarData->getSweep(1);
     float gatesp_sweep2 = currentSweep->getVel_gatesp();
 
-    if( (gatesp_sweep1 != gatesp_sweep2) ) {
+    splitCut = (gatesp_sweep1 != gatesp_sweep2);
+    if (!splitCut)
+        return;
+
+    int vcp = radarData->getVCP();
 
-        // Used to determine how the reflectivity data should be interpolated based
-        // on the vcp of the radar volume
+    // Used to determine how the reflectivity data should be interpolated based
+    // on the vcp of the radar volume
 
-        if( (vcp < 33)  || (vcp==211) || (vcp==212) ) {
-            q = 3;
-            if( (vcp == 12) || (vcp==212) ) {
-                q = 5;
-            }
-            qinc = 2;
-        }
-        if( (vcp == 121) || (vcp==221) ) {
+    if( (vcp < 33)  || (vcp==211) || (vcp==212) ) {
+        q = 3;
+        if( (vcp == 12) || (vcp==212) ) {
             q = 5;
-            qinc = 4;
         }
+        qinc = 2;
+    }
+    if( (vcp == 121) || (vcp==221) ) {
+        q = 5;
+        qinc = 4;
+    }
 
 
-        // Interpolating reflectivity to split levels
-
-        // Determine rotational direction of radar
-        bool clockwise = false;
-        float sumazdiff = 0.;
-        int k = 0;
-        Sweep *currentSweep = radarData->getSweep(k);
-        int start = currentSweep->getFirstRay();
-        float stop = start+int(currentSweep->getNumRays())/4;
-        float az1, az2;
-        for(int i = start; i <= stop; i++) {
-            az1 = radarData->getRay(i)->getAzimuth();
-            if(az1 < 0.0)
-                az1 +=360.0;
-            az2 = radarData->getRay(i+1)->getAzimuth();
-            if(az2 < 0.0)
-                az2+=360.0;
-            if((az1 < 10.0)&&(az2 > 350.0)) {
-                az1 +=360.0;
+    // Interpolating reflectivity to split levels
+
+    // Determine rotational direction of radar
+    clockwise = false;
+    float sumazdiff = 0.;
+    int k = 0;
+    currentSweep = radarData->getSweep(k);
+    int start = currentSweep->getFirstRay();
+    float stop = start+int(currentSweep->getNumRays())/4;
+    float az1, az2;
+    for(int i = start; i <= stop; i++) {
+        az1 = radarData->getRay(i)->getAzimuth();
+        if(az1 < 0.0)
+            az1 +=360.0;
+        az2 = radarData->getRay(i+1)->getAzimuth();
+        if(az2 < 0.0)
+            az2+=360.0;
+        if((az1 < 10.0)&&(az2 > 350.0)) {
+            az1 +=360.0;
+        }
+        if((az2 < 10.0)&&(az1 >350.0)) {
+            az2+=360;
+        }
+        sumazdiff += (az2-az1);
+        if(sumazdiff > 0.0)
+            clockwise = true;
+        else
+            clockwise = false;
+    }
+}
+
+void RadarQC::fillSplitCut(int i)
+{
+    // This parts interpolates reflectivity data of sweep i onto sweep i+1,
+    // which only contains velocity data.
+
+    int ifoundit = 0;
+    float a, b, c, den;
+    radarData->buildAzimuthIndex(i);
+    int upperFirst = radarData->getSweep(i+1)->getFirstRay();
+    //int upperLast = radarData->getSweep(i+1)->getLastRay();
+    int first = radarData->getSweep(i)->getFirstRay();
+    //int last = radarData->getSweep(i)->getLastRay();
+    int upperNumRays = radarData->getSweep(i+1)->getNumRays();
+    int numRays = radarData->getSweep(i)->getNumRays();
+    //Message::toScreen("upperNumRays = "+QString().setNum(upperNumRays));
+    float fac1[upperNumRays], fac2[upperNumRays];
+    int ipt1[upperNumRays], ipt2[upperNumRays];
+
+    // Only the first ray pair (j, j+1) of the lower sweep that
+    // brackets an upper ray is used. Rather than test every pair,
+    // find the widest azimuth span any pair can match over and
+    // test only the pairs whose first ray is within that span of
+    // the upper ray, in ray order. A degree of margin on each side
+    // covers the float rounding of the wrapped azimuths.
+    Sweep *lowerSweep = radarData->getSweep(i);
+    float maxSpan = 0;
+    for(int j = 0; j < numRays; j++) {
+        int r = (j+1 > numRays-1) ? j+1-numRays : j+1;
+        a = radarData->getRay(j+first)->getAzimuth();
+        b = radarData->getRay(r+first)->getAzimuth();
+        float span = -1;
+        if(clockwise) {
+            if((a > 350.0)&&(b < 10.0)) {
+                float wrapped = b + 360.;
+                span = wrapped - a;
+                wrapped = a - 360.;
+                if(b - wrapped > span)
+                    span = b - wrapped;
             }
-            if((az2 < 10.0)&&(az1 >350.0)) {
-                az2+=360;
+            else if(a <= b)
+                span = b - a;
+        }
+        else {
+            // Wrapped pairs never bracket counterclockwise
+            if(!((a < 10.0)&&(b > 350.0))&&(a >= b))
+                span = a - b;
+        }
+        if(span > maxSpan)
+            maxSpan = span;
+    }
+    int *candidates = new int[numRays];
+
+    for(int m = 0; m < upperNumRays; m++) {
+        ipt1[m] = 0;
+        ipt2[m] = 0;
+        fac1[m] = 0;
+        fac2[m] = 0;
+        ifoundit = 0;
+        c = radarData->getRay(m+upperFirst)->getAzimuth();
+        int lowBin = 0;
+        int highBin = Sweep::numAzimuthBins - 1;
+        if((maxSpan + 3 < Sweep::numAzimuthBins)&&(fabs(c) < 1.0e6)) {
+            if(clockwise) {
+                lowBin = (int)floor(c - maxSpan) - 1;
+                highBin = (int)floor(c) + 1;
+            }
+            else {
+                lowBin = (int)floor(c) - 1;
+                highBin = (int)floor(c + maxSpan) + 1;
             }
-            sumazdiff += (az2-az1);
-            if(sumazdiff > 0.0)
-                clockwise = true;
-            else
-                clockwise = false;
         }
-
-        /*
-  //Check to see which sweeps have reflectivity data...
-  // Used for testing the interpolation of ref data onto other sweeps
-
-  for(int s = 0; s < radarData->getNumSweeps(); s++) {
-  int num = radarData->getRay(radarData->getSweep(s)->getFirstRay())->getRef_numgates();
-  //Message::toScreen(("Num gates in first ray(# = "+QString().setNum(radarData->getSweep(s)->getFirstRay())+") of sweep "+QString().setNum(s)+" is "+QString().setNum(num)));
-  //emit log(Message(("Num gates in first ray(# = "+QString().setNum(radarData->getSweep(s)->getFirstRay())+") of sweep "+QString().setNum(s)+" is "+QString().setNum(num))));
-  }
-
-  //Message::toScreen("q = "+QString().setNum(q)+" qinc "+QString().setNum(qinc));
-
-  */
-
-        // This parts interpolates reflectivity data onto levels which only contain
-        // velocity data.
-
-        int ifoundit = 0;
-        float a, b, c, den;
-        for(int i = 0; ((i < q)&&(i<radarData->getNumSweeps()-1)); i+=qinc) {
-            int upperFirst = radarData->getSweep(i+1)->getFirstRay();
-            //int upperLast = radarData->getSweep(i+1)->getLastRay();
-            int first = radarData->getSweep(i)->getFirstRay();
-            //int last = radarData->getSweep(i)->getLastRay();
-            int upperNumRays = radarData->getSweep(i+1)->getNumRays();
-            int numRays = radarData->getSweep(i)->getNumRays();
-            //Message::toScreen("upperNumRays = "+QString().setNum(upperNumRays));
-            float fac1[upperNumRays], fac2[upperNumRays];
-            int ipt1[upperNumRays], ipt2[upperNumRays];
-            for(int m = 0; m < upperNumRays; m++) {
-                ipt1[m] = 0;
-                ipt2[m] = 0;
-                fac1[m] = 0;
-                fac2[m] = 0;
-                ifoundit = 0;
-                for(int j = 0; j < numRays; j++) {
-                    int r = j+1;
-                    // array out of bounds in j  - PH 10/2007
-                    //      if(r > numRays)
-                    if(r > numRays-1)
-                        r -=numRays;
-                    a = radarData->getRay(j+first)->getAzimuth();
-                    b = radarData->getRay(r+first)->getAzimuth();
-                    c = radarData->getRay(m+upperFirst)->getAzimuth();
-                    if(clockwise) {
-                        if((a > 350.0)&&(b < 10.0)&&(c < 10.0))
-                            a -=360.;
-                        if((a > 350.0)&&(b < 10.0)&&(c > 350.0))
-                            b +=360.;
-                        if((a <= c)&&(b >= c)){
-                            ifoundit ++;
-                            if(ifoundit==1) {
-                                den = b-a;
-                                if (den!=0.) {
-                                    fac1[m] = (b-c)/den;
-                                    fac2[m] = (c-a)/den;
-                                    ipt1[m] = j+first;
-                                    ipt2[m] = r+first;
-                                }
-                                else {
-                                    // PH 10/2007. Need for special case. See comment below.
-                                    fac1[m]=0.;
-                                    fac2[m]=0.;
-                                }
-                                // Set up num ref gates
-                                int numGates = radarData->getRay(j+first)->getRef_numgates();
-                                if(radarData->getRay(r+first)->getRef_numgates() < numGates)
-                                    numGates = radarData->getRay(r+first)->getRef_numgates();
-                                int firstGate = radarData->getRay(j+first)->getFirst_ref_gate();
-                                if(radarData->getRay(r+first)->getFirst_ref_gate() > firstGate)
-                                    firstGate = radarData->getRay(r+first)->getFirst_ref_gate();
-                                radarData->getRay(m+upperFirst)->emptyRefgates(numGates);
-                                radarData->getRay(m+upperFirst)->setFirst_ref_gate(firstGate);
-                                float sp1 = radarData->getRay(j+first)->getRef_gatesp();
-                                float sp2 = radarData->getRay(r+first)->getRef_gatesp();
-                                if(sp1!=sp2)
-                                    Message::toScreen("RadarQC: Error interpolating split level data: Cannot resolve reflectivity gate spacing");
-                                radarData->getRay(m+upperFirst)->setRef_gatesp(sp1);
-                            }
+        int numCandidates = 0;
+        for(int k = lowBin; k <= highBin; k++) {
+            int count;
+            const int *binRays = lowerSweep->getAzimuthBinRays(Sweep::azimuthBin(k), count);
+            for(int n = 0; n < count; n++)
+                candidates[numCandidates++] = binRays[n] - first;
+        }
+        qSort(candidates, candidates + numCandidates);
+        for(int n = 0; n < numCandidates; n++) {
+            int j = candidates[n];
+            int r = j+1;
+            // array out of bounds in j  - PH 10/2007
+            //      if(r > numRays)
+            if(r > numRays-1)
+                r -=numRays;
+            a = radarData->getRay(j+first)->getAzimuth();
+            b = radarData->getRay(r+first)->getAzimuth();
+            c = radarData->getRay(m+upperFirst)->getAzimuth();
+            if(clockwise) {
+                if((a > 350.0)&&(b < 10.0)&&(c < 10.0))
+                    a -=360.;
+                if((a > 350.0)&&(b < 10.0)&&(c > 350.0))
+                    b +=360.;
+                if((a <= c)&&(b >= c)){
+                    ifoundit ++;
+                    if(ifoundit==1) {
+                        den = b-a;
+                        if (den!=0.) {
+                            fac1[m] = (b-c)/den;
+                            fac2[m] = (c-a)/den;
+                            ipt1[m] = j+first;
+                            ipt2[m] = r+first;
                         }
-                    }
-                    else {
-                        if((a < 10.0)&&(b > 350.0)&&(c < 10.0))
-                            a-= 360.0;
-                        if((a < 10.0)&&(b > 350.0)&&(c > 350.0))
-                            b+=360.0;
-                        if((a >= c)&&(b <= c)) {
-                            ifoundit++;
-                            if(ifoundit==1) {
-                                den = a-b;
-                                if (den!=0.) {
-                                    fac1[m] = (c-b)/den;
-                                    fac2[m] = (a-c)/den;
-                                    ipt1[m] = j+first;
-                                    ipt2[m] = r+first;
-                                }
-                                else {
-                                    fac1[m]=0.;
-                                    fac2[m]=0.;
-                                }
-                            }
+                        else {
+                            // PH 10/2007. Need for special case. See comment below.
+                            fac1[m]=0.;
+                            fac2[m]=0.;
                         }
+                        // Set up num ref gates
+                        int numGates = radarData->getRay(j+first)->getRef_numgates();
+                        if(radarData->getRay(r+first)->getRef_numgates() < numGates)
+                            numGates = radarData->getRay(r+first)->getRef_numgates();
+                        int firstGate = radarData->getRay(j+first)->getFirst_ref_gate();
+                        if(radarData->getRay(r+first)->getFirst_ref_gate() > firstGate)
+                            firstGate = radarData->getRay(r+first)->getFirst_ref_gate();
+                        radarData->getRay(m+upperFirst)->emptyRefgates(numGates);
+                        radarData->getRay(m+upperFirst)->setFirst_ref_gate(firstGate);
+                        float sp1 = radarData->getRay(j+first)->getRef_gatesp();
+                        float sp2 = radarData->getRay(r+first)->getRef_gatesp();
+                        if(sp1!=sp2)
+                            Message::toScreen("RadarQC: Error interpolating split level data: Cannot resolve reflectivity gate spacing");
+                        radarData->getRay(m+upperFirst)->setRef_gatesp(sp1);
                     }
                 }
             }
-            for(int m = 0; m < upperNumRays; m++) {
-                float *refValues1, *refValues2;
-                refValues1 = radarData->getRay(ipt1[m])->getRefData();
-                refValues2 = radarData->getRay(ipt2[m])->getRefData();
-                Ray *current = radarData->getRay(m+upperFirst);
-                float *newRef = current->getRefData();
-                for(int k=current->getFirst_ref_gate();
-                    k<current->getRef_numgates();k++) {
-                    a = refValues1[k];
-                    b = refValues2[k];
-                    if((a!=velNull)&&(b!=velNull)) {
-                        newRef[k] = a*fac1[m]+b*fac2[m];
-                        // Handles case of sweep first ray and last ray  azimuths differences
-                        // are  greater than 360 degrees(when j=numRay-1 and r=0 in a and b above),
-                        // where fac1 and fac2 are automatically left at their initialized
-                        // values of zero, and case where den is zero - PH 10/2007
-                        if (fac1[m]!=0.&&fac2[m]!=0.) newRef[k] = velNull;
-                    }
-                    if((a==velNull)&&(b!=velNull)){
-                        newRef[k] = b;
-                    }
-                    if((a!=velNull)&&(b==velNull)) {
-                        newRef[k] = a;
-                    }
-                    if((a==velNull)&&(b==velNull)) {
-                        newRef[k] = velNull;
+            else {
+                if((a < 10.0)&&(b > 350.0)&&(c < 10.0))
+                    a-= 360.0;
+                if((a < 10.0)&&(b > 350.0)&&(c > 350.0))
+                    b+=360.0;
+                if((a >= c)&&(b <= c)) {
+                    ifoundit++;
+                    if(ifoundit==1) {
+                        den = a-b;
+                        if (den!=0.) {
+                            fac1[m] = (c-b)/den;
+                            fac2[m] = (a-c)/den;
+                            ipt1[m] = j+first;
+                            ipt2[m] = r+first;
+                        }
+                        else {
+                            fac1[m]=0.;
+                            fac2[m]=0.;
+                        }
                     }
                 }
-                refValues1 = NULL;
-                refValues2 = NULL;
-                //delete refValues1;
-                //delete refValues2;
             }
         }
-
-        // (Paul Harasti 4/2009)
-        // End skip reflectivity interpolation for super resolution case.
     }
-
-    // Get maximum number of velocity gates in each sweep to get
-    // aveVADHeight, which is an average height in each sweep for each gate index
-
-    aveVADHeight = new float*[radarData->getNumSweeps()];
-    for(int n = 0; n < radarData->getNumSweeps(); n++) {
-        int sweepNumVelGates = radarData->getSweep(n)->getVel_numgates();
-        int first = radarData->getSweep(n)->getFirstRay();
-        int last = radarData->getSweep(n)->getLastRay();
-        aveVADHeight[n] = new float[sweepNumVelGates];
-        for(int v = 0; v < sweepNumVelGates; v++) {
-            aveVADHeight[n][v] = 0;
-            int count = 0;
-            for(int r = first; r <= last; r++) {
-                Ray *currentRay = radarData->getRay(r);
-                if(v < currentRay->getVel_numgates()) {
-                    count++;
-                    aveVADHeight[n][v] += findHeight(currentRay,v);
-                }
-                currentRay = NULL;
-                delete currentRay;
+    delete [] candidates;
+    for(int m = 0; m < upperNumRays; m++) {
+        Ray *refRay1 = radarData->getRay(ipt1[m]);
+        Ray *refRay2 = radarData->getRay(ipt2[m]);
+        Ray *current = radarData->getRay(m+upperFirst);
+        // Only the rays rewritten here need their own floats
+        float *newRef = current->writableRefData();
+        for(int k=current->getFirst_ref_gate();
+            k<current->getRef_numgates();k++) {
+            a = refRay1->getRef(k);
+            b = refRay2->getRef(k);
+            if((a!=velNull)&&(b!=velNull)) {
+                newRef[k] = a*fac1[m]+b*fac2[m];
+                // Handles case of sweep first ray and last ray  azimuths differences
+                // are  greater than 360 degrees(when j=numRay-1 and r=0 in a and b above),
+                // where fac1 and fac2 are automatically left at their initialized
+                // values of zero, and case where den is zero - PH 10/2007
+                if (fac1[m]!=0.&&fac2[m]!=0.) newRef[k] = velNull;
+            }
+            if((a==velNull)&&(b!=velNull)){
+                newRef[k] = b;
+            }
+            if((a!=velNull)&&(b==velNull)) {
+                newRef[k] = a;
+            }
+            if((a==velNull)&&(b==velNull)) {
+                newRef[k] = velNull;
             }
-            aveVADHeight[n][v] /= float(count);
         }
+        refRay1 = NULL;
+        refRay2 = NULL;
     }
 }
 
 RadarQC::~RadarQC()
 {
-    for(int i = 0; i < radarData->getNumSweeps(); i++) {
+    for(int i = 0; i < aveVADHeight.size(); i++)
         delete [] aveVADHeight[i];
+    for(int i = 0; i < validBinCount.size(); i++)
         delete [] validBinCount[i];
-    }
-    delete [] aveVADHeight;
-    delete [] validBinCount;
     delete [] envWind;
     delete [] envDir;
 }
@@ -308,6 +381,9 @@ void RadarQC::getConfig(QDomElement qcConfig)
         refMax = qcConfig.firstChildElement("ref_max").text().toFloat();
         specWidthLimit = qcConfig.firstChildElement("sw_threshold").text().toFloat();
         numVGatesAveraged = qcConfig.firstChildElement("bbcount").text().toInt();
+        // The BB window needs at least the gate being unfolded
+        if(numVGatesAveraged < 1)
+            numVGatesAveraged = 1;
         maxFold = qcConfig.firstChildElement("maxfold").text().toInt();
 
         // Get Information on Environmental Wind Finding Methods
@@ -407,6 +483,14 @@ bool RadarQC::dealias()
     // reflectivity which could cause a large enough terminal velocity correction
     // to push clutter velocity beyond the assume +-1.5 m/s clutter threshold.
 
+    // Each stage below runs one sweep per thread, the stages themselves
+    // run in order since each needs the velocities left by the last.
+    // Sweeps QC'd by qcSweeps while the volume arrived have had the
+    // stages that need only the sweep itself.
+    wholeVolume = true;
+    prepareSweeps(radarData->getNumSweeps());
+    buildSweepTasks(sweepsDone, radarData->getNumSweeps());
+
     thresholdData();
     emit log(Message(QString(),1,this->objectName()));
 
@@ -419,7 +503,10 @@ bool RadarQC::dealias()
     }
 
     emit log(Message(QString(),1,this->objectName()));
-	
+
+    // The wind from VAD is new, every sweep is dealiased against it
+    if(!useUserWinds && (sweepsDone > 0))
+        buildSweepTasks(0, radarData->getNumSweeps());
 
     if(!BB()) {
         Message::toScreen("Failed in Bargen-Brown dealising");
@@ -437,6 +524,82 @@ bool RadarQC::dealias()
 
 
 
+void RadarQC::qcSweeps(int count)
+{
+    // The last sweep read may still be filling, and a whole volume is
+    // left to dealias
+    int numSweeps = radarData->getNumSweeps();
+    if (count > numSweeps - 1)
+        count = numSweeps - 1;
+    if (count <= sweepsDone)
+        return;
+
+    prepareSweeps(count);
+    buildSweepTasks(sweepsDone, count);
+
+    // The stages are run directly, their progress belongs to dealias.
+    // With the environmental wind from the configuration BB needs nothing
+    // from the other sweeps, so those sweeps are dealiased here too.
+    QtConcurrent::blockingMap(sweepTasks, &RadarQC::runThresholdTask);
+    QtConcurrent::blockingMap(sweepTasks, &RadarQC::runTerminalVelocityTask);
+    if (useUserWinds) {
+        QtConcurrent::blockingMap(sweepTasks, &RadarQC::runBBTask);
+        QtConcurrent::blockingMap(sweepTasks, &RadarQC::runDerivativeTask);
+    }
+    sweepsDone = count;
+}
+
+void RadarQC::buildSweepTasks(int begin, int end)
+{
+    // Group the rays of sweeps begin to end-1 by the sweep they belong to.
+    // A sweep QC'd before the volume was complete only had the rays of its
+    // own range, so for the whole volume the rays of earlier sweeps outside
+    // their range, and rays with no usable sweep index, go in a last task
+    // of their own.
+    int numSweeps = radarData->getNumSweeps();
+    bool complete = (end >= numSweeps);
+    if (complete)
+        end = numSweeps;
+    sweepTasks.clear();
+    for (int n = begin; n < end; n++) {
+        SweepTask task;
+        task.qc = this;
+        task.sweepIndex = n;
+        sweepTasks.append(task);
+    }
+
+    if (!complete) {
+        for (int n = begin; n < end; n++) {
+            Sweep *sweep = radarData->getSweep(n);
+            for (int i = sweep->getFirstRay(); i <= sweep->getLastRay(); i++) {
+                if (radarData->getRay(i)->getSweepIndex() == n)
+                    sweepTasks[n - begin].rays.append(i);
+            }
+        }
+        return;
+    }
+
+    SweepTask rest;
+    rest.qc = this;
+    rest.sweepIndex = -1;
+    sweepTasks.append(rest);
+    int restIndex = sweepTasks.size() - 1;
+
+    int numRays = radarData->getNumRays();
+    for (int i = 0; i < numRays; i++) {
+        int sweepIndex = radarData->getRay(i)->getSweepIndex();
+        if ((sweepIndex >= begin) && (sweepIndex < numSweeps)) {
+            sweepTasks[sweepIndex - begin].rays.append(i);
+        } else if ((sweepIndex >= 0) && (sweepIndex < begin)) {
+            Sweep *sweep = radarData->getSweep(sweepIndex);
+            if ((i < sweep->getFirstRay()) || (i > sweep->getLastRay()))
+                sweepTasks[restIndex].rays.append(i);
+        } else {
+            sweepTasks[restIndex].rays.append(i);
+        }
+    }
+}
+
 void RadarQC::thresholdData()
 {
     /*
@@ -448,22 +611,30 @@ void RadarQC::thresholdData()
    *  in the VAD and GVAD methods.
    */
 
-    int numSweeps = radarData->getNumSweeps();
-    for (int i = 0; i < numSweeps; i++) {
-        Sweep *currentSweep = radarData->getSweep(i);
+    QtConcurrent::blockingMap(sweepTasks, &RadarQC::runThresholdTask);
+    emit log(Message(QString(),1,this->objectName()));
+}
+
+void RadarQC::runThresholdTask(SweepTask& task)
+{
+    task.qc->thresholdSweep(task);
+}
+
+void RadarQC::thresholdSweep(SweepTask& task)
+{
+    if (task.sweepIndex >= 0) {
+        Sweep *currentSweep = radarData->getSweep(task.sweepIndex);
         int numBins = currentSweep->getVel_numgates();
         for (int j=0; j < numBins; j++)
-            validBinCount[i][j]=0.;
+            validBinCount[task.sweepIndex][j]=0.;
     }
 
-    int numRays = radarData->getNumRays();
     Ray* currentRay;
     int numVGates = 0;
 
-    for(int i = 0; i < numRays; i++)
+    for(int r = 0; r < task.rays.size(); r++)
     {
-        if(i == (int) numRays/2.0)
-            emit log(Message(QString(),1,this->objectName()));
+        int i = task.rays.at(r);
         currentRay = radarData->getRay(i);
 	if (currentRay == NULL) {
 	  std::cout << "No ray at index " << i << std::endl;
@@ -487,9 +658,8 @@ void RadarQC::thresholdData()
         //      float velGateSp = currentRay->getVel_gatesp();
         //      float refGateSp = currentRay->getRef_gatesp();
         float *vGates = currentRay->getVelData();
-        float *swGates = currentRay->getSwData();
 	// float *refGates = currentRay->getRefData();
-        if (swGates != NULL) {
+        if (currentRay->hasSwData()) {
             for (int j = 0; j < numVGates; j++)
             {
                 //         if(j<20) {
@@ -498,7 +668,7 @@ void RadarQC::thresholdData()
                 //	  int jref = int((float)j * velGateSp / refGateSp);
                 //	  if(jref >= currentRay->getRef_numgates())
                 //	    jref = int(velNull);
-                if((swGates[j] > specWidthLimit)||
+                if((currentRay->getSw(j) > specWidthLimit)||
                    (fabs(vGates[j]) < velMin) ||
                    (fabs(vGates[j]) > velMax))
                     //||(jref==velNull)||(refGates[jref] < refMin)
@@ -524,7 +694,6 @@ void RadarQC::thresholdData()
             }
         }
         vGates = NULL;
-        swGates = NULL;
         // refGates = NULL;
     }
     currentRay = NULL;
@@ -540,13 +709,34 @@ bool RadarQC::terminalVelocity()
    *  from each valid doppler velocity reading in the radar volume.
    */
 
-    float ae = 6371.*4./3.; // Adjustment factor for 4/3 Earth Radius (in km)
-    int numRays = radarData->getNumRays();
+    QtConcurrent::blockingMap(sweepTasks, &RadarQC::runTerminalVelocityTask);
+    return true;
+}
+
+void RadarQC::runTerminalVelocityTask(SweepTask& task)
+{
+    task.qc->terminalVelocitySweep(task);
+}
+
+void RadarQC::terminalVelocitySweep(SweepTask& task)
+{
+    // The height and beam angle terms of the fall speed only change with
+    // the gate and the ray elevation, so they are tabulated once for each
+    // elevation found in the sweep. Rays whose gate geometry differs from
+    // the first ray of the sweep work out each gate directly.
     int numVGates;
     Ray* currentRay;
-
-    for(int i = 0; i < numRays; i++)
+    int tableGates = 0;
+    int tableFirstGate = 0;
+    float tableGateSp = 0;
+    bool haveTableGeometry = false;
+    if (task.sweepIndex >= 0)
+        tableGates = radarData->getSweep(task.sweepIndex)->getVel_numgates();
+    QHash<quint32, QVector<FallGeometry> > geometryTables;
+
+    for(int r = 0; r < task.rays.size(); r++)
     {
+        int i = task.rays.at(r);
         currentRay = radarData->getRay(i);
 	
 	if (currentRay->getSweepIndex() == -999)
@@ -555,7 +745,6 @@ bool RadarQC::terminalVelocity()
 	
         numVGates = currentRay->getVel_numgates();
         float *vGates = currentRay->getVelData();
-        float *rGates = currentRay->getRefData();
 
 	// Some rays might not have VEL data
 	if ( vGates == NULL )
@@ -563,6 +752,35 @@ bool RadarQC::terminalVelocity()
 
         if((currentRay->getRef_gatesp()!=0)&&(currentRay->getVel_gatesp()!=0)&&(currentRay->getRef_numgates()!=0))
         {
+            int sweepIndex = currentRay->getSweepIndex();
+            if (sweepIndex < 0)
+                continue;
+
+            float elevAngle = currentRay->getElevation();
+            if (!haveTableGeometry) {
+                tableFirstGate = currentRay->getFirst_vel_gate();
+                tableGateSp = currentRay->getVel_gatesp();
+                haveTableGeometry = true;
+            }
+            const FallGeometry* geometry = NULL;
+            int numTabled = 0;
+            if ((currentRay->getFirst_vel_gate() == tableFirstGate)
+                && (currentRay->getVel_gatesp() == tableGateSp)) {
+                quint32 elevKey;
+                memcpy(&elevKey, &elevAngle, sizeof(elevKey));
+                QVector<FallGeometry>& table = geometryTables[elevKey];
+                if (table.isEmpty() && (tableGates > 0)) {
+                    table.resize(tableGates);
+                    for (int j = 0; j < tableGates; j++) {
+                        float range = float(currentRay->getFirst_vel_gate()+(j*currentRay->getVel_gatesp()))/1000.;
+                        if (range<0.) range=0.;
+                        fallGeometry(range, elevAngle, aveVADHeight[sweepIndex][j], table[j]);
+                    }
+                }
+                geometry = table.constData();
+                numTabled = table.size();
+            }
+
             for(int j = 0; j < numVGates; j++)
             {
                 if(vGates[j]!=velNull)
@@ -573,17 +791,15 @@ bool RadarQC::terminalVelocity()
                     //		  float range = j*currentRay->getVel_gatesp()/1000.0;
                     float range = float(currentRay->getFirst_vel_gate()+(j*currentRay->getVel_gatesp()))/1000.;
                     if (range<0.) range=0.;
-                    float elevAngle = currentRay->getElevation();
 
-		    int sweepIndex = currentRay->getSweepIndex();
-		    if (sweepIndex < 0)
-		      continue;
-
-                    float height = aveVADHeight[sweepIndex][j];
-                    // height is in km from sea level here
+                    FallGeometry gateGeometry;
+                    if (j < numTabled) {
+                        gateGeometry = geometry[j];
+                    } else {
+                        float height = aveVADHeight[sweepIndex][j];
+                        fallGeometry(range, elevAngle, height, gateGeometry);
+                    }
 
-                    float rho = 1.1904*exp(-1*height/9.58);
-                    float theta = elevAngle*deg2rad+asin(range*cos(deg2rad*elevAngle)/(ae+height-radarHeight));
                     int zgate = 0;
                     /* I think this next step makes assumptions about
            * the reflectivity of the gate spacing
@@ -617,43 +833,10 @@ bool RadarQC::terminalVelocity()
                     if(zgate >= currentRay->getRef_numgates())
                         zgate = currentRay->getRef_numgates()-1;
 					if (zgate < 1) zgate = 1;
-                    float zData = rGates[zgate];
-                    //                  int zwhere=currentRay->getSweepIndex();
-                    //                  if ((zwhere < 22)&&(zData > 0.)&&(zData < 100.))
-                    //  Message::toScreen("SweepNo = "+QString().setNum(zwhere));
-                    float terminalV = 0;
-                    zData = pow(10.0,(zData/10.0));
-                    // New logic from Marks and Houze (1987)
-                    if(height  < 5.1){
-                        terminalV = -2.6*sin(theta)*(pow(zData,0.107))*(pow((1.1904/rho),0.45));
-                    }
-                    else {
-                        if(height > 7.5) {
-                            terminalV = (-0.817*sin(theta)*pow(zData,0.063)*pow((1.1904/rho),0.45));
-                        }
-                        else {
-                            float a,b,c,den, v1, v2;
-                            c = height;
-                            den = 7.5-5.1;
-                            a = (7.5-c)/den;
-                            b = (c - 5.1)/den;
-                            rho = 1.1904*exp(-1*5.1/9.58);
-                            theta = deg2rad*elevAngle+asin(range*cos(deg2rad*elevAngle)/(ae+5.1-radarHeight));
-                            v1 = (-2.6*sin(theta)*pow(zData, 0.107)*pow((1.1904/rho),0.45));
-                            rho = 1.1904*exp(-1*7.5/9.58);
-                            theta = deg2rad*elevAngle+asin(range*cos(deg2rad*elevAngle)/(ae+7.5-radarHeight));
-                            v2 = (-0.817*sin(theta)*pow(zData, 0.063)*pow((1.1904/rho),0.45));
-                            terminalV = a*v1+b*v2;
-                        }
-                    }
+                    float terminalV = fallSpeed(gateGeometry, currentRay->getRef(zgate));
                     if(!isnan(terminalV)) {
                         vGates[j] -= terminalV;
                     }
-                    else {
-                        QString trap = "Ray = "+QString().setNum(i)+" j = "+QString().setNum(j)+" terminal vel "+QString().setNum(terminalV)+" ISNAN";
-                        //Message::toScreen(trap);
-                        //emit log(Message(trap));
-                    }
                 }
             }
         }
@@ -663,20 +846,89 @@ bool RadarQC::terminalVelocity()
             }
         }
         vGates = NULL;
-        rGates = NULL;
     }
     currentRay = NULL;
-    return true;
 }
 
+void RadarQC::fallGeometry(float range, float elevAngle, float height, FallGeometry& geometry)
+{
+    // height is in km from sea level here
+    float ae = 6371.*4./3.; // Adjustment factor for 4/3 Earth Radius (in km)
+    float rho = 1.1904*exp(-1*height/9.58);
+    float theta = elevAngle*deg2rad+asin(range*cos(deg2rad*elevAngle)/(ae+height-radarHeight));
+    geometry.lowWeight = geometry.highWeight = 0;
+    geometry.lowCoeff = geometry.highCoeff = 0;
+    geometry.lowDensity = geometry.highDensity = 0;
+
+    // New logic from Marks and Houze (1987)
+    if(height  < 5.1){
+        geometry.zone = FallGeometry::Rain;
+        geometry.lowCoeff = -2.6*sin(theta);
+        geometry.lowDensity = pow((1.1904/rho),0.45);
+    }
+    else {
+        if(height > 7.5) {
+            geometry.zone = FallGeometry::Ice;
+            geometry.highCoeff = -0.817*sin(theta);
+            geometry.highDensity = pow((1.1904/rho),0.45);
+        }
+        else {
+            float c,den;
+            c = height;
+            den = 7.5-5.1;
+            geometry.zone = FallGeometry::Blend;
+            geometry.lowWeight = (7.5-c)/den;
+            geometry.highWeight = (c - 5.1)/den;
+            rho = 1.1904*exp(-1*5.1/9.58);
+            theta = deg2rad*elevAngle+asin(range*cos(deg2rad*elevAngle)/(ae+5.1-radarHeight));
+            geometry.lowCoeff = -2.6*sin(theta);
+            geometry.lowDensity = pow((1.1904/rho),0.45);
+            rho = 1.1904*exp(-1*7.5/9.58);
+            theta = deg2rad*elevAngle+asin(range*cos(deg2rad*elevAngle)/(ae+7.5-radarHeight));
+            geometry.highCoeff = -0.817*sin(theta);
+            geometry.highDensity = pow((1.1904/rho),0.45);
+        }
+    }
+}
+
+float RadarQC::fallSpeed(const FallGeometry& geometry, float dBZ)
+{
+    // The reflectivity powers come from the table when dBZ is one of the
+    // Level II reflectivity codes, otherwise they are worked out here
+    int code = -1;
+    if ((dBZ >= fallDBZ[2]) && (dBZ <= fallDBZ[255])) {
+        code = (int)floor(2.0*dBZ + 66.5);
+        if (fallDBZ[code] != dBZ)
+            code = -1;
+    }
+    float zData = 0;
+    if (code < 0)
+        zData = pow(10.0,(dBZ/10.0));
 
-float RadarQC::findHeight(Ray *currentRay, int gateIndex)
+    if (geometry.zone == FallGeometry::Rain) {
+        double zFactor = (code < 0) ? pow(zData,0.107) : fallRainFactor[code];
+        return geometry.lowCoeff*zFactor*geometry.lowDensity;
+    }
+    if (geometry.zone == FallGeometry::Ice) {
+        double zFactor = (code < 0) ? pow(zData,0.063) : fallIceFactor[code];
+        return geometry.highCoeff*zFactor*geometry.highDensity;
+    }
+    double rainFactor = (code < 0) ? pow(zData,0.107) : fallRainFactor[code];
+    double iceFactor = (code < 0) ? pow(zData,0.063) : fallIceFactor[code];
+    float v1 = geometry.lowCoeff*rainFactor*geometry.lowDensity;
+    float v2 = geometry.highCoeff*iceFactor*geometry.highDensity;
+    return geometry.lowWeight*v1+geometry.highWeight*v2;
+}
+
+
+float RadarQC::findHeight(int rayIndex, int gateIndex)
 {
 
     /*
    *  The method calculates the height of gate in a ray,
    *  relative to the absolute height of the radar in km.
    */
+    Ray *currentRay = radarData->getRay(rayIndex);
     if(currentRay->getVel_gatesp()==0){
         Message::toScreen("Find height of ray w/o gate data");
         return -999;
@@ -687,11 +939,21 @@ float RadarQC::findHeight(Ray *currentRay, int gateIndex)
     // 0.125 m for VCP 211.
 
     float range = float(currentRay->getFirst_vel_gate()+(gateIndex*currentRay->getVel_gatesp()))/1000.;
-    if (range<0.) range=0.;
     //  float range = gateIndex*currentRay->getVel_gatesp()/1000.0;
     float elevAngle = currentRay->getElevation();
-    // This height is in km from sea level
-    float height = radarData->absoluteRadarBeamHeight(range, elevAngle);
+    if (range<0.) {
+        range=0.;
+        // This height is in km from sea level
+        return radarData->absoluteRadarBeamHeight(range, elevAngle);
+    }
+    // The gate geometry is built for a whole volume, a sweep QC'd while
+    // the volume arrives works the height out directly
+    if (!wholeVolume)
+        return radarData->absoluteRadarBeamHeight(range, elevAngle);
+
+    // Same height from the volume gate geometry, in km from sea level
+    float height = radarData->getGateGeometry()->getVelHeight(rayIndex)[gateIndex]
+                   + radarData->getAltitude();
     return height;
 
 }
@@ -1623,11 +1885,30 @@ float RadarQC::getStart(Ray *currentRay)
 bool RadarQC::BB()
 {
     //emit log(Message("In BB"));
+    QtConcurrent::blockingMap(sweepTasks, &RadarQC::runBBTask);
+    return true;
+}
+
+void RadarQC::runBBTask(SweepTask& task)
+{
+    task.qc->BBSweep(task);
+}
+
+void RadarQC::BBSweep(SweepTask& task)
+{
     Ray* currentRay = NULL;
-    float numRays = radarData->getNumRays();
-    for(int i = 0; i < numRays; i++)
+
+    // The reference velocity is the median of the previous
+    // numVGatesAveraged unfolded gates with the newest of them replaced by
+    // the gate just unfolded. The older gates are kept in a running median
+    // and windowIds holds their handles, oldest first from windowStart.
+    int numHeld = numVGatesAveraged - 1;
+    RunningMedian window(numVGatesAveraged, numVGatesAveraged / 2);
+    int* windowIds = new int[numVGatesAveraged];
+
+    for(int r = 0; r < task.rays.size(); r++)
     {
-        currentRay = radarData->getRay(i);
+        currentRay = radarData->getRay(task.rays.at(r));
 	if (currentRay->getSweepIndex() == -999)
 	  continue;
 	
@@ -1643,18 +1924,17 @@ bool RadarQC::BB()
         int numVelocityGates = currentRay->getVel_numgates();
         if((numVelocityGates!=0)&&(startVelocity!=velNull))
         {
-            float sum = float(numVGatesAveraged)*startVelocity;
-	    float median, mean;
-	    mean = median = startVelocity;
-	    // float nyquistSum = float(numVGatesAveraged)*nyquistVelocity;
+	    float median = startVelocity;
             int n = 0;
             int overMaxFold = 0;
             bool dealiased;
-            float segVelocity[numVGatesAveraged];
-            for(int k = 0; k < numVGatesAveraged; k++)
+            window.clear();
+            for(int k = 0; k < numHeld; k++)
             {
-                segVelocity[k] = startVelocity;
+                windowIds[k] = window.insert(startVelocity);
             }
+            int windowStart = 0;
+            float newestVelocity = startVelocity;
             for(int j = 0; j < numVelocityGates; j++)
             {
                 //Message::toScreen("Gate "+QString().setNum(j));
@@ -1693,30 +1973,17 @@ bool RadarQC::BB()
                     if(vGates[j]!=velNull)
                     {
                         vGates[j]+= 2.0*n*(nyquistVelocity);
-                        sum -= segVelocity[0];
-                        sum += vGates[j];
-						mean = sum / numVGatesAveraged;
-						float threshold_mean = 0.0;
-						int meancount = 0;
-						QList<float> sortVelocity;
-                        for(int m = 0; m < numVGatesAveraged-1; m++)
+                        int gateId = window.insert(vGates[j]);
+                        median = window.value();
+                        window.remove(gateId);
+                        // Slide the window along by one gate
+                        if(numHeld > 0)
                         {
-							sortVelocity << segVelocity[m];
-                            segVelocity[m] = segVelocity[m+1];
-							if (fabs(segVelocity[m] - mean) < nyquistVelocity)
-							{
-								threshold_mean += segVelocity[m];
-								meancount++;
-							}							
+                            window.remove(windowIds[windowStart]);
+                            windowIds[windowStart] = window.insert(newestVelocity);
+                            windowStart = (windowStart + 1) % numHeld;
                         }
-						sortVelocity << vGates[j];
-						segVelocity[numVGatesAveraged-1] = vGates[j];
-						threshold_mean += vGates[j];
-						meancount++;
-						//if (meancount < numVGatesAveraged) Message::toScreen(QString("Threshold reduced to ") + QString().setNum(meancount));
-						qSort(sortVelocity);
-						int mIndex = float(numVGatesAveraged)/2;
-						median = (sortVelocity.at(mIndex));// + (threshold_mean / (float)meancount)) / 2;
+                        newestVelocity = vGates[j];
                     }
                 }
             }
@@ -1724,20 +1991,33 @@ bool RadarQC::BB()
         vGates = NULL;
         currentRay = NULL;
     }
-	
-    //Message::toScreen("Getting out of dealias");
-    return true;
+    delete[] windowIds;
 }
 
 bool RadarQC::derivativeDealias()
 {
 	
 	// Minimize 2nd derivative in azimuth after BB routine
-	for (int n = 0; n < radarData->getNumSweeps(); n++) {
+	QtConcurrent::blockingMap(sweepTasks, &RadarQC::runDerivativeTask);
+    //Message::toScreen("Getting out of dealias");
+    return true;
+}
+
+void RadarQC::runDerivativeTask(SweepTask& task)
+{
+    task.qc->derivativeDealiasSweep(task);
+}
+
+void RadarQC::derivativeDealiasSweep(SweepTask& task)
+{
+	// Works from the sweep's own ray range, so the rays that are not in
+	// any sweep have nothing to do here
+	int n = task.sweepIndex;
+	if (n >= 0) {
         Sweep* currentSweep = radarData->getSweep(n);
 		int rays = currentSweep->getNumRays();
 		int gates = currentSweep->getVel_numgates();
-        if (gates == 0) continue;
+        if (gates == 0) return;
 
 		float nyquistVelocity = currentSweep->getNyquist_vel();
 		// Allocate memory for the gradient fields
@@ -1862,8 +2142,6 @@ bool RadarQC::derivativeDealias()
 		delete[] a1;
 		
 	}
-    //Message::toScreen("Getting out of dealias");
-    return true;
 }	
 
 bool RadarQC::multiprfDealias()
@@ -16,6 +16,9 @@
 #include <QWidget>
 #include <QDomElement>
 #include <QObject>
+#include <QList>
+#include <QHash>
+#include <QVector>
 #include "Math/Matrix.h"
 
 class RadarQC : public QObject
@@ -37,6 +40,13 @@ public:
    * on a single radar volume. This includes: removal of the terminal
    * velocity component, basics thresholding with user adjusted parameters,
    * various methods to find environmental wind, and BB dealiasing
+   */
+
+    void qcSweeps(int count);
+    /* Runs the stages that only need the sweep itself on the first count
+   * sweeps, for a volume that is still arriving. Those sweeps must be
+   * complete. dealias then skips them for those stages. With the
+   * environmental wind from the configuration they are fully dealiased.
    */
 
     void debugDump(RadarData *radarPtr, int sweepNum);
@@ -47,6 +57,50 @@ private:
     RadarData *radarData;
     // Volume of Radar Data to be dealiased
 
+    // The rays of one sweep. The QC stages run one sweep per thread, each
+    // sweep task only writes its own rays and its own validBinCount row.
+    class SweepTask {
+    public:
+        RadarQC* qc;
+        int sweepIndex;
+        QVector<int> rays;
+    };
+    QList<SweepTask> sweepTasks;
+    void buildSweepTasks(int begin, int end);
+    /*
+   * Groups the rays of sweeps begin to end-1 by sweep. For the whole
+   *   volume, rays without a valid sweep index go in a last task with
+   *   sweepIndex -1.
+   *
+   */
+
+    int sweepsDone;
+    bool wholeVolume;
+    /*
+   * sweepsDone: the sweeps qcSweeps has QC'd
+   *
+   * wholeVolume: set once dealias starts, the volume is complete
+   *
+   */
+
+    void prepareSweeps(int count);
+    void prepareSweep(int n);
+    /*
+   * Sets up the bin counts and VAD heights of each sweep up to count that
+   *   is not yet set up, and fills split cut reflectivity.
+   *
+   */
+
+    bool splitCut, clockwise;
+    void findSplitCuts();
+    void fillSplitCut(int i);
+    /*
+   * Super resolution volumes recombined to legacy have the low sweeps as
+   *   split cuts. The reflectivity of surveillance sweep i is interpolated
+   *   onto the Doppler sweep i+1, which has none.
+   *
+   */
+
     float specWidthLimit, velMin, velMax, refMin, refMax;
     /*
    * All these parameters are user adjustable for thresholding the
@@ -136,6 +190,8 @@ private:
 
 
     void thresholdData();
+    static void runThresholdTask(SweepTask& task);
+    void thresholdSweep(SweepTask& task);
     /*
    * Primary Quality Control Method
    *   Eliminates velocity value within the data that do not meet the user
@@ -144,11 +200,37 @@ private:
    */
 
     bool terminalVelocity();
+    static void runTerminalVelocityTask(SweepTask& task);
+    void terminalVelocitySweep(SweepTask& task);
     /*
    * Uses reflectivity data to approximate the terminal velocity component
    *   for each gate, these values are subtracted from the doppler velocity
    *   readings in the radar volume.
    *
+   */
+
+    // The parts of the terminal fall speed at one gate that do not depend
+    // on reflectivity. Rain uses the low terms, ice the high terms and the
+    // 5.1-7.5 km blend weights both.
+    class FallGeometry {
+    public:
+        enum Zone { Rain, Ice, Blend };
+        Zone zone;
+        double lowCoeff, highCoeff;
+        double lowDensity, highDensity;
+        float lowWeight, highWeight;
+    };
+    void fallGeometry(float range, float elevAngle, float height,
+                      FallGeometry& geometry);
+    float fallSpeed(const FallGeometry& geometry, float dBZ);
+
+    float fallDBZ[256];
+    double fallRainFactor[256];
+    double fallIceFactor[256];
+    /*
+   * Reflectivity (dBZ) of each Level II reflectivity code and the powers
+   *   of linear reflectivity used for rain and ice fall speeds.
+   *
    */
 
     bool findEnvironmentalWind();
@@ -188,6 +270,8 @@ private:
    */
 
     bool BB();
+    static void runBBTask(SweepTask& task);
+    void BBSweep(SweepTask& task);
     /*
    * This method is modeled after velocity dealiasing algorithm B,
    *   published by Bargain and Brown (1980).
@@ -195,20 +279,22 @@ private:
    */
 
 	bool derivativeDealias();
+	static void runDerivativeTask(SweepTask& task);
+	void derivativeDealiasSweep(SweepTask& task);
 	/* This method tries to minimize 2nd derivatives in the radial velocity
 	 by through velocity unfolding */
 	
 	bool multiprfDealias();
 	/* This method compares rays at different Nyquist velocities for dealiasing */
 	
-    float findHeight(Ray* currentRay, int gateIndex);
+    float findHeight(int rayIndex, int gateIndex);
     /*
    * Uses the 4/3 earth radius model to return the height of a specific gate
    *   in km, relative to sea level.
    *
    */
 
-    float **aveVADHeight;
+    QVector<float*> aveVADHeight;
     // aveVADHeight[n][v] : The average height (km from sea level) of the vad
     // ring in sweep n, velocity gate index v.
 
@@ -229,7 +315,8 @@ private:
 
     //-------------------------------------------------------------------------
 
-    float **validBinCount, **last_count_up, **last_count_low;
+    QVector<float*> validBinCount;
+    float **last_count_up, **last_count_low;
     bool *vadFound, **hasVelData;
     float *sumwt, *vadRMS;
     int **highVelGate, **lowVelGate;
@@ -38,6 +38,8 @@ PressureFactory::PressureFactory(Configuration *mainCfg, QObject *parent) : QObj
     startDateTime = startDateTime.addSecs(-3600);
 
     dataPath = QDir(mainCfg->getParam(pressureConfig,QString("dir")));
+    dataWatcher = new DirectoryWatcher(dataPath.absolutePath());
+    dataScanned = false;
     radarlat = mainCfg->getParam(radarConfig,"lat").toFloat();
     radarlon = mainCfg->getParam(radarConfig,"lon").toFloat();
 
@@ -56,6 +58,7 @@ PressureFactory::PressureFactory(Configuration *mainCfg, QObject *parent) : QObj
 PressureFactory::~PressureFactory()
 {
     delete pressureQueue;
+    delete dataWatcher;
 }
 
 QList<PressureData>* PressureFactory::getUnprocessedData()
@@ -69,19 +72,16 @@ QList<PressureData>* PressureFactory::getUnprocessedData()
     }
 
     // Get the files off the queue
-    QString fileName = dataPath.filePath(pressureQueue->dequeue());
-
-    // Test file to make sure it is not growing
-    QFile pressureFile(fileName);
-    qint64 newFilesize = pressureFile.size();
-    qint64 prevFilesize = 0;
-    while (prevFilesize != newFilesize) {
-        prevFilesize = newFilesize;
-        sleep(1);
-        newFilesize = pressureFile.size();
+    QString file = pressureQueue->dequeue();
+    QString fileName = dataPath.filePath(file);
+
+    // The watcher saw the file closed or moved in, so it is complete. One
+    // found by listing the directory may still be written, leave it for
+    // the next volume unless it has been left alone for a moment.
+    if (!fileFinished.value(fileName) && !DirectoryWatcher::isQuiet(fileName)) {
+        pressureQueue->enqueue(file);
+        return new QList<PressureData>;
     }
-    sleep(1);
-
 
     // Mark it as processed
     fileParsed[fileName] = true;
@@ -251,11 +251,7 @@ bool PressureFactory::hasUnprocessedData()
     case hwind:
     {
         // Assuming that the filename structure is a timestamp
-        //dataPath.setNameFilters(QStringList("*"));
-        dataPath.setFilter(QDir::Files);
-        //dataPath.setSorting(QDir::Time | QDir::Reversed);
-        dataPath.setSorting(QDir::Name);
-        QStringList filenames = dataPath.entryList();
+        QStringList filenames = candidateFiles();
 
         // Check to see which are in the time limits
         for (int i = 0; i < filenames.size(); ++i) {
@@ -284,11 +280,7 @@ bool PressureFactory::hasUnprocessedData()
     case awips:
     {
         // Assuming that the filename structure has a trailing timestamp
-        //dataPath.setNameFilters(QStringList("*"));
-        dataPath.setFilter(QDir::Files);
-        //dataPath.setSorting(QDir::Time | QDir::Reversed);
-        dataPath.setSorting(QDir::Name);
-        QStringList filenames = dataPath.entryList();
+        QStringList filenames = candidateFiles();
 
         // Check to see which are in the time limits
         for (int i = 0; i < filenames.size(); ++i) {
@@ -316,11 +308,7 @@ bool PressureFactory::hasUnprocessedData()
         case madis:
         {
             // Assuming that the filename structure has a trailing timestamp
-            //dataPath.setNameFilters(QStringList("*"));
-            dataPath.setFilter(QDir::Files);
-            //dataPath.setSorting(QDir::Time | QDir::Reversed);
-            dataPath.setSorting(QDir::Name);
-            QStringList filenames = dataPath.entryList();
+            QStringList filenames = candidateFiles();
             
             // Check to see which are in the time limits
             for (int i = 0; i < filenames.size(); ++i) {
@@ -363,6 +351,40 @@ bool PressureFactory::hasUnprocessedData()
 
 }
 
+QStringList PressureFactory::candidateFiles()
+{
+    // The first time through, or if the watcher lost track, list the whole
+    // directory. After that only the files the watcher saw finished.
+
+    if (dataWatcher->isValid() && dataScanned && !dataWatcher->needsRescan()) {
+        QStringList filenames = dataWatcher->finishedFiles();
+        filenames.removeDuplicates();
+        for (int i = 0; i < filenames.size(); i++)
+            markFinished(filenames.at(i));
+        filenames.sort();
+        return filenames;
+    }
+
+    // Files finished before the listing are in it. Take those events now
+    // so later ones are not lost.
+    QStringList finished = dataWatcher->finishedFiles();
+    finished.removeDuplicates();
+    for (int i = 0; i < finished.size(); i++)
+        markFinished(finished.at(i));
+
+    dataPath.setFilter(QDir::Files);
+    dataPath.setSorting(QDir::Name);
+    dataScanned = true;
+    return dataPath.entryList();
+}
+
+void PressureFactory::markFinished(const QString& file)
+{
+    // A close or a move, either way the file is complete
+    fileFinished[dataPath.filePath(file)] = true;
+    dataWatcher->takeMovedIn(file);
+}
+
 void PressureFactory::catchLog(const Message& message)
 {
     emit log (message);
@@ -23,6 +23,7 @@
 #include "Pressure/AWIPS.h"
 #include "Pressure/MADIS.h"
 #include "IO/Message.h"
+#include "IO/DirectoryWatcher.h"
 #include "GUI/ConfigTree.h"
 
 class PressureFactory : public QObject
@@ -50,7 +51,13 @@ private:
         netcdf
     };
 
+    QStringList candidateFiles();
+    void markFinished(const QString& file);
+
     QDir dataPath;
+    DirectoryWatcher *dataWatcher;
+    bool dataScanned;
+    QHash<QString, bool> fileFinished;
     dataFormat pressureFormat;
     QQueue<QString> *pressureQueue;
     QDateTime startDateTime;
@@ -0,0 +1,69 @@
+/*
+ *  GateGeometry.cpp
+ *  VORTRAC
+ *
+ *  Per-volume gate positions shared by gridding, QC and HVVP
+ *
+ */
+
+#include "GateGeometry.h"
+#include "RadarData.h"
+#include <math.h>
+
+GateGeometry::GateGeometry(RadarData *radarData)
+{
+  float Pi = 3.141592653589793238462643;
+  float deg2rad = Pi/180.;
+
+  numRays = radarData->getNumRays();
+  sinPhi = new float[numRays];
+  cosTheta = new float[numRays];
+  sinTheta = new float[numRays];
+  refOffset = new long[numRays];
+  velOffset = new long[numRays];
+
+  long numRefGates = 0;
+  long numVelGates = 0;
+  for (int n = 0; n < numRays; n++) {
+    Ray* currentRay = radarData->getRay(n);
+    float theta = deg2rad * fmodf((450. - currentRay->getAzimuth()),360.);
+    float phi = deg2rad * (90. - (currentRay->getElevation()));
+    sinPhi[n] = sin(phi);
+    cosTheta[n] = cos(theta);
+    sinTheta[n] = sin(theta);
+    refOffset[n] = numRefGates;
+    velOffset[n] = numVelGates;
+    if (currentRay->getRef_numgates() > 0)
+      numRefGates += currentRay->getRef_numgates();
+    if (currentRay->getVel_numgates() > 0)
+      numVelGates += currentRay->getVel_numgates();
+  }
+
+  refHeight = new float[numRefGates];
+  velHeight = new float[numVelGates];
+  for (int n = 0; n < numRays; n++) {
+    Ray* currentRay = radarData->getRay(n);
+    float elevation = currentRay->getElevation();
+    for (int g = 0; g < currentRay->getRef_numgates(); g++) {
+      float range = float(currentRay->getFirst_ref_gate() +
+                          (g * currentRay->getRef_gatesp()))/1000.;
+      refHeight[refOffset[n] + g] = radarData->radarBeamHeight(range, elevation);
+    }
+    for (int g = 0; g < currentRay->getVel_numgates(); g++) {
+      float range = float(currentRay->getFirst_vel_gate() +
+                          (g * currentRay->getVel_gatesp()))/1000.;
+      velHeight[velOffset[n] + g] = radarData->radarBeamHeight(range, elevation);
+    }
+  }
+}
+
+GateGeometry::~GateGeometry()
+{
+  delete[] sinPhi;
+  delete[] cosTheta;
+  delete[] sinTheta;
+  delete[] refOffset;
+  delete[] velOffset;
+  delete[] refHeight;
+  delete[] velHeight;
+}
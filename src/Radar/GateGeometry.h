@@ -0,0 +1,51 @@
+/*
+ *  GateGeometry.h
+ *  VORTRAC
+ *
+ *  Per-volume gate positions shared by gridding, QC and HVVP
+ *
+ */
+
+#ifndef GATEGEOMETRY_H
+#define GATEGEOMETRY_H
+
+class RadarData;
+
+class GateGeometry
+{
+
+ public:
+  GateGeometry(RadarData *radarData);
+  ~GateGeometry();
+
+  // Direction of each ray, with theta the math angle of the azimuth and
+  // phi the angle from zenith. The horizontal position of a gate at slant
+  // range r is x = r*sinPhi*cosTheta, y = r*sinPhi*sinTheta
+  float getSinPhi(int ray) const   { return sinPhi[ray]; }
+  float getCosTheta(int ray) const { return cosTheta[ray]; }
+  float getSinTheta(int ray) const { return sinTheta[ray]; }
+
+  // Beam height (km above the radar) of every gate in a ray.
+  // Rays are stored one after the other, so each sweep is contiguous.
+  const float* getRefHeight(int ray) const { return refHeight + refOffset[ray]; }
+  const float* getVelHeight(int ray) const { return velHeight + velOffset[ray]; }
+
+  int getNumRays() const { return numRays; }
+
+ private:
+  int numRays;
+  float *sinPhi;
+  float *cosTheta;
+  float *sinTheta;
+  long *refOffset;
+  long *velOffset;
+  float *refHeight;
+  float *velHeight;
+
+  // Not copyable
+  GateGeometry(const GateGeometry&);
+  GateGeometry& operator=(const GateGeometry&);
+
+};
+
+#endif
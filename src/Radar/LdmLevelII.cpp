@@ -10,11 +10,16 @@
 
 #include "LdmLevelII.h"
 #include "NRL/RadarQC.h"
+#include <QtConcurrent>
+#include <QThread>
 
 LdmLevelII::LdmLevelII(const QString &radarname, const float &lat, const float &lon, const QString &filename)
 	: LevelII(radarname, lat, lon, filename)
 {
-
+  ingestOffset = 0;
+  recNum = 0;
+  volumeComplete = false;
+  endedSweeps = 0;
 }
 
 bool LdmLevelII::readVolume()
@@ -23,6 +28,12 @@ bool LdmLevelII::readVolume()
   // Read in a compressed LDM level II file
   // Thanks to Dick Oye for some code used here
 
+  if (ingestOffset > 0) {
+	  // Already streaming this file, pick up any records left and finish
+	  ingestAvailable();
+	  return finishVolume();
+  }
+
   // Check the byte order
   if (!machineBigEndian()) {
     swap_bytes = true;
@@ -41,301 +52,458 @@ bool LdmLevelII::readVolume()
     swapVolHeader();
   }
 
-  // Read in blocks of data
-  char* nexBuffer = new char[2432];
-  int recNum = 0;
+  // Read in the compressed records. Each one is compressed on its own, so
+  // a batch of them is read and then decompressed in parallel. Only one
+  // batch is held at a time and its buffers are reused for the next.
+  int batchSize = 2*QThread::idealThreadCount();
+  if (batchSize < 2) {
+	  batchSize = 2;
+  }
+  QList<RecordTask> records;
+  for (int rec = 0; rec < batchSize; rec++) {
+	  records.append(RecordTask());
+  }
   while (!dataIn.atEnd()) {
 
-	  // Try to read 4 bytes for size
+	  int batchCount = 0;
+	  while ((batchCount < batchSize) && !dataIn.atEnd()) {
+
+		  // Try to read 4 bytes for size
+		  int recSize;
+		  dataIn.readRawData((char *)&recSize, 4);
+		  if (swap_bytes) {
+			  recSize = swap4((char *)&recSize);
+		  }
+
+		  // Read in the compressed record
+		  if (recSize < 0) {
+			  recSize = -recSize;
+		  }
+		  RecordTask &record = records[batchCount++];
+		  record.reserveCompressed(recSize);
+		  dataIn.readRawData((char *)record.compressed,recSize);
+	  }
+
+	  QtConcurrent::blockingMap(records.begin(), records.begin() + batchCount,
+								&LdmLevelII::runDecompressTask);
+
+	  // Parse the records in file order
+	  for (int rec = 0; rec < batchCount; rec++) {
+
+		  char* uncompressed = records[rec].uncompressed;
+		  unsigned int uncompSize = records[rec].uncompSize;
+		  if (records[rec].error) {
+			  // Didn't uncompress the data properly
+			  continue;
+		  }
+
+		  recNum++;
+		  // Skip the metadata at the beginning
+		  if ((recNum == 1) and (uncompSize == 325888)) {
+			  continue;
+		  }
+
+		  parseRecord(uncompressed, uncompSize);
+	  }
+  }
+  for (int rec = 0; rec < records.size(); rec++) {
+	  records[rec].release();
+  }
+
+  return finishVolume();
+
+}
+
+bool LdmLevelII::ingestAvailable()
+{
+
+  // Parse the records written since the last call, for a file that is
+  // still arriving. The file is only held open during the call.
+  if (volumeComplete)
+	  return false;
+
+  if (!machineBigEndian()) {
+	swap_bytes = true;
+  }
+  if(!radarFile->open(QIODevice::ReadOnly)) {
+	Message::report("Can't open radar volume");
+	return false;
+  }
+
+  bool found = false;
+  RecordTask record;
+  if (ingestOffset == 0) {
+	  if (radarFile->size() < (qint64)sizeof(nexrad_vol_scan_title)) {
+		  radarFile->close();
+		  return false;
+	  }
+	  radarFile->read((char *)volHeader, sizeof(nexrad_vol_scan_title));
+	  if (swap_bytes) {
+		  swapVolHeader();
+	  }
+	  ingestOffset = sizeof(nexrad_vol_scan_title);
+	  found = true;
+  }
+
+  while (!volumeComplete) {
+
+	  qint64 available = radarFile->size() - ingestOffset;
+	  if (available < 4)
+		  break;
 	  int recSize;
-	  dataIn.readRawData((char *)&recSize, 4);
+	  radarFile->seek(ingestOffset);
+	  radarFile->read((char *)&recSize, 4);
 	  if (swap_bytes) {
 		  recSize = swap4((char *)&recSize);
 	  }
-
-	  // Read in the compressed record
 	  if (recSize < 0) {
 		  recSize = -recSize;
 	  }
-	  char* compressed = new char[recSize];
-	  dataIn.readRawData((char *)compressed,recSize);
-
-	  unsigned int uncompSize = 262144;
-	  char* uncompressed = new char[uncompSize];
-	  int error;
-	  while (1) {
-		  error = BZ2_bzBuffToBuffDecompress(uncompressed, &uncompSize,
-											 compressed, recSize, 0, 0);
-		  if (error == BZ_OUTBUFF_FULL) {
-			  // Double the array
-			  uncompSize += 262144;
-			  delete[] uncompressed;
-			  uncompressed = new char[uncompSize];
-		  } else if (!error) {
-			  // Uncompress worked!
-			  break;
-		  } else {
-			  /* Some other error, but log functionality not currently available in this class
-			  if (error == BZ_CONFIG_ERROR)
-				  emit log(Message(QString("The BZ2 library has been miscompiled"),0,
-							   this->objectName(),Red,QString("Error reading Level II File")));
-			  if (error == BZ_PARAM_ERROR)
-				  emit log(Message(QString("Parameter Error in BZ2 Decompression"),0,
-							   this->objectName(),Yellow,QString("Error reading Level II File")));
-			  if (error == BZ_MEM_ERROR)
-				  emit log(Message(QString("Insufficient memory for BZ2 Decompression"),0,
-								   this->objectName(),Red,QString("Error reading Level II File")));
-			  if (error == BZ_DATA_ERROR)
-				  emit log(Message(QString("Compressed data exceeds destLen in BZ2 unzip"),0,
-								   this->objectName(),Yellow,QString("Error reading Level II File")));
-			  if (error == BZ_DATA_ERROR_MAGIC)
-				  emit log(Message(QString("Compressed data doesn't begin with right magic bytes"),0,
-								   this->objectName(),Yellow,QString("Error reading Level II File")));
-			  if (error == BZ_UNEXPECTED_EOF)
-				  emit log(Message(QString("Compressded data ended unexpectedly"),0,
-								   this->objectName(),Yellow,QString("Error reading Level II File")));
-			  */
-			  break;
-		  }
+	  if (available < 4 + (qint64)recSize) {
+		  // The rest of the record hasn't been written yet
+		  break;
 	  }
-	  delete[] compressed;
-	  if (error) {
-		  // Didn't uncompress the data properly
-		  delete[] uncompressed;
+
+	  record.reserveCompressed(recSize);
+	  radarFile->read(record.compressed, recSize);
+	  ingestOffset += 4 + recSize;
+	  found = true;
+
+	  runDecompressTask(record);
+	  if (record.error) {
 		  continue;
 	  }
-
 	  recNum++;
 	  // Skip the metadata at the beginning
-	  if ((recNum == 1) and (uncompSize == 325888)) {
-          delete[] uncompressed;
-          continue;
-      }
-
-	  unsigned int msgIncr = 0;
-	  //for (unsigned int i = 0; i < uncompSize; i += 2432) {
-	  while (msgIncr < uncompSize) {
-		  // Extract a packet, skipping metadata
-		  nexBuffer = (uncompressed + msgIncr);
-
-		  // Skip the CTM info
-		  //char *readPtr = nexBuffer + sizeof(CTM_info);
-		  char *readPtr = nexBuffer + 12;
-		  // Read in the message header
-		  msgHeader = (nexrad_message_header *)readPtr;
+	  if (!((recNum == 1) and (record.uncompSize == 325888))) {
+		  parseRecord(record.uncompressed, record.uncompSize);
+	  }
+  }
+  record.release();
+
+  // Sweeps whose last radial is in are final, put their moments in place
+  // so they can be QC'd while the rest of the volume arrives
+  packSweeps(endedSweeps);
+
+  radarFile->close();
+  return found;
+
+}
+
+bool LdmLevelII::finishVolume()
+{
+
+  // Record the number of rays in the last sweep
+  if (numSweeps > 0) {
+	  Sweeps[numSweeps-1].setLastRay(numRays-1);
+  }
+  packMoments();
+
+  // Should have all the data stored into memory now
+  radarFile->close();
+
+  isDealiased(false);
+
+  if(numSweeps < 5) {
+    // Corrupt radar volume
+    return false;
+  }
+
+  return true;
+
+}
+
+void LdmLevelII::parseRecord(char* uncompressed, unsigned int uncompSize)
+{
+
+  char* nexBuffer;
+  unsigned int msgIncr = 0;
+  //for (unsigned int i = 0; i < uncompSize; i += 2432) {
+  while (msgIncr < uncompSize) {
+	  // Extract a packet, skipping metadata
+	  nexBuffer = (uncompressed + msgIncr);
+
+	  // Skip the CTM info
+	  //char *readPtr = nexBuffer + sizeof(CTM_info);
+	  char *readPtr = nexBuffer + 12;
+	  // Read in the message header
+	  msgHeader = (nexrad_message_header *)readPtr;
+	  if (swap_bytes) {
+		  swapMsgHeader();
+	  }
+	  if (msgHeader->message_type == 1) {
+		  // Got some fixed length data
+		  sweepMsgType = 1;
+		  msg1Header = (message_1_data_header *)(readPtr + sizeof(nexrad_message_header));
 		  if (swap_bytes) {
-			  swapMsgHeader();
+			  swapMsg1Header();
 		  }
-		  if (msgHeader->message_type == 1) {
-			  // Got some fixed length data
-			  sweepMsgType = 1;
-			  msg1Header = (message_1_data_header *)(readPtr + sizeof(nexrad_message_header));
-			  if (swap_bytes) {
-				  swapMsg1Header();
-			  }
 
-			  vcp = msg1Header->vol_coverage_pattern;
+		  vcp = msg1Header->vol_coverage_pattern;
 
-			  // Is this a new sweep? Check radial status
-			  if (msg1Header->radial_status == 3) {
+		  // Is this a new sweep? Check radial status
+		  if (msg1Header->radial_status == 3) {
 
-				  // Beginning of volume
-				  volumeTime = msg1Header->milliseconds_past_midnight;
-				  volumeDate = msg1Header->julian_date;
-				  QDate initDate(1970,1,1);
-				  radarDateTime.setDate(initDate);
-				  radarDateTime.setTimeSpec(Qt::UTC);
-				  radarDateTime = radarDateTime.addDays(volumeDate - 1);
-				  radarDateTime = radarDateTime.addMSecs((qint64)volumeTime);
+			  // Beginning of volume
+			  volumeTime = msg1Header->milliseconds_past_midnight;
+			  volumeDate = msg1Header->julian_date;
+			  QDate initDate(1970,1,1);
+			  radarDateTime.setDate(initDate);
+			  radarDateTime.setTimeSpec(Qt::UTC);
+			  radarDateTime = radarDateTime.addDays(volumeDate - 1);
+			  radarDateTime = radarDateTime.addMSecs((qint64)volumeTime);
 
-				  // First sweep and ray
-				  addSweep(Sweeps);
-				  Sweeps[0].setFirstRay(0);
+			  // First sweep and ray
+			  addSweep(Sweeps);
+			  Sweeps[0].setFirstRay(0);
 
-			  } else if (msg1Header->radial_status == 0) {
+		  } else if (msg1Header->radial_status == 0) {
 
-				  // New sweep
-				  // Use Dennis' stuff here eventually
-				  // Count up rays in sweep
-				  Sweeps[numSweeps-1].setLastRay(numRays-1);
-				  // Increment array
-				  addSweep(&Sweeps[numSweeps]);
-				  // Sweeps[numSweeps].setFirstRay(numRays);
+			  // New sweep
+			  // Use Dennis' stuff here eventually
+			  // Count up rays in sweep
+			  Sweeps[numSweeps-1].setLastRay(numRays-1);
+			  endedSweeps = numSweeps;
+			  // Increment array
+			  addSweep(nextSweep());
+			  // Sweeps[numSweeps].setFirstRay(numRays);
 
-			  }
+		  }
 
-			  // Read ray of data
-			  if (msg1Header->ref_ptr) {
-				  char* const ref_buffer = readPtr + sizeof(nexrad_message_header) + msg1Header->ref_ptr;
-				  decode_ref(&Rays[numRays], ref_buffer, msg1Header->ref_num_gates);
-			  }
-			  if (msg1Header->vel_ptr) {
-				  char* const vel_buffer = readPtr + sizeof(nexrad_message_header) + msg1Header->vel_ptr;
-				  decode_vel(&Rays[numRays], vel_buffer, msg1Header->vel_num_gates, msg1Header->velocity_resolution);
-			  }
-			  if (msg1Header->sw_ptr) {
-				  char* const sw_buffer = readPtr + sizeof(nexrad_message_header) + msg1Header->sw_ptr;
-				  decode_sw(&Rays[numRays], sw_buffer, msg1Header->vel_num_gates);
-			  }
+		  // Read ray of data
+		  if (msg1Header->ref_ptr) {
+			  char* const ref_buffer = readPtr + sizeof(nexrad_message_header) + msg1Header->ref_ptr;
+			  decode_ref(nextRay(), ref_buffer, msg1Header->ref_num_gates);
+		  }
+		  if (msg1Header->vel_ptr) {
+			  char* const vel_buffer = readPtr + sizeof(nexrad_message_header) + msg1Header->vel_ptr;
+			  decode_vel(nextRay(), vel_buffer, msg1Header->vel_num_gates, msg1Header->velocity_resolution);
+		  }
+		  if (msg1Header->sw_ptr) {
+			  char* const sw_buffer = readPtr + sizeof(nexrad_message_header) + msg1Header->sw_ptr;
+			  decode_sw(nextRay(), sw_buffer, msg1Header->vel_num_gates);
+		  }
 
-			  // Put more rays in the volume, associated with the current Sweep;
-			  addRay(&Rays[numRays]);
+		  // Put more rays in the volume, associated with the current Sweep;
+		  addRay(nextRay());
+		  if (msg1Header->radial_status == 2) {
+			  // End of elevation, the sweep is complete
+			  Sweeps[numSweeps-1].setLastRay(numRays-1);
+			  endedSweeps = numSweeps;
+		  }
+		  if (msg1Header->radial_status == 4) {
+			  // End of volume
+			  volumeComplete = true;
+		  }
 
-		  } else if (msgHeader->message_type == 31) {
+	  } else if (msgHeader->message_type == 31) {
 
-		      // Got some variable length data
-			  sweepMsgType = 31;
+	      // Got some variable length data
+		  sweepMsgType = 31;
 
-			  msg31Header = (message_31_data_header *)(readPtr + sizeof(nexrad_message_header));
+		  msg31Header = (message_31_data_header *)(readPtr + sizeof(nexrad_message_header));
+		  if (swap_bytes) {
+			  swapMsg31Header();
+		  }
+
+		  // Read volume and radial data
+		  if (msg31Header->vol_ptr) {
+			  volume_block = (volume_data_block *)(readPtr + sizeof(nexrad_message_header) + msg31Header->vol_ptr);
 			  if (swap_bytes) {
-				  swapMsg31Header();
+				swapVolumeBlock();
 			  }
+			  vcp = volume_block->vol_coverage_pattern;
+		  }
 
-			  // Read volume and radial data
-			  if (msg31Header->vol_ptr) {
-				  volume_block = (volume_data_block *)(readPtr + sizeof(nexrad_message_header) + msg31Header->vol_ptr);
-				  if (swap_bytes) {
-					swapVolumeBlock();
-				  }
-				  vcp = volume_block->vol_coverage_pattern;
+		  if (msg31Header->radial_ptr) {
+			  radial_block = (radial_data_block *)(readPtr + sizeof(nexrad_message_header) + msg31Header->radial_ptr);
+			  if (swap_bytes) {
+				swapRadialBlock();
 			  }
+		  }
 
-			  if (msg31Header->radial_ptr) {
-				  radial_block = (radial_data_block *)(readPtr + sizeof(nexrad_message_header) + msg31Header->radial_ptr);
-				  if (swap_bytes) {
-					swapRadialBlock();
-				  }
+		  if (msg31Header->ref_ptr) {
+			  ref_block = (moment_data_block *)(readPtr + sizeof(nexrad_message_header) + msg31Header->ref_ptr);
+			  if (swap_bytes) {
+				swapMomentDataBlock(ref_block);
 			  }
-
-			  if (msg31Header->ref_ptr) {
-				  ref_block = (moment_data_block *)(readPtr + sizeof(nexrad_message_header) + msg31Header->ref_ptr);
-				  if (swap_bytes) {
-					swapMomentDataBlock(ref_block);
-				  }
-				  QString blockID(ref_block->block_type);
-				  if (blockID != QString("DREF")) {
-					// Skip this ray
-					//continue;
-				  }
-				  char* const ref_buffer = (char *)ref_block + sizeof(moment_data_block);
-				  decode_ref(&Rays[numRays], ref_buffer, ref_block->num_gates);
-				  ref_num_gates = ref_block->num_gates;
-				  ref_gate1 = ref_block->gate1;
-				  ref_gate_width = ref_block->gate_width;
-			  } else {
-			      ref_data = NULL;
-				  ref_num_gates = 0;
-				  ref_gate1 = 0;
-				  ref_gate_width = 0;
+			  QString blockID(ref_block->block_type);
+			  if (blockID != QString("DREF")) {
+				// Skip this ray
+				//continue;
 			  }
+			  char* const ref_buffer = (char *)ref_block + sizeof(moment_data_block);
+			  decode_ref(nextRay(), ref_buffer, ref_block->num_gates);
+			  ref_num_gates = ref_block->num_gates;
+			  ref_gate1 = ref_block->gate1;
+			  ref_gate_width = ref_block->gate_width;
+		  } else {
+		      ref_data = NULL;
+			  ref_num_gates = 0;
+			  ref_gate1 = 0;
+			  ref_gate_width = 0;
+		  }
 
-			  if (msg31Header->vel_ptr) {
-				  vel_block = (moment_data_block *)(readPtr + sizeof(nexrad_message_header) + msg31Header->vel_ptr);
-				  if (swap_bytes) {
-					swapMomentDataBlock(vel_block);
-				  }
-				  QString blockID(ref_block->block_type);
-				  if (blockID != QString("DVEL")) {
-					// Skip this ray
-					//continue;
-				  }
-				  char* const vel_buffer = (char *)vel_block + sizeof(moment_data_block);
-				  decode_vel(&Rays[numRays], vel_buffer, vel_block->num_gates, vel_block->scale);
-				  vel_num_gates = vel_block->num_gates;
-				  vel_gate1 = vel_block->gate1;
-				  vel_gate_width = vel_block->gate_width;
-			  } else {
-				  vel_data = NULL;
-				  vel_num_gates = 0;
-				  vel_gate1 = 0;
-				  vel_gate_width = 0;
+		  if (msg31Header->vel_ptr) {
+			  vel_block = (moment_data_block *)(readPtr + sizeof(nexrad_message_header) + msg31Header->vel_ptr);
+			  if (swap_bytes) {
+				swapMomentDataBlock(vel_block);
 			  }
-
-			  if (msg31Header->sw_ptr) {
-			      sw_block = (moment_data_block *)(readPtr + sizeof(nexrad_message_header) + msg31Header->sw_ptr);
-				  if (swap_bytes) {
-					swapMomentDataBlock(sw_block);
-				  }
-				  char* const sw_buffer = (char *)sw_block + sizeof(moment_data_block);
-				  decode_sw(&Rays[numRays], sw_buffer, sw_block->num_gates);
+			  QString blockID(ref_block->block_type);
+			  if (blockID != QString("DVEL")) {
+				// Skip this ray
+				//continue;
 			  }
+			  char* const vel_buffer = (char *)vel_block + sizeof(moment_data_block);
+			  decode_vel(nextRay(), vel_buffer, vel_block->num_gates, vel_block->scale);
+			  vel_num_gates = vel_block->num_gates;
+			  vel_gate1 = vel_block->gate1;
+			  vel_gate_width = vel_block->gate_width;
+		  } else {
+			  vel_data = NULL;
+			  vel_num_gates = 0;
+			  vel_gate1 = 0;
+			  vel_gate_width = 0;
+		  }
 
+		  if (msg31Header->sw_ptr) {
+		      sw_block = (moment_data_block *)(readPtr + sizeof(nexrad_message_header) + msg31Header->sw_ptr);
+			  if (swap_bytes) {
+				swapMomentDataBlock(sw_block);
+			  }
+			  char* const sw_buffer = (char *)sw_block + sizeof(moment_data_block);
+			  decode_sw(nextRay(), sw_buffer, sw_block->num_gates);
+		  }
 
 
-			  // Is this a new sweep? Check radial status
-			  if (msg31Header->radial_status == 3) {
-
-				  // Beginning of volume
-				  volumeTime = msg31Header->milliseconds_past_midnight;
-				  volumeDate = msg31Header->julian_date;
-				  QDate initDate(1970,1,1);
-				  radarDateTime.setDate(initDate);
-				  radarDateTime.setTimeSpec(Qt::UTC);
-				  radarDateTime = radarDateTime.addDays(volumeDate - 1);
-				  radarDateTime = radarDateTime.addMSecs((qint64)volumeTime);
 
-				  // First sweep and ray
-				  addSweep(Sweeps);
-				  Sweeps[0].setFirstRay(0);
+		  // Is this a new sweep? Check radial status
+		  if (msg31Header->radial_status == 3) {
+
+			  // Beginning of volume
+			  volumeTime = msg31Header->milliseconds_past_midnight;
+			  volumeDate = msg31Header->julian_date;
+			  QDate initDate(1970,1,1);
+			  radarDateTime.setDate(initDate);
+			  radarDateTime.setTimeSpec(Qt::UTC);
+			  radarDateTime = radarDateTime.addDays(volumeDate - 1);
+			  radarDateTime = radarDateTime.addMSecs((qint64)volumeTime);
+
+			  // First sweep and ray
+			  addSweep(Sweeps);
+			  Sweeps[0].setFirstRay(0);
+
+		  } else if (msg31Header->radial_status == 0) {
+
+			  // New sweep
+			  // Use Dennis' stuff here eventually
+			  // Count up rays in sweep
+			  Sweeps[numSweeps-1].setLastRay(numRays-1);
+			  endedSweeps = numSweeps;
+			  // Increment array
+			  addSweep(nextSweep());
+			  // Sweeps[numSweeps].setFirstRay(numRays);
+
+		  } else if (msg31Header->radial_status == 2) {
+		      // Bail out?
+              //int status = msg31Header->radial_status;
+			  //break;
+		  } else if (msg31Header->radial_status == 5) {
+              // Last sweep
+              Sweeps[numSweeps-1].setLastRay(numRays-1);
+              endedSweeps = numSweeps;
+			  // Increment array
+			  addSweep(nextSweep());
+          } else {
+              // Shouldn't be here
+              /* Check for missing sweep demarcation!
+              if ((msg31Header->elevation - Sweeps[numSweeps-1].getElevation()) > 0.2) {
+                  // This is probably a new sweep
+                  Sweeps[numSweeps-1].setLastRay(numRays-1);
+                  // Increment array
+                  addSweep(nextSweep());
+              } */
+          }
+
+		  // Put more rays in the volume, associated with the current Sweep;
+		  addRay(nextRay());
+		  if (msg31Header->radial_status == 2) {
+			  // End of elevation, the sweep is complete
+			  Sweeps[numSweeps-1].setLastRay(numRays-1);
+			  endedSweeps = numSweeps;
+		  }
+		  if (msg31Header->radial_status == 4) {
+			  // End of volume
+			  volumeComplete = true;
+		  }
 
-			  } else if (msg31Header->radial_status == 0) {
+	  } else {
+		  // Message Length is too short for binary segment
+		  msgHeader->message_len = 1210;
+	  }
 
-				  // New sweep
-				  // Use Dennis' stuff here eventually
-				  // Count up rays in sweep
-				  Sweeps[numSweeps-1].setLastRay(numRays-1);
-				  // Increment array
-				  addSweep(&Sweeps[numSweeps]);
-				  // Sweeps[numSweeps].setFirstRay(numRays);
+	  // Skip a variable # of bytes
+	  msgIncr += (msgHeader->message_len)*2 + 12;
 
-			  } else if (msg31Header->radial_status == 2) {
-			      // Bail out?
-                  //int status = msg31Header->radial_status;
-				  //break;
-			  } else if (msg31Header->radial_status == 5) {
-                  // Last sweep
-                  Sweeps[numSweeps-1].setLastRay(numRays-1);
-				  // Increment array
-				  addSweep(&Sweeps[numSweeps]);
-              } else {
-                  // Shouldn't be here
-                  /* Check for missing sweep demarcation!
-                  if ((msg31Header->elevation - Sweeps[numSweeps-1].getElevation()) > 0.2) {
-                      // This is probably a new sweep
-                      Sweeps[numSweeps-1].setLastRay(numRays-1);
-                      // Increment array
-                      addSweep(&Sweeps[numSweeps]);
-                  } */
-              }
-
-			  // Put more rays in the volume, associated with the current Sweep;
-			  addRay(&Rays[numRays]);
+  }
 
-		  } else {
-			  // Message Length is too short for binary segment
-			  msgHeader->message_len = 1210;
-		  }
+}
 
-		  // Skip a variable # of bytes
-		  msgIncr += (msgHeader->message_len)*2 + 12;
+void LdmLevelII::runDecompressTask(RecordTask &record)
+{
 
+  // Decompress into the record's buffer, growing it until the record fits
+  if (record.uncompCapacity == 0) {
+	  record.uncompCapacity = 262144;
+	  record.uncompressed = new char[record.uncompCapacity];
+  }
+  int error;
+  while (1) {
+	  unsigned int uncompSize = record.uncompCapacity;
+	  error = BZ2_bzBuffToBuffDecompress(record.uncompressed, &uncompSize,
+										 record.compressed, record.compSize, 0, 0);
+	  if (error == BZ_OUTBUFF_FULL) {
+		  // Grow the array
+		  record.uncompCapacity += 262144;
+		  delete[] record.uncompressed;
+		  record.uncompressed = new char[record.uncompCapacity];
+	  } else {
+		  // Uncompress worked, or some other error. Log functionality is
+		  // not currently available in this class
+		  record.uncompSize = error ? 0 : uncompSize;
+		  break;
 	  }
-
-	  delete[] uncompressed;
   }
-  // Record the number of rays in the last sweep
-  Sweeps[numSweeps-1].setLastRay(numRays-1);
+  record.error = error;
 
-  // Should have all the data stored into memory now
-  radarFile->close();
+}
 
-  isDealiased(false);
+LdmLevelII::RecordTask::RecordTask()
+{
+  compressed = NULL;
+  compSize = 0;
+  compCapacity = 0;
+  uncompressed = NULL;
+  uncompSize = 0;
+  uncompCapacity = 0;
+  error = BZ_OK;
+}
 
-  if(numSweeps < 5) {
-    // Corrupt radar volume
-    return false;
+void LdmLevelII::RecordTask::reserveCompressed(unsigned int size)
+{
+  if (size > compCapacity) {
+	  delete[] compressed;
+	  compressed = new char[size];
+	  compCapacity = size;
   }
+  compSize = size;
+}
 
-  return true;
-
+void LdmLevelII::RecordTask::release()
+{
+  delete[] compressed;
+  delete[] uncompressed;
+  compressed = uncompressed = NULL;
+  compCapacity = uncompCapacity = 0;
+  compSize = uncompSize = 0;
 }
@@ -20,7 +20,43 @@ class LdmLevelII : public LevelII
  public:
   LdmLevelII(const QString &radarname, const float &lat, const float &lon, const QString &filename);
   bool readVolume();
-  
+  bool ingestAvailable();
+  // Parses any complete records added to the file since the last call,
+  // so a volume can be read while it is still being written. Returns
+  // true if anything new was found. readVolume finishes the volume.
+  bool isVolumeComplete() const { return volumeComplete; }
+  // True once the end of volume radial has been parsed
+  int getNumFinishedSweeps() const { return packedSweeps; }
+  // The sweeps ingestAvailable has seen the end of elevation radial for,
+  // with their moments in place. Those can be QC'd before the volume is
+  // complete, the sweeps after them are still being filled.
+
+ private:
+  qint64 ingestOffset;
+  int recNum;
+  bool volumeComplete;
+  int endedSweeps;
+  void parseRecord(char* uncompressed, unsigned int uncompSize);
+  bool finishVolume();
+
+  // One compressed record of the volume and, once decompressed, its
+  // messages. Each record is decompressed by its own task. The buffers
+  // are kept from record to record and only grow, release frees them.
+  class RecordTask {
+  public:
+	RecordTask();
+	void reserveCompressed(unsigned int size);
+	void release();
+	char* compressed;
+	unsigned int compSize;
+	unsigned int compCapacity;
+	char* uncompressed;
+	unsigned int uncompSize;
+	unsigned int uncompCapacity;
+	int error;
+  };
+  static void runDecompressTask(RecordTask &record);
+
 };
 
 #endif
@@ -11,6 +11,7 @@
 #include "LevelII.h"
 #include "NRL/RadarQC.h"
 #include <unistd.h>
+#include <string.h>
 
 LevelII::LevelII(const QString &radarname, const float &lat, const float &lon, const QString &filename)
 	: RadarData(radarname, lat, lon, filename)
@@ -24,12 +25,15 @@ LevelII::LevelII(const QString &radarname, const float &lat, const float &lon, c
   //  msgHeader = new nexrad_message_header;
   msg1Header = NULL;
   msg31Header = NULL;
-  Sweeps = new Sweep[20];
-  Rays = new Ray[15000];
+  sweepCapacity = 20;
+  rayCapacity = 4096;
+  Sweeps = new Sweep[sweepCapacity];
+  Rays = new Ray[rayCapacity];
   swap_bytes = false;
   vel_data = NULL;
   sw_data = NULL;
   ref_data = NULL;
+  buildDecodeTables();
 }
 
 LevelII::~LevelII()
@@ -53,6 +57,37 @@ bool LevelII::readVolume()
 	return false;
 }
 
+Sweep* LevelII::nextSweep()
+{
+  if (numSweeps >= sweepCapacity) {
+    Sweep *grown = new Sweep[2 * sweepCapacity];
+    for (int n = 0; n < sweepCapacity; n++)
+      grown[n] = Sweeps[n];
+    delete [] Sweeps;
+    Sweeps = grown;
+    sweepCapacity *= 2;
+  }
+  return &Sweeps[numSweeps];
+}
+
+Ray* LevelII::nextRay()
+{
+  // The rays of a streamed volume may already point at packed sweeps, or
+  // own the reflectivity the QC rewrote. The copies take that over, so
+  // deleting the old rays frees nothing.
+  if (numRays >= rayCapacity) {
+    Ray *grown = new Ray[2 * rayCapacity];
+    for (int n = 0; n < rayCapacity; n++) {
+      grown[n] = Rays[n];
+      Rays[n] = Ray();
+    }
+    delete [] Rays;
+    Rays = grown;
+    rayCapacity *= 2;
+  }
+  return &Rays[numRays];
+}
+
 void LevelII::addSweep(Sweep* newSweep)
 {
 
@@ -141,66 +176,50 @@ void LevelII::addRay(Ray* newRay)
   //return *newRay;
 }
 
-void LevelII::decode_ref(Ray* newRay, const char *buffer, short int numGates)
+void LevelII::buildDecodeTables()
 {
 
-  newRay->allocateRefData( numGates );
-  float* refArray = newRay->getRefData();
-  // Decode each byte
-  for (short int i = 0; i <= numGates - 1; i++) {
-    unsigned char encoded = (unsigned char)buffer[i];
-    if (encoded == 0) {
-      refArray[i] = -999;
-    } else if (encoded == 1) {
-      // Ambiguous, set to bad for now
-      refArray[i] = -999;
+  for (int i = 0; i < 256; i++) {
+    if (i < 2) {
+      // Below threshold or ambiguous, set to bad for now
+      refTable[i] = velTable[i] = velHalfTable[i] = swTable[i] = -999;
     } else {
-      refArray[i] = (((float)encoded - 2.)/2.) - 32.0;
+      refTable[i] = (((float)i - 2.)/2.) - 32.0;
+      velHalfTable[i] = (((float)i - 2.)/2.) - 63.5;
+      velTable[i] = ((float)i - 2.) - 127.0;
+      swTable[i] = (((float)i - 2.)/2.) - 63.5;
     }
   }
 
 }
 
+void LevelII::decode_ref(Ray* newRay, const char *buffer, short int numGates)
+{
+
+  // Keep the codes, packMoments decodes them
+  quint8* codes = stageCodes(newRay - Rays, Sweep::Reflectivity, numGates, refTable);
+  if (numGates > 0)
+    memcpy(codes, buffer, numGates);
+
+}
+
 void LevelII::decode_vel(Ray* newRay, const char *buffer, short int numGates,
 			   short int velRes)
 {
 
-  newRay->allocateVelData( numGates );
-  float* velArray = newRay->getVelData();
-  // Decode each byte
-  for (int i = 0; i <= numGates - 1; i++) {
-    unsigned char encoded = (unsigned char)buffer[i];
-    if (encoded == 0) {
-      velArray[i] = -999;
-    } else if (encoded == 1) {
-      velArray[i] = -999;
-    } else {
-      if (velRes == 2) {
-	velArray[i] = (((float)encoded - 2.)/2.) - 63.5;
-      } else {
-	velArray[i] = ((float)encoded - 2.) - 127.0;
-      }
-    }
-  }
+  const float *table = (velRes == 2) ? velHalfTable : velTable;
+  quint8* codes = stageCodes(newRay - Rays, Sweep::Velocity, numGates, table);
+  if (numGates > 0)
+    memcpy(codes, buffer, numGates);
 
 }
 
 void LevelII::decode_sw(Ray* newRay, const char *buffer, short int numGates)
 {
 
-  newRay->allocateSwData( numGates );
-  float* swArray = newRay->getSwData();
-  // Decode each byte
-  for (int i = 0; i <= numGates - 1; i++) {
-    unsigned char encoded = (unsigned char)buffer[i];
-    if (encoded == 0) {
-      swArray[i] = -999;
-    } else if (encoded == 1) {
-      swArray[i] = -999;
-    } else {
-      swArray[i] = (((float)encoded - 2.)/2.) - 63.5;
-    }
-  }
+  quint8* codes = stageCodes(newRay - Rays, Sweep::SpectrumWidth, numGates, swTable);
+  if (numGates > 0)
+    memcpy(codes, buffer, numGates);
 
 }
 
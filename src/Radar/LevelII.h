@@ -26,6 +26,9 @@ class LevelII : public RadarData
   virtual bool readVolume() = 0;
   void addSweep(Sweep* newSweep);
   void addRay(Ray* newRay);
+  // The next unused Sweep and Ray, growing the arrays as needed
+  Sweep* nextSweep();
+  Ray* nextRay();
 
  protected:
   nexrad_vol_scan_title *volHeader;
@@ -40,6 +43,8 @@ class LevelII : public RadarData
   
   bool swap_bytes;
   int sweepMsgType;
+  int sweepCapacity;
+  int rayCapacity;
   float* ref_data;
   float* vel_data;
   float* sw_data;
@@ -50,6 +55,13 @@ class LevelII : public RadarData
   int ref_num_gates;
   int vel_num_gates;
   
+  // Level II moments are one byte codes, 0 below threshold and 1 range
+  // folded, decoded through these tables when the sweeps are packed
+  float refTable[256];
+  float velTable[256];
+  float velHalfTable[256];
+  float swTable[256];
+  void buildDecodeTables();
   void decode_ref(Ray* newRay, const char *buffer, short int numGates);
   void decode_vel(Ray* newRay, const char *buffer, short int numGates, short int velRes);
   void decode_sw(Ray* newRay, const char *buffer,  short int numGates);
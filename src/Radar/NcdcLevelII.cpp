@@ -10,6 +10,7 @@
 
 #include "NcdcLevelII.h"
 #include "NRL/RadarQC.h"
+#include <string.h>
 
 NcdcLevelII::NcdcLevelII(const QString &radarname, const float &lat, const float &lon, const QString &filename) : LevelII(radarname, lat, lon, filename)
 {
@@ -42,28 +43,46 @@ bool NcdcLevelII::readVolume()
         return false;
     }
 
-    QDataStream dataIn(radarFile);
+    // Map the file and parse the messages in place. The mapping is private
+    // so the headers can still be byte swapped where they are
+    qint64 fileSize = radarFile->size();
+    uchar* mapped = radarFile->map(0, fileSize, QFileDevice::MapPrivateOption);
+    QByteArray fileData;
+    char* fileStart;
+    if (mapped != NULL) {
+        fileStart = (char *)mapped;
+    } else {
+        // Can't map it, read the whole file instead
+        fileData = radarFile->readAll();
+        fileStart = fileData.data();
+        fileSize = fileData.size();
+    }
+    char* const fileEnd = fileStart + fileSize;
 
     // Get volume header
-    dataIn.readRawData((char *)volHeader, sizeof(nexrad_vol_scan_title));
+    if (fileSize < (qint64)sizeof(nexrad_vol_scan_title)) {
+        Message::report("Radar volume is too short");
+        if (mapped != NULL)
+            radarFile->unmap(mapped);
+        radarFile->close();
+        return false;
+    }
+    memcpy(volHeader, fileStart, sizeof(nexrad_vol_scan_title));
     if (swap_bytes) {
         swapVolHeader();
     }
 
-    // Read in blocks of data
-    char* const headBuffer = new char[28];
-    char* const nexBuffer = new char[131054];
+    // Walk the messages
+    char* filePtr = fileStart + sizeof(nexrad_vol_scan_title);
+    const int headSize = sizeof(nexrad_message_header) + 12;
     int recNum = 0;
-    //int recSize, headSize;
-    while (!dataIn.atEnd()) {
+    while (fileEnd - filePtr >= headSize) {
 
         recNum++;
         int recSize = 0;
-        int headSize = sizeof(nexrad_message_header) + 12;
-        dataIn.readRawData(headBuffer,headSize);
 
         // Skip the CTM info
-        char *headPtr = headBuffer + 12;
+        char *headPtr = filePtr + 12;
 
         // Read in the message header
         msgHeader = (nexrad_message_header *)headPtr;
@@ -76,8 +95,17 @@ bool NcdcLevelII::readVolume()
         } else {
             recSize = 2432 - headSize;
         }
-        dataIn.readRawData(nexBuffer,recSize);
-        char *readPtr = nexBuffer;
+        char *readPtr = filePtr + headSize;
+        if (recSize < 0) {
+            // Nothing to read, go on to the next header
+            filePtr = readPtr;
+            continue;
+        }
+        if (recSize > fileEnd - readPtr) {
+            // Truncated message at the end of the file
+            break;
+        }
+        filePtr = readPtr + recSize;
 
         if (msgHeader->message_type == 1) {
             // Got some fixed length data
@@ -112,7 +140,7 @@ bool NcdcLevelII::readVolume()
                 // Count up rays in sweep
                 Sweeps[numSweeps-1].setLastRay(numRays-1);
                 // Increment array
-                addSweep(&Sweeps[numSweeps]);
+                addSweep(nextSweep());
                 // Sweeps[numSweeps].setFirstRay(numRays);
 
             }
@@ -120,19 +148,19 @@ bool NcdcLevelII::readVolume()
             // Read ray of data
             if (msg1Header->ref_ptr) {
                 char* const ref_buffer = readPtr + msg1Header->ref_ptr;
-                decode_ref(&Rays[numRays], ref_buffer, msg1Header->ref_num_gates);
+                decode_ref(nextRay(), ref_buffer, msg1Header->ref_num_gates);
             }
             if (msg1Header->vel_ptr) {
                 char* const vel_buffer = readPtr + msg1Header->vel_ptr;
-                decode_vel(&Rays[numRays], vel_buffer, msg1Header->vel_num_gates, msg1Header->velocity_resolution);
+                decode_vel(nextRay(), vel_buffer, msg1Header->vel_num_gates, msg1Header->velocity_resolution);
             }
             if (msg1Header->sw_ptr) {
                 char* const sw_buffer = readPtr + msg1Header->sw_ptr;
-                decode_sw(&Rays[numRays], sw_buffer, msg1Header->vel_num_gates);
+                decode_sw(nextRay(), sw_buffer, msg1Header->vel_num_gates);
             }
 
             // Put more rays in the volume, associated with the current Sweep;
-            addRay(&Rays[numRays]);
+            addRay(nextRay());
 
         } else if (msgHeader->message_type == 31) {
 
@@ -171,7 +199,7 @@ bool NcdcLevelII::readVolume()
                     Message::report("Error in reflectivity block");
                 }
                 char* const ref_buffer = (char *)ref_block + sizeof(moment_data_block);
-                decode_ref(&Rays[numRays], ref_buffer, ref_block->num_gates);
+                decode_ref(nextRay(), ref_buffer, ref_block->num_gates);
                 ref_num_gates = ref_block->num_gates;
                 ref_gate1 = ref_block->gate1;
                 ref_gate_width = ref_block->gate_width;
@@ -193,7 +221,7 @@ bool NcdcLevelII::readVolume()
                     Message::report("Error in velocity block");
                 }
                 char* const vel_buffer = (char *)vel_block + sizeof(moment_data_block);
-                decode_vel(&Rays[numRays], vel_buffer, vel_block->num_gates, vel_block->scale);
+                decode_vel(nextRay(), vel_buffer, vel_block->num_gates, vel_block->scale);
                 vel_num_gates = vel_block->num_gates;
                 vel_gate1 = vel_block->gate1;
                 vel_gate_width = vel_block->gate_width;
@@ -210,7 +238,7 @@ bool NcdcLevelII::readVolume()
                     swapMomentDataBlock(sw_block);
                 }
                 char* const sw_buffer = (char *)sw_block + sizeof(moment_data_block);
-                decode_sw(&Rays[numRays], sw_buffer, sw_block->num_gates);
+                decode_sw(nextRay(), sw_buffer, sw_block->num_gates);
             }
 
 
@@ -238,7 +266,7 @@ bool NcdcLevelII::readVolume()
                 // Count up rays in sweep
                 Sweeps[numSweeps-1].setLastRay(numRays-1);
                 // Increment array
-                addSweep(&Sweeps[numSweeps]);
+                addSweep(nextSweep());
                 // Sweeps[numSweeps].setFirstRay(numRays);
 
             } else if (msg31Header->radial_status == 4) {
@@ -247,7 +275,7 @@ bool NcdcLevelII::readVolume()
             }
 
             // Put more rays in the volume, associated with the current Sweep;
-            addRay(&Rays[numRays]);
+            addRay(nextRay());
 
         } else {
             // Message Length is too short for binary segment
@@ -257,15 +285,15 @@ bool NcdcLevelII::readVolume()
     }
     // Record the number of rays in the last sweep
     Sweeps[numSweeps-1].setLastRay(numRays-1);
+    packMoments();
 
     // Should have all the data stored into memory now
+    if (mapped != NULL)
+        radarFile->unmap(mapped);
     radarFile->close();
 
     isDealiased(false);
 
-    delete[] headBuffer;
-    delete[] nexBuffer;
-
     if(numSweeps < 5) {
       // Corrupt radar volume
       return false;
@@ -10,6 +10,7 @@
 
 #include "RadarData.h"
 #include <math.h>
+#include <string.h>
 #include <QFile>
 #include <QTextStream>
 #include "Message.h"
@@ -30,11 +31,211 @@ RadarData::RadarData(QString radarname, float lat, float lon, QString filename)
   Rays = NULL;
   maxRange = 148; // default max unambiguated range. Can be overwritten in the config
   preGridded = false;
+  gateGeometry = NULL;
+  packedSweeps = 0;
 }
 
 RadarData::~RadarData()
 {
   delete radarFile;
+  delete gateGeometry;
+  for (int i = 0; i < momentBlocks.size(); i++)
+    delete [] momentBlocks[i];
+  for (int i = 0; i < codeBlocks.size(); i++)
+    delete [] codeBlocks[i];
+}
+
+float* RadarData::stageGates(int rayIndex, Sweep::Moment moment, int numGates)
+{
+  if (numGates < 0)
+    numGates = 0;
+  QVector<float> &gates = stagedGates[moment];
+  qint64 offset = gates.size();
+  gates.resize(offset + numGates);
+  stageRay(rayIndex, moment, offset, numGates, NULL);
+  return gates.data() + offset;
+}
+
+quint8* RadarData::stageCodes(int rayIndex, Sweep::Moment moment, int numGates,
+			      const float *table)
+{
+  if (numGates < 0)
+    numGates = 0;
+  QVector<quint8> &codes = stagedCodes[moment];
+  qint64 offset = codes.size();
+  codes.resize(offset + numGates);
+  stageRay(rayIndex, moment, offset, numGates, table);
+  return codes.data() + offset;
+}
+
+void RadarData::stageRay(int rayIndex, Sweep::Moment moment, qint64 offset,
+			 int numGates, const float *table)
+{
+  QVector<qint64> &offsets = stagedOffset[moment];
+  QVector<int> &counts = stagedCount[moment];
+  QVector<const float*> &tables = stagedTable[moment];
+  if (rayIndex >= offsets.size()) {
+    int oldSize = offsets.size();
+    int newSize = (rayIndex + 1 > 2 * oldSize) ? rayIndex + 1 : 2 * oldSize;
+    offsets.resize(newSize);
+    counts.resize(newSize);
+    tables.resize(newSize);
+    for (int r = oldSize; r < newSize; r++) {
+      offsets[r] = -1;
+      counts[r] = 0;
+      tables[r] = NULL;
+    }
+  }
+  offsets[rayIndex] = offset;
+  counts[rayIndex] = numGates;
+  tables[rayIndex] = table;
+}
+
+void RadarData::unpackRay(int moment, int rayIndex, float *row)
+{
+  qint64 offset = stagedOffset[moment][rayIndex];
+  int count = stagedCount[moment][rayIndex];
+  const float *table = stagedTable[moment][rayIndex];
+  if (table == NULL) {
+    memcpy(row, stagedGates[moment].constData() + offset, count * sizeof(float));
+    return;
+  }
+  const quint8 *codes = stagedCodes[moment].constData() + offset;
+  for (int g = 0; g < count; g++)
+    row[g] = table[codes[g]];
+}
+
+void RadarData::packSweeps(int count)
+{
+  if (count > numSweeps)
+    count = numSweeps;
+  if (rayPacked.size() < numRays)
+    rayPacked.resize(numRays);
+  for (; packedSweeps < count; packedSweeps++)
+    packSweep(packedSweeps);
+}
+
+void RadarData::packSweep(int sweepIndex)
+{
+  Sweep *sweep = &Sweeps[sweepIndex];
+  int first = sweep->getFirstRay();
+  int last = sweep->getLastRay();
+  bool valid = (first >= 0) && (last >= first) && (last < numRays);
+
+  for (int m = 0; m < Sweep::NumMoments; m++) {
+    Sweep::Moment moment = (Sweep::Moment)m;
+    QVector<qint64> &offsets = stagedOffset[m];
+    QVector<int> &counts = stagedCount[m];
+    const QVector<const float*> &tables = stagedTable[m];
+    if (!valid) {
+      sweep->setMomentBlock(moment, NULL, 0);
+      continue;
+    }
+
+    // Reflectivity and spectrum width are only read, so rays staged as
+    // codes keep them and decode through their table, see Ray::getRef.
+    // The split cut fill in RadarQC turns the rays it rewrites into
+    // floats. Dealiasing rewrites every velocity, so that is floats.
+    bool keepCodes = (m == Sweep::Reflectivity) || (m == Sweep::SpectrumWidth);
+    if (keepCodes) {
+      long numCodes = 0;
+      for (int r = first; (r <= last) && (r < offsets.size()); r++) {
+        if ((offsets[r] >= 0) && (tables[r] != NULL) && !rayPacked[r])
+          numCodes += counts[r];
+      }
+      quint8 *codes = NULL;
+      if (numCodes > 0) {
+        codes = new quint8[numCodes];
+        codeBlocks.append(codes);
+      }
+      long next = 0;
+      for (int r = first; (r <= last) && (r < offsets.size()); r++) {
+        if ((offsets[r] < 0) || (tables[r] == NULL) || rayPacked[r])
+          continue;
+        if (counts[r] > 0)
+          memcpy(codes + next, stagedCodes[m].constData() + offsets[r], counts[r]);
+        if (m == Sweep::Reflectivity)
+          Rays[r].setRefCodes(codes + next, tables[r]);
+        else
+          Rays[r].setSwCodes(codes + next, tables[r]);
+        next += counts[r];
+      }
+    }
+
+    // The widest ray sets the row length
+    int stride = 0;
+    for (int r = first; (r <= last) && (r < offsets.size()); r++) {
+      if ((offsets[r] < 0) || rayPacked[r] || (keepCodes && (tables[r] != NULL)))
+        continue;
+      if (counts[r] > stride)
+        stride = counts[r];
+    }
+    if (stride == 0) {
+      sweep->setMomentBlock(moment, NULL, 0);
+      continue;
+    }
+
+    long blockSize = (long)(last - first + 1) * stride;
+    float *block = new float[blockSize];
+    for (long i = 0; i < blockSize; i++)
+      block[i] = -999.;
+    momentBlocks.append(block);
+    sweep->setMomentBlock(moment, block, stride);
+
+    for (int r = first; r <= last; r++) {
+      if ((r >= offsets.size()) || (offsets[r] < 0) || rayPacked[r]
+          || (keepCodes && (tables[r] != NULL)))
+        continue;
+      float *row = block + (long)(r - first) * stride;
+      unpackRay(m, r, row);
+      Ray *ray = &Rays[r];
+      if (m == Sweep::Reflectivity)
+        ray->setRefData(row);
+      else if (m == Sweep::Velocity)
+        ray->setVelData(row);
+      else
+        ray->setSwData(row);
+    }
+  }
+
+  // A ray in two sweeps keeps the rows of the first
+  if (valid) {
+    for (int r = first; r <= last; r++)
+      rayPacked[r] = true;
+  }
+}
+
+void RadarData::packMoments()
+{
+  packSweeps(numSweeps);
+
+  for (int m = 0; m < Sweep::NumMoments; m++) {
+    QVector<qint64> &offsets = stagedOffset[m];
+    QVector<int> &counts = stagedCount[m];
+
+    // Rays outside every sweep get a block of their own
+    for (int r = 0; (r < numRays) && (r < offsets.size()); r++) {
+      if ((offsets[r] < 0) || rayPacked[r])
+        continue;
+      float *row = new float[counts[r] > 0 ? counts[r] : 1];
+      unpackRay(m, r, row);
+      momentBlocks.append(row);
+      Ray *ray = &Rays[r];
+      if (m == Sweep::Reflectivity)
+        ray->setRefData(row);
+      else if (m == Sweep::Velocity)
+        ray->setVelData(row);
+      else
+        ray->setSwData(row);
+    }
+
+    stagedGates[m] = QVector<float>();
+    stagedCodes[m] = QVector<quint8>();
+    stagedTable[m] = QVector<const float*>();
+    offsets = QVector<qint64>();
+    counts = QVector<int>();
+  }
+  rayPacked = QVector<bool>();
 }
 
 bool RadarData::readVolume()
@@ -132,6 +333,33 @@ float RadarData::absoluteRadarBeamHeight(float &distance, float elevation)
 }
 
 
+void RadarData::buildAzimuthIndex()
+{
+  for (int n = 0; n < numSweeps; n++)
+    buildAzimuthIndex(n);
+}
+
+void RadarData::buildAzimuthIndex(int sweepIndex)
+{
+  Sweep *currentSweep = &Sweeps[sweepIndex];
+  int numSweepRays = currentSweep->getNumRays();
+  if (numSweepRays <= 0)
+    return;
+  float *azimuths = new float[numSweepRays];
+  for (int r = 0; r < numSweepRays; r++)
+    azimuths[r] = Rays[currentSweep->getFirstRay() + r].getAzimuth();
+  currentSweep->buildAzimuthIndex(azimuths);
+  delete [] azimuths;
+}
+
+GateGeometry* RadarData::getGateGeometry()
+{
+  QMutexLocker locker(&geometryLock);
+  if (gateGeometry == NULL)
+    gateGeometry = new GateGeometry(this);
+  return gateGeometry;
+}
+
 void RadarData::setAltitude(const float newAltitude)
 {
   altitude = newAltitude;
@@ -15,8 +15,12 @@
 #include <QFile>
 #include <QDateTime>
 #include <QDomElement>
+#include <QMutex>
+#include <QVector>
+#include <QList>
 #include "Sweep.h"
 #include "Ray.h"
+#include "GateGeometry.h"
 
 class RadarData
 {
@@ -40,6 +44,16 @@ public:
     // returns height in km from radar;
     float absoluteRadarBeamHeight(float &distance, float elevation);
     // returns height in km from sea level;
+
+    void buildAzimuthIndex();
+    // bins the rays of every sweep by azimuth, see Sweep::getAzimuthBinRays.
+    // Must be called again if the rays change.
+    void buildAzimuthIndex(int sweepIndex);
+    // the same for one sweep
+    GateGeometry* getGateGeometry();
+    // gate positions for the volume, computed on first use. The ray and
+    // gate layout must not change after this has been called.
+    float getAltitude() { return altitude; }
     int getVCP() {return vcp;}
     void setAltitude(const float newAltitude);
     bool writeToFile(const QString fileName);
@@ -67,10 +81,43 @@ protected:
     int vcp;
     float altitude; // Tower height from sea level in km
 
+    float* stageGates(int rayIndex, Sweep::Moment moment, int numGates);
+    // Space for numGates gates of one moment of a ray while the volume is
+    // read. The pointer is only valid until the next call.
+    quint8* stageCodes(int rayIndex, Sweep::Moment moment, int numGates,
+		       const float *table);
+    // As stageGates, for formats with one byte codes. The codes are held
+    // as read and decoded through table, 256 values that must stay valid
+    // as long as the volume.
+    void packMoments();
+    // Copies the staged gates into one block per sweep and moment, see
+    // Sweep::getMomentBlock, and points each ray at its row. Reflectivity
+    // and spectrum width staged as codes stay as codes and have no block.
+    // Call once the sweeps' ray ranges are set.
+    void packSweeps(int count);
+    // As packMoments for the first count sweeps only, for a volume read
+    // while it arrives. Those sweeps' ray ranges must be final, the
+    // sweeps already packed are left alone. packMoments does the rest.
+    int packedSweeps;
+
 private:
+    void stageRay(int rayIndex, Sweep::Moment moment, qint64 offset,
+		  int numGates, const float *table);
+    void packSweep(int sweepIndex);
+    void unpackRay(int moment, int rayIndex, float *row);
+    QVector<float> stagedGates[Sweep::NumMoments];
+    QVector<quint8> stagedCodes[Sweep::NumMoments];
+    QVector<qint64> stagedOffset[Sweep::NumMoments];
+    QVector<int> stagedCount[Sweep::NumMoments];
+    QVector<const float*> stagedTable[Sweep::NumMoments];
+    QList<float*> momentBlocks;
+    QList<quint8*> codeBlocks;
+    QVector<bool> rayPacked;
     bool dealiased;
     float maxRange;   // max unambiguated range
     bool preGridded;
+    GateGeometry* gateGeometry;
+    QMutex geometryLock;
 };
 
 
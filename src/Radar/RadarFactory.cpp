@@ -11,6 +11,9 @@
 #include <iostream>
 #include <QPushButton>
 #include <unistd.h>
+#include <QVector>
+#include <QtAlgorithms>
+#include <QFileInfo>
 
 #include "RadarFactory.h"
 #include "DateChecker.h"
@@ -41,6 +44,24 @@ RadarFactory::RadarFactory(Configuration* radarConfig, QObject *parent): QObject
 
     QString path = mainConfig->getParam(radar,"dir");
     dataPath = QDir(path);
+    dataWatcher = new DirectoryWatcher(dataPath.absolutePath());
+    dataScanned = false;
+    waitingOnFile = false;
+
+    // Level II volumes are read with Radx unless the VORTRAC readers are
+    // asked for. These map NCDC files and decompress LDM records in
+    // parallel.
+    nativeLevelII = (mainConfig->getParam(radar,"levelii_reader") == "native");
+
+    // Real-time LDM volumes can be read as their records arrive instead of
+    // waiting for the file to stop growing. These are read with LdmLevelII
+    // rather than Radx.
+    streamingIngest = (mainConfig->getParam(radar,"streaming") == "true");
+    streamVolume = NULL;
+    streamTimeout = 60;
+    QString timeoutConfig = mainConfig->getParam(radar,"streamtimeout");
+    if (timeoutConfig != "")
+        streamTimeout = timeoutConfig.toInt();
 
     QString format = mainConfig->getParam(radar,"format");
     if (format == "LDMLEVELII") {
@@ -62,12 +83,17 @@ RadarFactory::~RadarFactory()
     mainConfig = NULL;
     delete mainConfig;
     delete radarQueue;
+    delete dataWatcher;
+    delete streamVolume;
 }
 
 RadarData* RadarFactory::getUnprocessedData()
 {
     // Get the latest files off the queue and make a radar object
 
+    if (streamVolume != NULL)
+        return continueStream();
+
     if (radarQueue->isEmpty()) {
         // We might end up here if we restart a trial that has no new data ...
         emit log(Message("No new data available for processing"));
@@ -75,22 +101,42 @@ RadarData* RadarFactory::getUnprocessedData()
     }
 
     // Get the files off the queue
-    QString fileName = dataPath.filePath(radarQueue->dequeue());
-
-    // Test file to make sure it is not growing
-    QFile radarFile(fileName);
-    qint64 newFilesize = radarFile.size();
-    qint64 prevFilesize = 0;
-    while (prevFilesize != newFilesize) {
-        prevFilesize = newFilesize;
-        sleep(1);
-        newFilesize = radarFile.size();
+    waitingOnFile = false;
+    QString file = radarQueue->dequeue();
+    QString fileName = dataPath.filePath(file);
+
+    if (streamingIngest && (radarFormat == ldmlevelII)) {
+        // Parse the records as they land, over as many calls as it takes
+        fileAnalyzed[fileName] = true;
+        streamFile = fileName;
+        streamVolume = new LdmLevelII(radarName, radarLat, radarLon, fileName);
+        streamVolume->setAltitude(radarAlt);
+        return continueStream();
+    }
+
+    // The watcher saw the file closed or moved in, so it is complete. One
+    // found by listing the directory may still be written, it goes to the
+    // back of the queue until it has been left alone for a moment.
+    if (!fileFinished.value(fileName) && !DirectoryWatcher::isQuiet(fileName)) {
+        radarQueue->enqueue(file);
+        waitingOnFile = true;
+        return NULL;
     }
-    sleep(1);
     // Mark it as processed
     fileAnalyzed[fileName] = true;
 
     // Now make a new radar object from that file and send it back
+    if (nativeLevelII && (radarFormat == ncdclevelII)) {
+        NcdcLevelII *radarData = new NcdcLevelII(radarName, radarLat, radarLon, fileName);
+        radarData->setAltitude(radarAlt);
+        return radarData;
+    }
+    if (nativeLevelII && (radarFormat == ldmlevelII)) {
+        LdmLevelII *radarData = new LdmLevelII(radarName, radarLat, radarLon, fileName);
+        radarData->setAltitude(radarAlt);
+        return radarData;
+    }
+
     switch(radarFormat) {
 
     case ldmlevelII:
@@ -146,19 +192,43 @@ RadarData* RadarFactory::getUnprocessedData()
     return NULL;
 }
 
+RadarData* RadarFactory::continueStream()
+{
+    // Parse whatever has landed since the last call. The volume is done at
+    // the end of volume radial. The idle timeout is only for a file that is
+    // still being written: one that was moved in whole, or has not changed
+    // for streamTimeout seconds, is read as it is without waiting.
+    streamVolume->ingestAvailable();
+    QFileInfo streamInfo(streamFile);
+    int idleSeconds = streamInfo.lastModified().secsTo(QDateTime::currentDateTime());
+    if (!streamVolume->isVolumeComplete() && !fileMovedIn.value(streamFile)
+        && streamInfo.exists() && (idleSeconds < streamTimeout)) {
+        // Come back for the rest
+        return NULL;
+    }
+
+    LdmLevelII *radarData = streamVolume;
+    streamVolume = NULL;
+    streamFile = QString();
+    return radarData;
+}
+
 bool RadarFactory::hasUnprocessedData()
 {
-    // Check the unprocessed list first, if it has files no need to reread directory yet
+    // A volume still streaming in comes first, then the unprocessed list.
+    // If that has files no need to reread directory yet
+
+    if (streamVolume != NULL) {
+        return true;
+    }
 
     if ( ! radarQueue->isEmpty() ) {
         return true;
     }
 
-    // Get a list of files in the radar directory
+    // Get a list of new files in the radar directory
 
-    dataPath.setFilter(QDir::Files);
-    dataPath.setSorting(QDir::Name);
-    QStringList filenames = dataPath.entryList();
+    QStringList filenames = candidateFiles();
 
     DateChecker *checker = DateCheckerFactory::newChecker(radarFormat);
 
@@ -169,8 +239,10 @@ bool RadarFactory::hasUnprocessedData()
 	continue;
 
       // Get the date info from the file name
-      if(checker->fileInRange(file, radarName, startDateTime, endDateTime))
+      if(checker->fileInRange(file, radarName, startDateTime, endDateTime)) {
+	fileScanTime[dataPath.filePath(file)] = checker->getTime();
 	radarQueue->enqueue(file);
+      }
     }
 
     delete checker;
@@ -367,6 +439,54 @@ bool RadarFactory::hasUnprocessedData()
 
 }
 
+QStringList RadarFactory::candidateFiles()
+{
+    // The first time through, or if the watcher lost track, list the whole
+    // directory. After that only the files the watcher saw finished.
+
+    if (dataWatcher->isValid() && dataScanned && !dataWatcher->needsRescan()) {
+        QStringList filenames = dataWatcher->finishedFiles();
+        filenames.removeDuplicates();
+        for (int i = 0; i < filenames.size(); i++)
+            markFinished(filenames.at(i));
+        filenames.sort();
+        return filenames;
+    }
+
+    // Files finished before the listing are in it. Take those events now
+    // so later ones are not lost.
+    QStringList finished = dataWatcher->finishedFiles();
+    finished.removeDuplicates();
+    for (int i = 0; i < finished.size(); i++)
+        markFinished(finished.at(i));
+
+    dataPath.setFilter(QDir::Files);
+    dataPath.setSorting(QDir::Name);
+    dataScanned = true;
+    return dataPath.entryList();
+}
+
+void RadarFactory::markFinished(const QString& file)
+{
+    QString path = dataPath.filePath(file);
+    fileFinished[path] = true;
+    fileMovedIn[path] = dataWatcher->takeMovedIn(file);
+}
+
+void RadarFactory::waitForData(int msecs)
+{
+    // Returns early when a file is finished in the data directory, or
+    // just sleeps if it can't be watched
+    dataWatcher->waitForFiles(msecs);
+}
+
+void RadarFactory::waitForChange(int msecs)
+{
+    // Returns early on any event in the data directory, even with files
+    // already waiting in the queue
+    dataWatcher->waitForChange(msecs);
+}
+
 void RadarFactory::catchLog(const Message& message)
 {
     emit log (message);
@@ -374,116 +494,51 @@ void RadarFactory::catchLog(const Message& message)
 
 void RadarFactory::updateDataQueue(const VortexList* list)
 {
-  if(!(list->count()>0))
+    // Drop the queued files that the vortex list shows were already
+    // processed, either within 30 seconds of an analysis or older than the
+    // last one. The scan times come from the catalog filled in when the
+    // files were queued, so no file names are parsed here.
+
+    if(!(list->count()>0))
         return;
-    int totalFiles = radarQueue->count();
-    for(int i = totalFiles-1; i >= 0; i--)
-    {
-        switch(radarFormat) {
-        case ncdclevelII:
-        {   // Check to see which are in the time limits
-            QString file = radarQueue->at(i);
-            QString timepart = file;
-            // Replace the radarname so we just have timestamps
-            //KAMX20050825_060806-->20050825,060806
-            timepart.replace(radarName, "");
-            QStringList timestamp = timepart.split("_");
-            QDate fileDate = QDate::fromString(timestamp.at(0), "yyyyMMdd");
-            QTime fileTime = QTime::fromString(timestamp.at(1), "hhmmss");
-            QDateTime fileDateTime = QDateTime(fileDate, fileTime, Qt::UTC);
+    if ((radarFormat != ncdclevelII) && (radarFormat != ldmlevelII)) {
+        // Not yet implemented
+        return;
+    }
 
-            if (fileDateTime >= startDateTime && fileDateTime <= endDateTime){
-                // Valid time and radar name, check to see if it
-                //  has been processed in vortexList
-                for(int j = 0; j < list->size(); j++) {
-                    QDateTime processedTime = list->at(j).getTime();
-                    if(abs(processedTime.secsTo(fileDateTime)) < 30) {
-                        if (!fileAnalyzed[dataPath.filePath(file)]) {
-                            // File has been analyzed, remove it from the queue
-                            radarQueue->removeAt(radarQueue->indexOf(file));
-                            fileAnalyzed[dataPath.filePath(file)] = true;
-                        }
-                    }
-                    else {
-                        if(list->last().getTime() >  fileDateTime)
-                            if(!fileAnalyzed[dataPath.filePath(file)]) {
-                                radarQueue->removeAt(radarQueue->indexOf(file));
-                                fileAnalyzed[dataPath.filePath(file)] = true;
-                            }
-                    }
-                }
+    // Sorted analysis times for the nearby lookup
+    QVector<QDateTime> processedTimes(list->size());
+    for(int j = 0; j < list->size(); j++)
+        processedTimes[j] = list->at(j).getTime();
+    qSort(processedTimes.begin(), processedTimes.end());
+    QDateTime lastTime = list->last().getTime();
+
+    QQueue<QString> *remaining = new QQueue<QString>;
+    while (!radarQueue->isEmpty()) {
+        QString file = radarQueue->dequeue();
+        QString filePath = dataPath.filePath(file);
+        QHash<QString, QDateTime>::const_iterator scan = fileScanTime.constFind(filePath);
+        if ((scan != fileScanTime.constEnd()) && !fileAnalyzed.value(filePath)) {
+            QDateTime fileDateTime = scan.value();
+            bool processed = (lastTime > fileDateTime);
+            if (!processed) {
+                // First analysis less than 30 seconds before the scan
+                QVector<QDateTime>::const_iterator near =
+                    qLowerBound(processedTimes.constBegin(), processedTimes.constEnd(),
+                                fileDateTime.addMSecs(-29999));
+                processed = (near != processedTimes.constEnd())
+                    && (*near <= fileDateTime.addMSecs(29999));
             }
-            break;
-        }
-        case ldmlevelII:
-        {
-            // Should have filenames starting with radar ID
-            // Check to see which are already in vortexList
-            QString file = radarQueue->at(i);
-            QString timepart = file.split("/").last();
-            // Replace the radarname so we just have timestamps
-            timepart.replace(radarName, "");
-            QDate fileDate;
-            QTime fileTime;
-            if (timepart.contains('.')) {
-                // NRL Format
-                QStringList timestamp = timepart.split(".");
-                fileDate = QDate::fromString(timestamp.at(1).left(8), "yyyyMMdd");
-                fileTime = QTime::fromString(timestamp.at(1).right(6), "hhmmss");
-            }  else if (timepart.contains('_')) {
-                // Purdue Format
-                QStringList timestamp = timepart.split("_");
-                fileDate = QDate::fromString(timestamp.at(1), "yyyyMMdd");
-                if (timestamp.size() > 2) {
-                    fileTime = QTime::fromString(timestamp.at(2), "hhmm");
-                } else {
-                    emit log(Message(QString("Problem with time in level_II filename, this may be a NCDC file"),0,this->objectName(),Red,QString("Radar format mismatch?")));
-                }
+            if (processed) {
+                // File has been analyzed, leave it off the queue
+                fileAnalyzed[filePath] = true;
+                continue;
             }
-
-            QDateTime fileDateTime = QDateTime(fileDate, fileTime, Qt::UTC);
-            if (fileDateTime >= startDateTime && fileDateTime <= endDateTime){
-                // Valid time and radar name, check to see if it
-                //  has been processed in vortexList
-                for(int j = 0; j < list->size(); j++) {
-                    QDateTime processedTime = list->at(j).getTime();
-                    if(abs(processedTime.secsTo(fileDateTime)) < 30) {
-                        if (!fileAnalyzed[dataPath.filePath(file)]) {
-                            // File has been analyzed, remove it from the queue
-                            radarQueue->removeAt(radarQueue->indexOf(file));
-                            fileAnalyzed[dataPath.filePath(file)] = true;
-                            //  Message::toScreen("Plucked file "+file+" from the list");
-                        }
-                    }
-                    else {
-                        if(list->last().getTime() >  fileDateTime)
-                            if(!fileAnalyzed[dataPath.filePath(file)]) {
-                                radarQueue->removeAt(radarQueue->indexOf(file));
-                                fileAnalyzed[dataPath.filePath(file)] = true;
-                            }
-                    }
-                }
-            }
-            break;
-        }
-        case model:
-        {
-            // Not yet implemented
-            break;
-        }
-        case dorade:
-        {
-            // Not yet implemented
-            break;
-        }
-        case netcdf:
-        {
-            // Not yet implemented
-            break;
-        }
-
         }
+        remaining->enqueue(file);
     }
+    delete radarQueue;
+    radarQueue = remaining;
 }
 
 int RadarFactory::getNumProcessed() const
@@ -25,6 +25,7 @@
 #include "Radar/AnalyticRadar.h"
 #include "Radar/RadxData.h"
 #include "IO/Message.h"
+#include "IO/DirectoryWatcher.h"
 #include "GUI/ConfigTree.h"
 #include "DataObjects/VortexList.h"
 
@@ -40,6 +41,15 @@ public:
     RadarData* getUnprocessedData();
     bool hasUnprocessedData();
     int getNumProcessed() const;
+    void waitForData(int msecs);
+    // True when getUnprocessedData returned NULL for data that is still
+    // arriving, a streamed volume or a file written moments ago. Wait for
+    // the watcher before asking again.
+    bool isWaiting() const { return (streamVolume != NULL) || waitingOnFile; }
+    void waitForChange(int msecs);
+    // The volume streaming in, NULL if there is none. Its finished sweeps
+    // can be QC'd while getUnprocessedData waits for the rest.
+    LdmLevelII* getStreamVolume() const { return streamVolume; }
 
     enum dataFormat {
       ncdclevelII,
@@ -60,16 +70,33 @@ signals:
 
 private:
 
+    QStringList candidateFiles();
+    void markFinished(const QString& file);
+
     QDir dataPath;
+    DirectoryWatcher *dataWatcher;
+    bool dataScanned;
+    QHash<QString, bool> fileFinished;
+    QHash<QString, bool> fileMovedIn;
+    bool waitingOnFile;
     QString radarName;
     float radarLat;
     float radarLon;
     float radarAlt;
     dataFormat radarFormat;
+    bool nativeLevelII;
+    bool streamingIngest;
+    int streamTimeout;
+    LdmLevelII *streamVolume;
+    QString streamFile;
+    RadarData* continueStream();
     QQueue<QString> *radarQueue;
     QDateTime startDateTime;
     QDateTime endDateTime;
     QHash<QString, bool> fileAnalyzed;
+    // Scan time of every file that has been queued, parsed from its name
+    // by the DateChecker for the format
+    QHash<QString, QDateTime> fileScanTime;
     QDateTime radarDateTime;
     Configuration* mainConfig;
 };
@@ -10,6 +10,8 @@
 #include "Radx/RadxVol.hh"
 #include "Radx/RadxSweep.hh"
 #include "Radx/RadxRay.hh"
+#include "Radx/RadxField.hh"
+#include <string.h>
 
 #include "RadxData.h"
 //#include "RadarQC.h"
@@ -30,15 +32,45 @@ RadxData::~RadxData()
   delete [] Rays;
   Sweeps = NULL;
   Rays = NULL;
+  for (int i = 0; i < decodeTables.size(); i++)
+    delete decodeTables[i];
 }
 
-// TODO
-// This essentially takes an array of float from the Radx library, and shove it into an array
-// of float in the Radar object.
-// See if we can change the RadarData interface to access the Radx data directly
-// - Maybe put a handle to the field instead of the arrays
+// The table holds what convertToFl32 would give for each code, with the
+// missing code mapped to -999
 
-float *RadxData::getRayData(RadxRay *fileRay, const char *fieldName)
+const float* RadxData::decodeTable(const RadxField *field)
+{
+  double scale = field->getScale();
+  double offset = field->getOffset();
+  int missing = field->getMissingUi08();
+  for (int i = 0; i < decodeTables.size(); i++) {
+    DecodeTable *table = decodeTables[i];
+    if ((table->scale == scale) && (table->offset == offset) && (table->missing == missing))
+      return table->values;
+  }
+
+  DecodeTable *table = new DecodeTable;
+  table->scale = scale;
+  table->offset = offset;
+  table->missing = missing;
+  for (int code = 0; code < 256; code++) {
+    if (code == missing)
+      table->values[code] = -999.0;
+    else
+      table->values[code] = (Radx::fl32) (code * scale + offset);
+  }
+  decodeTables.append(table);
+  return table->values;
+}
+
+// This takes an array of float from the Radx library and stages it for the ray,
+// packMoments then moves it into the sweep's block for that moment. One
+// byte fields are staged as codes instead.
+// Returns false if the ray doesn't have the field.
+
+bool RadxData::getRayData(RadxRay *fileRay, const char *fieldName, int rayIndex,
+			  Sweep::Moment moment)
 {
   const RadxRay::FieldNameMap fieldMap = fileRay->getFieldNameMap();
 
@@ -49,18 +81,23 @@ float *RadxData::getRayData(RadxRay *fileRay, const char *fieldName)
   name_it = fieldMap.find(fieldName);
 
   if (name_it == fieldMap.end())
-    return NULL;
+    return false;
 
   RadxField *field = fileRay->getField(name_it->second);
   if (field == NULL)
-    return NULL;
+    return false;
 
-  float *retVal = new float[field->getNPoints()];
-  if (retVal == NULL) {
-    std::cerr << "RadxData::fillRayData: Failed to allocate data array" << std::endl;
-    return NULL;
+  // One byte fields keep their codes, packMoments decodes what has to
+  // be floats
+  if (field->getDataType() == Radx::UI08) {
+    quint8 *codes = stageCodes(rayIndex, moment, field->getNPoints(), decodeTable(field));
+    if (field->getNPoints() > 0)
+      memcpy(codes, field->getDataUi08(), field->getNPoints());
+    return true;
   }
 
+  float *retVal = stageGates(rayIndex, moment, field->getNPoints());
+
   // Convert field to float32
   field->convertToFl32();
 
@@ -77,7 +114,7 @@ float *RadxData::getRayData(RadxRay *fileRay, const char *fieldName)
       val = -999.0;
     retVal[index] = val;
   }
-  return retVal;
+  return true;
 }
 
 bool RadxData::readVolume()
@@ -166,18 +203,17 @@ bool RadxData::readVolume()
     // With file.setReadPreserveSweeps(true) above (to match what the old reader was doing),
     //    we might have long rays that don't have VEL and SW
 
-    myRay->setRefData(getRayData(fileRay, "REF"));
-    myRay->setVelData(getRayData(fileRay, "VEL"));
-    myRay->setSwData( getRayData(fileRay, "SW"));
+    getRayData(fileRay, "REF", rayCount, Sweep::Reflectivity);
+    bool hasVel = getRayData(fileRay, "VEL", rayCount, Sweep::Velocity);
+    getRayData(fileRay, "SW", rayCount, Sweep::SpectrumWidth);
 
     // Lots of algorithms (QC Cappi, can't deal with missing Vel)
     // So fill in the Velocity data with -999)
 
-    if(myRay->getVelData() == NULL) {
-      float *buffer = new float[nGates];
+    if(!hasVel) {
+      float *buffer = stageGates(rayCount, Sweep::Velocity, nGates);
       for(int i = 0; i < nGates; i++)
 	buffer[i] = -999;
-      myRay->setVelData(buffer);
     }
   }
 
@@ -242,6 +278,9 @@ bool RadxData::readVolume()
 
   numSweeps = sweepCount;
 
+  // Move the staged gates into one block per sweep and moment
+  packMoments();
+
   // Set the volume date to the date of the first ray
   radarDateTime.setTimeSpec(Qt::UTC);
   radarDateTime = QDateTime::fromTime_t(Rays[0].getDate());
@@ -1,6 +1,7 @@
 #ifndef RADXDATA_H
 #define RADXDATA_H
 
+#include <QList>
 #include "Radx/RadxRay.hh"
 #include "RadarData.h"
 
@@ -13,7 +14,21 @@ class RadxData : public RadarData
   ~RadxData();
 
   bool readVolume();
-  float *getRayData(RadxRay *fileRay, const char *fieldName);
+  bool getRayData(RadxRay *fileRay, const char *fieldName, int rayIndex,
+		  Sweep::Moment moment);
+
+ private:
+  // Decoding for one byte fields, one table per scale, offset and
+  // missing code in the volume
+  class DecodeTable {
+  public:
+    double scale;
+    double offset;
+    int missing;
+    float values[256];
+  };
+  const float* decodeTable(const RadxField *field);
+  QList<DecodeTable*> decodeTables;
   
 };
 
@@ -23,6 +23,13 @@ Ray::Ray()
   refData = NULL;
   velData = NULL;
   swData = NULL;
+  refCodes = NULL;
+  refTable = NULL;
+  swCodes = NULL;
+  swTable = NULL;
+  ownsRefData = false;
+  ownsVelData = false;
+  ownsSwData = false;
   unambig_range = -999;
   nyquist_vel = -999;
   first_ref_gate = -999;
@@ -36,9 +43,9 @@ Ray::Ray()
 
 Ray::~Ray()
 {
-  if (refData != NULL) delete [] refData;
-  if (velData != NULL) delete [] velData;
-  if (swData != NULL) delete [] swData;
+  if (ownsRefData) delete [] refData;
+  if (ownsVelData) delete [] velData;
+  if (ownsSwData) delete [] swData;
 }
 
 void Ray::setTime(const int &value) {
@@ -72,15 +79,59 @@ void Ray::setSweepIndex(const int &value) {
 }
 
 void Ray::allocateRefData(const short int numGates) {
+  if (ownsRefData) delete [] refData;
   refData = new float[numGates];
+  ownsRefData = true;
+  refCodes = NULL;
 }
 
 void Ray::allocateVelData(const short int numGates) {
+  if (ownsVelData) delete [] velData;
   velData = new float[numGates];
+  ownsVelData = true;
 }
 
 void Ray::allocateSwData(const short int numGates) {
+  if (ownsSwData) delete [] swData;
   swData = new float[numGates];
+  ownsSwData = true;
+  swCodes = NULL;
+}
+
+void Ray::setRefData(float *buffer) {
+  if (ownsRefData) delete [] refData;
+  refData = buffer;
+  ownsRefData = false;
+  refCodes = NULL;
+}
+
+void Ray::setVelData(float *buffer) {
+  if (ownsVelData) delete [] velData;
+  velData = buffer;
+  ownsVelData = false;
+}
+
+void Ray::setSwData(float *buffer) {
+  if (ownsSwData) delete [] swData;
+  swData = buffer;
+  ownsSwData = false;
+  swCodes = NULL;
+}
+
+void Ray::setRefCodes(const unsigned char *codes, const float *table) {
+  if (ownsRefData) delete [] refData;
+  refData = NULL;
+  ownsRefData = false;
+  refCodes = codes;
+  refTable = table;
+}
+
+void Ray::setSwCodes(const unsigned char *codes, const float *table) {
+  if (ownsSwData) delete [] swData;
+  swData = NULL;
+  ownsSwData = false;
+  swCodes = codes;
+  swTable = table;
 }
 
 void Ray::setUnambig_range(const float &value) {
@@ -154,6 +205,18 @@ float* Ray::getRefData() {
   return refData;
 }
 
+float* Ray::writableRefData() {
+  if ((refData != NULL) || (ref_numgates <= 0))
+    return refData;
+  float *decoded = new float[ref_numgates];
+  for (int i = 0; i < ref_numgates; i++)
+    decoded[i] = (refCodes != NULL) ? refTable[refCodes[i]] : -999.0;
+  refData = decoded;
+  ownsRefData = true;
+  refCodes = NULL;
+  return refData;
+}
+
 float* Ray::getVelData() {
   return velData;
 }
@@ -245,8 +308,13 @@ void Ray::dumpFloat(int size, float *buf)
 void Ray::dumpRef()
 {
   int max = getRef_numgates();
-  float *data = getRefData();
+  if (!hasRefData())
+    return;
+  float *data = new float[max];
+  for (int i = 0; i < max; i++)
+    data[i] = getRef(i);
   dumpFloat(max, data);
+  delete [] data;
 }
 
 void Ray::dumpVel()
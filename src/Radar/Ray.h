@@ -44,9 +44,17 @@ class Ray
   void setVcp(const int &value);
   void emptyRefgates(const short int numGates);
 
-  void setRefData(float *buffer) { refData = buffer; };
-  void setVelData(float *buffer) { velData = buffer; };
-  void setSwData(float *buffer)  { swData = buffer; };
+  // Point the ray at gates it does not own, normally its row of a sweep
+  // moment block held by RadarData. Buffers from allocateRefData and
+  // friends are owned and freed with the ray.
+  void setRefData(float *buffer);
+  void setVelData(float *buffer);
+  void setSwData(float *buffer);
+  // Reflectivity or spectrum width kept as one byte codes, decoded
+  // through table (256 values) by getRef and getSw. Neither codes nor
+  // table is owned by the ray.
+  void setRefCodes(const unsigned char *codes, const float *table);
+  void setSwCodes(const unsigned char *codes, const float *table);
   
   int getTime();
   int getDate();
@@ -56,8 +64,21 @@ class Ray
   int getRayIndex();
   int getSweepIndex();
   float* getRefData();
+  // Reflectivity of one gate, whether held as floats or as codes.
+  // getRefData() is NULL for rays set with setRefCodes, code that
+  // rewrites reflectivity asks for writableRefData, which decodes the
+  // ray into floats it owns first.
+  bool hasRefData() const { return (refData != NULL) || (refCodes != NULL); }
+  float getRef(int gate) const
+    { return (refCodes != NULL) ? refTable[refCodes[gate]] : refData[gate]; }
+  float* writableRefData();
   float* getVelData();
   float* getSwData();
+  // Spectrum width of one gate, whether held as floats or as codes.
+  // getSwData() is NULL for rays set with setSwCodes.
+  bool hasSwData() const { return (swData != NULL) || (swCodes != NULL); }
+  float getSw(int gate) const
+    { return (swCodes != NULL) ? swTable[swCodes[gate]] : swData[gate]; }
   float getUnambig_range();
   float getNyquist_vel();
   int getFirst_ref_gate();
@@ -84,6 +105,13 @@ class Ray
   float *refData;
   float *velData;
   float *swData;
+  const unsigned char *refCodes;
+  const float *refTable;
+  const unsigned char *swCodes;
+  const float *swTable;
+  bool ownsRefData;
+  bool ownsVelData;
+  bool ownsSwData;
   float unambig_range;
   float nyquist_vel;
   int first_ref_gate;
@@ -8,11 +8,16 @@
  *
  */
 #include <iostream>
+#include <math.h>
 
 #include "Sweep.h"
 
 Sweep::Sweep()
 {
+  for (int m = 0; m < NumMoments; m++) {
+    momentBlock[m] = NULL;
+    momentStride[m] = 0;
+  }
 }
 
 Sweep::~Sweep()
@@ -129,6 +134,50 @@ int Sweep::getNumRays() {
   return (lastRay - firstRay + 1);
 }
 
+int Sweep::azimuthBin(float azimuth) {
+  if (isnan(azimuth) || isinf(azimuth))
+    return -1;
+  int bin = (int)floor(azimuth) % numAzimuthBins;
+  if (bin < 0)
+    bin += numAzimuthBins;
+  return bin;
+}
+
+void Sweep::buildAzimuthIndex(const float* azimuths) {
+  // Counting sort of the rays into their bins, which keeps ray order
+  // within each bin
+  int numRays = getNumRays();
+  azimuthBinStart.fill(0, numAzimuthBins + 1);
+  azimuthBinRays.resize(numRays > 0 ? numRays : 0);
+  for (int r = 0; r < numRays; r++) {
+    int bin = azimuthBin(azimuths[r]);
+    if (bin >= 0)
+      azimuthBinStart[bin + 1]++;
+  }
+  for (int bin = 0; bin < numAzimuthBins; bin++)
+    azimuthBinStart[bin + 1] += azimuthBinStart[bin];
+  QVector<int> next = azimuthBinStart;
+  for (int r = 0; r < numRays; r++) {
+    int bin = azimuthBin(azimuths[r]);
+    if (bin >= 0)
+      azimuthBinRays[next[bin]++] = firstRay + r;
+  }
+}
+
+void Sweep::setMomentBlock(Moment moment, float *block, int stride) {
+  momentBlock[moment] = block;
+  momentStride[moment] = stride;
+}
+
+const int* Sweep::getAzimuthBinRays(int bin, int &count) const {
+  if (azimuthBinStart.isEmpty() || (bin < 0) || (bin >= numAzimuthBins)) {
+    count = 0;
+    return NULL;
+  }
+  count = azimuthBinStart[bin + 1] - azimuthBinStart[bin];
+  return azimuthBinRays.constData() + azimuthBinStart[bin];
+}
+
 void Sweep::dump() {
   std::cout << "---------- Sweep " << getSweepIndex() << " ----------" << std::endl;
   std::cout << "\t       Elevation: " << getElevation() << std::endl;
@@ -11,10 +11,14 @@
 #ifndef SWEEP_H
 #define SWEEP_H
 
+#include <QVector>
+
 class Sweep
 {
 
 public:
+  enum Moment { Reflectivity, Velocity, SpectrumWidth, NumMoments };
+
   Sweep();
   ~Sweep();
   void setSweepIndex(const int &value);
@@ -58,6 +62,26 @@ public:
   int getLastRay();
   int getNumRays();
 
+  // Azimuth index. The rays of the sweep are binned by whole degree of
+  // azimuth so the rays near an azimuth can be found without scanning
+  // the sweep. azimuths holds the azimuth of each ray from getFirstRay()
+  // to getLastRay().
+  static const int numAzimuthBins = 360;
+  static int azimuthBin(float azimuth);
+  void buildAzimuthIndex(const float* azimuths);
+  bool hasAzimuthIndex() const { return !azimuthBinStart.isEmpty(); }
+  // The absolute indices of the rays in one bin, in ray order
+  const int* getAzimuthBinRays(int bin, int &count) const;
+
+  // Moment storage. Each moment of the sweep is one contiguous block
+  // owned by RadarData, getNumRays() rows of getMomentStride() gates with
+  // unused gates set to -999. Rays without the moment have a NULL pointer
+  // rather than a row. The block is NULL if no ray has the moment, or
+  // if the rays keep it as codes, see Ray::getRef.
+  void setMomentBlock(Moment moment, float *block, int stride);
+  float* getMomentBlock(Moment moment) const { return momentBlock[moment]; }
+  int getMomentStride(Moment moment) const { return momentStride[moment]; }
+
   void dump();
   
 private:
@@ -74,6 +98,10 @@ private:
   int vcp;
   int firstRay;
   int lastRay;
+  QVector<int> azimuthBinStart;
+  QVector<int> azimuthBinRays;
+  float *momentBlock[NumMoments];
+  int momentStride[NumMoments];
 
 };
 
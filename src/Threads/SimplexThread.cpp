@@ -9,6 +9,8 @@
  */
 
 #include <QtGui>
+#include <QtConcurrent>
+#include <QElapsedTimer>
 #include <math.h>
 #include "SimplexThread.h"
 #include "DataObjects/Coefficient.h"
@@ -28,13 +30,10 @@ SimplexThread::SimplexThread(QObject* parent):QObject(parent)
     configData = NULL;
 
     _dataGaps = NULL;
-    _vtdCoeffs = NULL;
 }
 
 SimplexThread::~SimplexThread()
 {
-    delete   _simplexVTD;
-    delete[] _vtdCoeffs;
     delete[] _dataGaps;
 }
 
@@ -58,9 +57,9 @@ bool SimplexThread::findCenter(SimplexList* simplexList)
     //STEP 1: retrieve all the parameters for Simplex algorithm
 
     QDomElement simplexCfg = configData->getConfig("center");
-    QString geometry = configData->getParam(simplexCfg,QString("geometry"));
-    QString velField = configData->getParam(simplexCfg,QString("velocity"));
-    QString closure = configData->getParam(simplexCfg,QString("closure"));
+    _geometry = configData->getParam(simplexCfg,QString("geometry"));
+    _velField = configData->getParam(simplexCfg,QString("velocity"));
+    _closure = configData->getParam(simplexCfg,QString("closure"));
 
     firstLevel= configData->getParam(simplexCfg,QString("bottomlevel")).toFloat();
     lastLevel = configData->getParam(simplexCfg,QString("toplevel")).toFloat();
@@ -76,27 +75,26 @@ bool SimplexThread::findCenter(SimplexList* simplexList)
       return false;
     }
 
-    float boxRowLength = sqrt(numPoints);
-    float boxIncr = boxSize / (sqrt(numPoints) - 1);
+    _numPoints = numPoints;
+    _boxRowLength = sqrt(numPoints);
+    _boxIncr = boxSize / (sqrt(numPoints) - 1);
 
-    float radiusOfInfluence = configData->getParam(simplexCfg,QString("influenceradius")).toFloat();
-    float convergeCriterion = configData->getParam(simplexCfg,QString("convergence")).toFloat();
-    float maxIterations = configData->getParam(simplexCfg,QString("maxiterations")).toFloat();
+    _radiusOfInfluence = configData->getParam(simplexCfg,QString("influenceradius")).toFloat();
+    _convergeCriterion = configData->getParam(simplexCfg,QString("convergence")).toFloat();
+    _maxIterations = configData->getParam(simplexCfg,QString("maxiterations")).toFloat();
     float ringWidth = configData->getParam(simplexCfg,QString("ringwidth")).toFloat();
-    int   maxWave = configData->getParam(simplexCfg,QString("maxwavenumber")).toInt();
+    _maxWave = configData->getParam(simplexCfg,QString("maxwavenumber")).toInt();
 
     // Define the maximum allowable data gaps
 
-    _dataGaps = new float[maxWave+1];
-    for (int i = 0; i <= maxWave; i++) {
+    delete[] _dataGaps;
+    _dataGaps = new float[_maxWave+1];
+    for (int i = 0; i <= _maxWave; i++) {
         _dataGaps[i] = configData->getParam(simplexCfg, QString("maxdatagap"), QString("wavenum"),
 					    QString().setNum(i)).toFloat();
     }
 
-    //SETP 2: initialize a VTD object for whole simplex to use
-
-    _simplexVTD = VTDFactory::createVTD(geometry, closure, maxWave, _dataGaps);
-    _vtdCoeffs  = new Coefficient[20];
+    //SETP 2: each simplex task creates its own VTD object (see simplexSearch)
 
     //STEP 3: perform simplex algorithm
 
@@ -117,164 +115,229 @@ bool SimplexThread::findCenter(SimplexList* simplexList)
     // the ring count should be divided by the ring width
     simplexData->setNumPointsUsed((int)numPoints);
 
-    // Allocate memory for the vertices
-    float** vertex = new float*[3];
-    vertex[0 ]= new float[2];
-    vertex[1] = new float[2];
-    vertex[2] = new float[2];
-    float* VT = new float[3];
-    float* vertexSum = new float[2];
-
     // Loop through the levels and rings,
     // TODO Should this have some reference to grid spacing?
-    // see GriddedData::setAbsoluteReferencePoint
+    // see GriddedData::getAbsoluteRingQuery
     // TODO firstLevel is 1. How come not 0.5?
 
+    QList<SimplexTask> tasks;
     // for (float height = firstLevel; height <= lastLevel; height++) {
     for (float height = firstLevel; height <= lastLevel; height += gridData->getKGridsp()) {
         for (float radius = firstRing; radius <= lastRing; radius++) {
 
-            gridData->setAbsoluteReferencePoint(_latGuess, _lonGuess, height);
-            // Set the corner of the box
-            float CornerI = gridData->getCartesianRefPointI();
-            float CornerJ = gridData->getCartesianRefPointJ();
+            RingQuery guess = gridData->getAbsoluteRingQuery(_latGuess, _lonGuess, height);
 
-            // std::cout << "** ring: "<< radius <<" RefI: " << CornerI << " RefJ: "<< CornerJ << std::endl;
+            SimplexTask task;
+            task.simplex = this;
+            task.height = height;
+            task.radius = radius;
+            // Set the corner of the box
+            task.cornerI = guess.cartesianI;
+            task.cornerJ = guess.cartesianJ;
+            task.refK = guess.cartesianK;
+            task.converged = false;
+            task.ringHits = 0;
+            task.ringMisses = 0;
+            task.ringMissNsecs = 0;
 
-            float RefK = gridData->getCartesianRefPointK();
-            float RefI = CornerI;
-            float RefJ = CornerJ;
+            // std::cout << "** ring: "<< radius <<" RefI: " << task.cornerI << " RefJ: "<< task.cornerJ << std::endl;
 
-            if ((gridData->getRefPointI() < 0) || (gridData->getRefPointJ() < 0) || (gridData->getRefPointK() < 0))  {
+            if (!guess.isInsideGrid())  {
                 emit log(Message(QString("Initial simplex guess is outside CAPPI"),0,this->objectName()));
-                archiveNull(simplexData, radius, height, numPoints);
-                continue;
+                task.simplex = NULL;
             }
+            tasks.append(task);
+        } //ring loop end
+    } //height loop end
 
-            // Initialize mean values
-
-            int meanCount = 0;
-            meanXall = meanYall = meanVTall = 0;
-            meanX = meanY = meanVT = 0;
-            stdDevVertexAll = stdDevVTAll = 0;
-            stdDevVertex = stdDevVT = 0;
-            convergingCenters = 0;
-
-            // Loop through the initial guesses
-	    // std::cout << "** Num of points: " << numPoints << std::endl;
-
-            for (int point = 0; point < numPoints; point++) {
-                if (point < boxRowLength)
-                    RefI = CornerI + float(point) * boxIncr;
-                else
-                    RefI = CornerI + float((point) % int(boxRowLength)) * boxIncr;
-
-                RefJ = CornerJ + float(point / int(boxRowLength)) * boxIncr;
-
-                startX[point] = RefI;
-                startY[point] = RefJ;
-
-                // Initialize vertices
-                float sqr32 = 0.866025;
-                vertex[0][0] = RefI;
-                vertex[0][1] = RefJ + radiusOfInfluence;
-                vertex[1][0] = RefI + sqr32 * radiusOfInfluence;
-                vertex[1][1] = RefJ - 0.5 * radiusOfInfluence;
-                vertex[2][0] = RefI - sqr32 * radiusOfInfluence;
-                vertex[2][1] = RefJ - 0.5 * radiusOfInfluence;
-                vertexSum[0] = 0;
-                vertexSum[1] = 0;
-
-                for (int v = 0; v <= 2; v++) {
-		  //Calculate mean wind at each vertex
-		  VT[v] = _getSymWind(vertex[v][0], vertex[v][1], int(RefK), radius, height, velField);
-                }
+    // The searches for each level and ring are independent of each other
+    QtConcurrent::blockingMap(tasks, &SimplexThread::runSimplexTask);
+
+    // Archive in the same order as the tasks were set up so the results
+    // don't depend on which thread finished first
+    long ringHits = 0, ringMisses = 0;
+    qint64 ringMissNsecs = 0;
+    for (int t = 0; t < tasks.size(); t++) {
+        for (int m = 0; m < tasks[t].messages.size(); m++)
+            emit log(tasks[t].messages[m]);
+        if (tasks[t].converged)
+            archiveCenters(simplexData, tasks[t]);
+        else
+            archiveNull(simplexData, tasks[t].radius, tasks[t].height, numPoints);
+        ringHits += tasks[t].ringHits;
+        ringMisses += tasks[t].ringMisses;
+        ringMissNsecs += tasks[t].ringMissNsecs;
+    }
 
-                // Run the simplex search loop
-                float VTsolution = .0, Xsolution = 0. , Ysolution=0.;
-                _getVertexSum(vertex, vertexSum);
-                _centerIterate(vertex, vertexSum, VT, maxIterations, convergeCriterion, RefK, radius,
-			       height, velField, VTsolution, Xsolution, Ysolution);
-
-                // Done with simplex loop, should have values for the current point
-                if ((VTsolution < 100.) and (VTsolution > 0.)) {
-                    // Add to sum
-                    meanXall  += Xsolution;
-                    meanYall  += Ysolution;
-                    meanVTall += VTsolution;
-                    meanCount++;
-                    // Add to array for storage
-                    endX[point]  = Xsolution;
-                    endY[point]  = Ysolution;
-                    VTind[point] = VTsolution;
-                } else {
-                    endX[point]  = Center::_fillv;
-                    endY[point]  = Center::_fillv;
-                    VTind[point] = Center::_fillv;
-                }
-            } //point loop end
-
-	    // std::cout << "Mean count before: " << meanCount << std::endl;
-
-            if (meanCount == 0) {
-                archiveNull(simplexData, radius, height, numPoints);
-            } else {
-                meanXall = meanXall / float(meanCount);
-                meanYall = meanYall / float(meanCount);
-                meanVTall = meanVTall / float(meanCount);
-                for (int i = 0; i < numPoints; i++) {
-                    if ((endX[i] != -999.) and (endY[i] != -999.) and (VTind[i] != -999.)) {
-                        stdDevVertexAll += ((endX[i] - meanXall)
-					    * (endX[i] - meanXall) + (endY[i] - meanYall)
-					    * (endY[i] - meanYall));
-                        stdDevVTAll += (VTind[i] - meanVTall) * (VTind[i] - meanVTall);
-                    }
-                }
-                stdDevVertexAll = sqrt(stdDevVertexAll/float(meanCount - 1));
-                stdDevVTAll = sqrt(stdDevVTAll/float(meanCount - 1));
-
-                // Now remove centers beyond 1 standard deviation
-                meanCount = 0;
-                for (int i = 0; i < numPoints; i++) {
-                    if ((endX[i] != -999.) and (endY[i] != -999.) and (VTind[i] != -999.)) {
-                        float vertexDist = sqrt((endX[i] - meanXall) * (endX[i] - meanXall)
-						+ (endY[i] - meanYall) * (endY[i] - meanYall));
-                        if (vertexDist < stdDevVertexAll) {
-                            Xconv[meanCount] = endX[i];
-                            Yconv[meanCount] = endY[i];
-                            VTconv[meanCount] = VTind[i];
-                            meanX += endX[i];
-                            meanY += endY[i];
-                            meanVT+= VTind[i];
-                            meanCount++;
-                        }
-                    }
-                }
-		// std::cout << "Mean count after: " << meanCount << std::endl;
-
-                if (meanCount == 0) {
-                    archiveNull(simplexData, radius, height, numPoints);
-                } else {
-                    meanX = meanX / float(meanCount);
-                    meanY = meanY / float(meanCount);
-                    meanVT = meanVT / float(meanCount);
-                    convergingCenters = meanCount;
-                    for (int i = 0; i < convergingCenters - 1; i++) {
-                        stdDevVertex += ((Xconv[i] - meanX) * (Xconv[i] - meanX)+ (Yconv[i] - meanY) * (Yconv[i] - meanY));
-                        stdDevVT += (VTconv[i] - meanVT) * (VTconv[i] - meanVT);
-                    }
-                    stdDevVertex = sqrt(stdDevVertex / float(meanCount - 1));
-                    stdDevVT = sqrt(stdDevVT / float(meanCount - 1));
+    // Report how much the ring cache saved, a hit costs a copy instead of
+    // a read of the grid
+    if (ringHits + ringMisses > 0) {
+        float hitRate = 100. * float(ringHits) / float(ringHits + ringMisses);
+        float savedMsecs = 0;
+        if (ringMisses > 0)
+            savedMsecs = 1.e-6 * float(ringMissNsecs) / float(ringMisses) * float(ringHits);
+        emit log(Message(QString("Simplex ring cache: ")+QString().setNum(ringHits)
+                         +QString(" hits, ")+QString().setNum(ringMisses)
+                         +QString(" misses (")+QString().setNum(hitRate, 'f', 1)
+                         +QString("%), about ")+QString().setNum(savedMsecs, 'f', 1)
+                         +QString(" ms of ring reads saved"),0,this->objectName()));
+    }
+
+    simplexList->append(*simplexData);
+    delete simplexData;
+
+    return true;
+}
+
+void SimplexThread::runSimplexTask(SimplexTask &task)
+{
+    // Tasks with a guess outside the CAPPI have no simplex to run
+    if (task.simplex != NULL)
+        task.simplex->simplexSearch(task);
+}
+
+void SimplexThread::simplexSearch(SimplexTask& task)
+{
+    // Everything the search writes to is owned by the task
+    task.vtd = VTDFactory::createVTD(_geometry, _closure, _maxWave, _dataGaps);
+    task.vtdCoeffs = new Coefficient[20];
+    task.ringData = NULL;
+    task.ringAzimuths = NULL;
+    task.ringCapacity = 0;
+
+    // Allocate memory for the vertices
+    float** vertex = new float*[3];
+    vertex[0 ]= new float[2];
+    vertex[1] = new float[2];
+    vertex[2] = new float[2];
+    float* VT = new float[3];
+    float* vertexSum = new float[2];
+
+    float height = task.height;
+    float radius = task.radius;
+    float CornerI = task.cornerI;
+    float CornerJ = task.cornerJ;
+    float RefK = task.refK;
+    float RefI = CornerI;
+    float RefJ = CornerJ;
+
+    // Initialize mean values
+
+    int meanCount = 0;
+    float meanXall = 0, meanYall = 0, meanVTall = 0;
+    float stdDevVertexAll = 0, stdDevVTAll = 0;
+    float Xconv[25],Yconv[25],VTconv[25];
+    task.meanX = task.meanY = task.meanVT = 0;
+    task.stdDevVertex = task.stdDevVT = 0;
+    task.convergingCenters = 0;
+
+    // Loop through the initial guesses
+    // std::cout << "** Num of points: " << _numPoints << std::endl;
+
+    for (int point = 0; point < _numPoints; point++) {
+        if (point < _boxRowLength)
+            RefI = CornerI + float(point) * _boxIncr;
+        else
+            RefI = CornerI + float((point) % int(_boxRowLength)) * _boxIncr;
+
+        RefJ = CornerJ + float(point / int(_boxRowLength)) * _boxIncr;
+
+        task.startX[point] = RefI;
+        task.startY[point] = RefJ;
+
+        // Initialize vertices
+        float sqr32 = 0.866025;
+        vertex[0][0] = RefI;
+        vertex[0][1] = RefJ + _radiusOfInfluence;
+        vertex[1][0] = RefI + sqr32 * _radiusOfInfluence;
+        vertex[1][1] = RefJ - 0.5 * _radiusOfInfluence;
+        vertex[2][0] = RefI - sqr32 * _radiusOfInfluence;
+        vertex[2][1] = RefJ - 0.5 * _radiusOfInfluence;
+        vertexSum[0] = 0;
+        vertexSum[1] = 0;
+
+        for (int v = 0; v <= 2; v++) {
+            //Calculate mean wind at each vertex
+            VT[v] = _getSymWind(task, vertex[v][0], vertex[v][1], int(RefK), radius, height, _velField);
+        }
 
-                    // All done with this radius and height, archive it
-                    archiveCenters(simplexData, radius, height, numPoints);
+        // Run the simplex search loop
+        float VTsolution = .0, Xsolution = 0. , Ysolution=0.;
+        _getVertexSum(vertex, vertexSum);
+        _centerIterate(task, vertex, vertexSum, VT, _maxIterations, _convergeCriterion, RefK, radius,
+                       height, _velField, VTsolution, Xsolution, Ysolution);
+
+        // Done with simplex loop, should have values for the current point
+        if ((VTsolution < 100.) and (VTsolution > 0.)) {
+            // Add to sum
+            meanXall  += Xsolution;
+            meanYall  += Ysolution;
+            meanVTall += VTsolution;
+            meanCount++;
+            // Add to array for storage
+            task.endX[point]  = Xsolution;
+            task.endY[point]  = Ysolution;
+            task.VTind[point] = VTsolution;
+        } else {
+            task.endX[point]  = Center::_fillv;
+            task.endY[point]  = Center::_fillv;
+            task.VTind[point] = Center::_fillv;
+        }
+    } //point loop end
+
+    // std::cout << "Mean count before: " << meanCount << std::endl;
+
+    if (meanCount != 0) {
+        meanXall = meanXall / float(meanCount);
+        meanYall = meanYall / float(meanCount);
+        meanVTall = meanVTall / float(meanCount);
+        for (int i = 0; i < _numPoints; i++) {
+            if ((task.endX[i] != -999.) and (task.endY[i] != -999.) and (task.VTind[i] != -999.)) {
+                stdDevVertexAll += ((task.endX[i] - meanXall)
+                                    * (task.endX[i] - meanXall) + (task.endY[i] - meanYall)
+                                    * (task.endY[i] - meanYall));
+                stdDevVTAll += (task.VTind[i] - meanVTall) * (task.VTind[i] - meanVTall);
+            }
+        }
+        stdDevVertexAll = sqrt(stdDevVertexAll/float(meanCount - 1));
+        stdDevVTAll = sqrt(stdDevVTAll/float(meanCount - 1));
+
+        // Now remove centers beyond 1 standard deviation
+        meanCount = 0;
+        for (int i = 0; i < _numPoints; i++) {
+            if ((task.endX[i] != -999.) and (task.endY[i] != -999.) and (task.VTind[i] != -999.)) {
+                float vertexDist = sqrt((task.endX[i] - meanXall) * (task.endX[i] - meanXall)
+                                        + (task.endY[i] - meanYall) * (task.endY[i] - meanYall));
+                if (vertexDist < stdDevVertexAll) {
+                    Xconv[meanCount] = task.endX[i];
+                    Yconv[meanCount] = task.endY[i];
+                    VTconv[meanCount] = task.VTind[i];
+                    task.meanX += task.endX[i];
+                    task.meanY += task.endY[i];
+                    task.meanVT+= task.VTind[i];
+                    meanCount++;
                 }
             }
-        } //ring loop end
-    } //height loop end
+        }
+        // std::cout << "Mean count after: " << meanCount << std::endl;
+
+        if (meanCount != 0) {
+            task.meanX = task.meanX / float(meanCount);
+            task.meanY = task.meanY / float(meanCount);
+            task.meanVT = task.meanVT / float(meanCount);
+            task.convergingCenters = meanCount;
+            for (int i = 0; i < task.convergingCenters - 1; i++) {
+                task.stdDevVertex += ((Xconv[i] - task.meanX) * (Xconv[i] - task.meanX)+ (Yconv[i] - task.meanY) * (Yconv[i] - task.meanY));
+                task.stdDevVT += (VTconv[i] - task.meanVT) * (VTconv[i] - task.meanVT);
+            }
+            task.stdDevVertex = sqrt(task.stdDevVertex / float(meanCount - 1));
+            task.stdDevVT = sqrt(task.stdDevVT / float(meanCount - 1));
+
+            // All done with this radius and height, ready to archive
+            task.converged = true;
+        }
+    }
 
-    simplexList->append(*simplexData);
-    delete simplexData;
     // Deallocate memory for the vertices
     delete[] vertex[0];
     delete[] vertex[1];
@@ -283,31 +346,44 @@ bool SimplexThread::findCenter(SimplexList* simplexList)
     delete[] VT;
     delete[] vertexSum;
 
-    return true;
+    delete task.vtd;
+    delete[] task.vtdCoeffs;
+    delete[] task.ringData;
+    delete[] task.ringAzimuths;
+    task.ringCache.clear();
+    task.vtd = NULL;
+    task.vtdCoeffs = NULL;
+    task.ringData = NULL;
+    task.ringAzimuths = NULL;
+    task.ringCapacity = 0;
 }
 
-void SimplexThread::archiveCenters(SimplexData* simplexData, float radius, float height, float numPoints)
+void SimplexThread::archiveCenters(SimplexData* simplexData, const SimplexTask& task)
 {
     // Save the centers to the SimplexData object
+    float height = task.height;
+    float radius = task.radius;
     int level = (int) ( (height - firstLevel) / gridData->getKGridsp() );
     int ring  =int(radius - firstRing);
     simplexData->setHeight(level, height);
     simplexData->setRadius(ring, radius);
-    simplexData->setMeanX(level, ring, meanX);
-    simplexData->setMeanY(level, ring, meanY);
-    simplexData->setMaxVT(level, ring, meanVT);
-    simplexData->setCenterStdDev(level, ring, stdDevVertex);
-    simplexData->setVTUncertainty(level, ring, stdDevVT);
-    simplexData->setNumConvergingCenters(level, ring, (int)convergingCenters);
-    for (int point = 0; point < (int)numPoints; point++) {
+    simplexData->setMeanX(level, ring, task.meanX);
+    simplexData->setMeanY(level, ring, task.meanY);
+    simplexData->setMaxVT(level, ring, task.meanVT);
+    simplexData->setCenterStdDev(level, ring, task.stdDevVertex);
+    simplexData->setVTUncertainty(level, ring, task.stdDevVT);
+    simplexData->setNumConvergingCenters(level, ring, (int)task.convergingCenters);
+    for (int point = 0; point < (int)_numPoints; point++) {
         // We want to use the real radius and height in the center for use
         // later so these should be given in km
         // The level and ring integers are the storage positions
         // these values are used for the indexing - LM 02/6/07
-        Center indCenter(startX[point], startY[point], endX[point], endY[point], VTind[point], height, radius);
+        float startX = task.startX[point];
+        float startY = task.startY[point];
+        Center indCenter(startX, startY, task.endX[point], task.endY[point], task.VTind[point], height, radius);
         simplexData->setCenter(level, ring, point, indCenter);
-        simplexData->setInitialX(level, ring, point, startX[point]);
-        simplexData->setInitialY(level, ring, point, startY[point]);
+        simplexData->setInitialX(level, ring, point, startX);
+        simplexData->setInitialY(level, ring, point, startY);
     }
 }
 
@@ -351,7 +427,7 @@ inline void SimplexThread::_getVertexSum(float** vertex,float* vertexSum)
     }
 }
 
-float SimplexThread::_simplexTest(float**& vertex,float*& VT,float*& vertexSum,
+float SimplexThread::_simplexTest(SimplexTask& task, float**& vertex,float*& VT,float*& vertexSum,
                                  float& radius, float& height, float& RefK,
                                  QString& velField, int& low, double factor)
 {
@@ -364,29 +440,21 @@ float SimplexThread::_simplexTest(float**& vertex,float*& VT,float*& vertexSum,
         vertexTest[i] = vertexSum[i]*factor1 - vertex[low][i]*factor2;
 
     // Get the data
-    gridData->setCartesianReferencePoint(int(vertexTest[0]),int(vertexTest[1]),int(RefK));
-    int numData = gridData->getCylindricalAzimuthLength(radius, height);
-    float* ringData = new float[numData];
-    float* ringAzimuths = new float[numData];
-    gridData->getCylindricalAzimuthData(velField, numData, radius, height, ringData);
-    gridData->getCylindricalAzimuthPosition(numData, radius, height, ringAzimuths);
+    int numData = _getRing(task, vertexTest[0], vertexTest[1], int(RefK), radius, height, velField);
 
     // Call vtd
-    if (_simplexVTD->analyzeRing(vertexTest[0], vertexTest[1], radius, height, numData,
-				 ringData,ringAzimuths, _vtdCoeffs, vtdStdDev)) {
-        if (_vtdCoeffs[0].getParameter() == "VTC0") {
-            VTtest = _vtdCoeffs[0].getValue();
+    if (task.vtd->analyzeRing(vertexTest[0], vertexTest[1], radius, height, numData,
+                              task.ringData, task.ringAzimuths, task.vtdCoeffs, task.vtdStdDev)) {
+        if (task.vtdCoeffs[0].getParameterIndex() == Coefficient::VTC0) {
+            VTtest = task.vtdCoeffs[0].getValue();
         } else {
-            emit log(Message("Error retrieving VTC0 in simplex!"));
+            task.messages.append(Message("Error retrieving VTC0 in simplex!"));
         }
     } else {
         VTtest = -999;
         // emit log(Message("Not enough data in simplex ring"));
     }
 
-    delete[] ringData;
-    delete[] ringAzimuths;
-
     // If its a better point than the worst, replace it
     if (VTtest > VT[low]) {
         VT[low] = VTtest;
@@ -400,21 +468,16 @@ float SimplexThread::_simplexTest(float**& vertex,float*& VT,float*& vertexSum,
 
 }
 
-float SimplexThread::_getSymWind(float vertex_x,float vertex_y,int RefK,float radius,float height,QString velField)
+float SimplexThread::_getSymWind(SimplexTask& task, float vertex_x,float vertex_y,int RefK,float radius,float height,QString velField)
 {
     float VT=-999.0f;
-    gridData->setCartesianReferencePoint(int(vertex_x),int(vertex_y),RefK);
-    int numData = gridData->getCylindricalAzimuthLength(radius, height);    // TODO
-    float* ringData = new float[numData];
-    float* ringAzimuths = new float[numData];
-    gridData->getCylindricalAzimuthData(velField, numData, radius, height, ringData);
     // azimuth data should look like sine wave
-    gridData->getCylindricalAzimuthPosition(numData, radius, height, ringAzimuths);
+    int numData = _getRing(task, vertex_x, vertex_y, RefK, radius, height, velField);
 #if 0
     // TODO debug
     for(int d = 0; d < numData; d++) {
-      std::cout <<  "d: " << d << " val: " << ringData[d]
-		<< " azimuth: " << ringAzimuths[d] << std::endl;
+      std::cout <<  "d: " << d << " val: " << task.ringData[d]
+		<< " azimuth: " << task.ringAzimuths[d] << std::endl;
     }
 #endif
     Coefficient*  vtdCoeffs=new Coefficient[20];
@@ -422,18 +485,73 @@ float SimplexThread::_getSymWind(float vertex_x,float vertex_y,int RefK,float ra
 
     // vtCoeff[0..numCoeffs].value will be set by this call
 
-    if (_simplexVTD->analyzeRing(vertex_x, vertex_y, radius, height, numData, ringData, ringAzimuths, vtdCoeffs, vtdStdDev)) {
-        if (vtdCoeffs[0].getParameter() == "VTC0")
+    if (task.vtd->analyzeRing(vertex_x, vertex_y, radius, height, numData, task.ringData, task.ringAzimuths, vtdCoeffs, vtdStdDev)) {
+        if (vtdCoeffs[0].getParameterIndex() == Coefficient::VTC0)
             VT = vtdCoeffs[0].getValue();
     }
 
-    delete[] ringData;
-    delete[] ringAzimuths;
     delete[] vtdCoeffs;
     return VT;
 }
 
-void SimplexThread::_centerIterate(float** vertex, float* vertexSum, float* VT, int maxIterations, float convergeCriterion,
+int SimplexThread::_getRing(SimplexTask& task, float vertex_x, float vertex_y, int RefK,
+                            float radius, float height, QString& velField)
+{
+    // Fill the task's ring buffers around the vertex. The query carries the
+    // center so the grid's reference point, shared by every task, stays put.
+    RingQuery query = gridData->getCartesianRingQuery(int(vertex_x), int(vertex_y), RefK);
+
+    // The vertex is snapped to a grid cell, so the searches from every
+    // starting point keep coming back to the same rings. Level and radius
+    // are fixed for the task, which leaves the cell as the whole key.
+    // Off-grid vertices give negative cells, so the key is built unsigned.
+    qint64 key = qint64((quint64(quint32(int(query.refI))) << 32)
+                        | quint32(int(query.refJ)));
+    QHash<qint64, RingSamples>::const_iterator cached = task.ringCache.constFind(key);
+    if (cached != task.ringCache.constEnd()) {
+        const RingSamples& samples = cached.value();
+        _reserveRing(task, samples.numData);
+        for (int n = 0; n < samples.numData; n++) {
+            task.ringData[n] = samples.values[n];
+            task.ringAzimuths[n] = samples.azimuths[n];
+        }
+        task.ringHits++;
+        return samples.numData;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    int numData = gridData->getCylindricalAzimuthLength(query, radius, height);
+    _reserveRing(task, numData);
+    gridData->getCylindricalAzimuthRing(query, velField, numData, radius, height,
+                                        task.ringData, task.ringAzimuths);
+    task.ringMisses++;
+    task.ringMissNsecs += timer.nsecsElapsed();
+
+    RingSamples samples;
+    samples.numData = numData;
+    samples.values.resize(numData);
+    samples.azimuths.resize(numData);
+    for (int n = 0; n < numData; n++) {
+        samples.values[n] = task.ringData[n];
+        samples.azimuths[n] = task.ringAzimuths[n];
+    }
+    task.ringCache.insert(key, samples);
+    return numData;
+}
+
+void SimplexThread::_reserveRing(SimplexTask& task, int numData)
+{
+    if ((task.ringData != NULL) && (numData <= task.ringCapacity))
+        return;
+    delete[] task.ringData;
+    delete[] task.ringAzimuths;
+    task.ringCapacity = numData > 0 ? numData : 1;
+    task.ringData = new float[task.ringCapacity];
+    task.ringAzimuths = new float[task.ringCapacity];
+}
+
+void SimplexThread::_centerIterate(SimplexTask& task, float** vertex, float* vertexSum, float* VT, int maxIterations, float convergeCriterion,
                                    float RefK, float radius, float height, QString velField,
                                    float& VTsolution, float& Xsolution, float& Ysolution)
 {
@@ -466,26 +584,26 @@ void SimplexThread::_centerIterate(float** vertex, float* vertexSum, float* VT,
 
         // Check iterations
         if (numIterations > maxIterations) {
-            emit log(Message(QString("Maximum iterations exceeded in Simplex"),0,this->objectName()));
+            task.messages.append(Message(QString("Maximum iterations exceeded in Simplex"),0,this->objectName()));
             break;
         }
 
         numIterations += 2;
         // Reflection
-        float VTtest = _simplexTest(vertex, VT, vertexSum, radius, height,RefK, velField, low, -1.0);
+        float VTtest = _simplexTest(task, vertex, VT, vertexSum, radius, height,RefK, velField, low, -1.0);
         if (VTtest >= VT[high])
             // Better point than highest, so try expansion
-            VTtest = _simplexTest(vertex, VT, vertexSum, radius, height,RefK, velField, low, 2.0);
+            VTtest = _simplexTest(task, vertex, VT, vertexSum, radius, height,RefK, velField, low, 2.0);
         else if (VTtest <= VT[mid]) {
             // Worse point than second highest, so try contraction
             float VTsave = VT[low];
-            VTtest = _simplexTest(vertex, VT, vertexSum, radius, height,RefK, velField, low, 0.5);
+            VTtest = _simplexTest(task, vertex, VT, vertexSum, radius, height,RefK, velField, low, 0.5);
             if (VTtest <= VTsave) {
                 for (int v=0; v<=2; v++) {
                     if (v != high) {
                         for (int i=0; i<=1; i++)
                             vertex[v][i] = vertexSum[i] = 0.5*(vertex[v][i] + vertex[high][i]);
-                        VT[v]=_getSymWind(vertex[v][0],vertex[v][1],int(RefK),radius,height,velField);
+                        VT[v]=_getSymWind(task, vertex[v][0],vertex[v][1],int(RefK),radius,height,velField);
                     }
                 }
                 numIterations += 2;
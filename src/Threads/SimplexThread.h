@@ -13,6 +13,8 @@
 
 #include <QSize>
 #include <QList>
+#include <QHash>
+#include <QVector>
 #include <QObject>
 
 #include "IO/Message.h"
@@ -42,42 +44,80 @@ signals:
     void log(const Message& message);
 
 private:
+    // Ring samples around one grid cell, see SimplexThread::_getRing
+    class RingSamples {
+    public:
+        int numData;
+        QVector<float> values;
+        QVector<float> azimuths;
+    };
+
+    // One (level, ring) simplex search. Each task owns its VTD and scratch
+    // buffers so tasks can run on the thread pool, and its results are
+    // archived in level and ring order once they are all done. Log
+    // messages are held with the results for the same reason.
+    class SimplexTask {
+    public:
+        SimplexThread* simplex;
+        float height;
+        float radius;
+        float cornerI, cornerJ, refK;
+        VTD* vtd;
+        Coefficient* vtdCoeffs;
+        float vtdStdDev;
+        float* ringData;
+        float* ringAzimuths;
+        int ringCapacity;
+        bool converged;
+        float meanX, meanY, meanVT;
+        float stdDevVertex, stdDevVT;
+        float convergingCenters;
+        float endX[25],endY[25],VTind[25];
+        float startX[25], startY[25];
+        // Rings already read for this level and radius, keyed by cell
+        QHash<qint64, RingSamples> ringCache;
+        int ringHits;
+        int ringMisses;
+        qint64 ringMissNsecs;
+        QList<Message> messages;
+    };
+    static void runSimplexTask(SimplexTask &task);
+
     GriddedData   *gridData;
     Configuration *configData;
     float _latGuess;
     float _lonGuess;
     float* _dataGaps;
-    VTD* _simplexVTD;
-    Coefficient* _vtdCoeffs;
-    float* VT;
-    float* vertexSum;
+    QString _geometry;
+    QString _closure;
+    QString _velField;
+    int   _maxWave;
+    float _numPoints;
+    float _boxRowLength;
+    float _boxIncr;
+    float _radiusOfInfluence;
+    float _convergeCriterion;
+    float _maxIterations;
     float firstLevel;
     float lastLevel;
     float firstRing;
     float lastRing;
-    float vtdStdDev;
-    float meanXall, meanYall, meanVTall;
-    float meanX, meanY, meanVT;
-    float stdDevVertexAll, stdDevVTAll;
-    float stdDevVertex, stdDevVT;
-    float convergingCenters;
-    float endX[25],endY[25],VTind[25];
-    float Xconv[25],Yconv[25],VTconv[25];
-    float startX[25], startY[25];
-
 
-    void archiveCenters(SimplexData* simplexData,float radius,float height,float numPoints);
+    void simplexSearch(SimplexTask& task);
+    void archiveCenters(SimplexData* simplexData, const SimplexTask& task);
     void archiveNull(SimplexData* simplexData,float& radius,float& height,float& numPoints);
     inline void _getVertexSum(float** vertex,float* vertexSum);
-    float _simplexTest(float**& vertex, float*& VT, float*& vertexSum,
+    float _simplexTest(SimplexTask& task, float**& vertex, float*& VT, float*& vertexSum,
                       float& radius, float& height, float& RefK,
                       QString& velField, int& high,double factor);
 
     // Choosecenter variables
     float velNull;
-    float _getSymWind(float vertex_x,float vertex_y,int RefK,float radius,float height,QString velField);
-    void  _centerIterate(float** vertex,float* vertexSum, float* VT,int maxIterations,float convergeCriterion,
+    float _getSymWind(SimplexTask& task, float vertex_x,float vertex_y,int RefK,float radius,float height,QString velField);
+    void  _centerIterate(SimplexTask& task, float** vertex,float* vertexSum, float* VT,int maxIterations,float convergeCriterion,
                           float RefK,float radius,float height,QString velField,float& VTsolution,float& Xsolution,float& Ysolution);
+    int   _getRing(SimplexTask& task, float vertex_x, float vertex_y, int RefK, float radius, float height, QString& velField);
+    void  _reserveRing(SimplexTask& task, int numData);
 };
 
 #endif
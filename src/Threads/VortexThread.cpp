@@ -9,7 +9,9 @@
  */
 
 #include <QtGui>
+#include <QtConcurrent>
 #include <math.h>
+#include <random>
 #include "VortexThread.h"
 #include "DataObjects/Coefficient.h"
 #include "DataObjects/Center.h"
@@ -96,39 +98,47 @@ void VortexThread::run()
     vortexData->setAveRMW(rmw);
     // RMW is the average rmw taken over all levels of the vortexData
 
-    // Create a {GB|G}VTD object to process the rings
+    // Each level creates its own {GB|G}VTD object, see analyzeLevel
 
     hvvpResult = 0.0;
+    hvvpFound = false;
 
     if (closure.contains(QString("hvvp"), Qt::CaseInsensitive)) {
-      if ( ! calcHVVP(true))
+      hvvpFound = calcHVVP(true);
+      if ( ! hvvpFound)
 	emit log(Message(QString(),5,this->objectName(),Yellow,QString("Could Not Retrieve HVVP Wind")));
     }
     else {
       emit log(Message(QString(),5,this->objectName()));
     }
 
-    vtd = VTDFactory::createVTD(geometry, closure, maxWave, dataGaps,
-				hvvpResult);
-    Coefficient* vtdCoeffs = new Coefficient[20];
-
-    // Placeholders for centers
-
-    float xCenter = -999;
-    float yCenter = -999;
-
     // TODO 7.0?
 
     // int loopPercent = int(7.0 / float(gridData->getKdim()));
     // int endPercent = 7 - int(gridData->getKdim() * loopPercent);
-    int storageIndex = -1;
 
     float kGridSpacing = gridData->getKGridsp();
 
     // How do I get simplexData->getNumLevels() from here?
     int maxIndex = (int) floor( (lastLevel - firstLevel) / kGridSpacing + 1.5);
 
-    for(storageIndex = 0; storageIndex < maxIndex; storageIndex++) {
+    // compute crossbeam wind to correct GBVTD result. The range to the
+    // vortex is taken at the gradient level, so it is the same for every
+    // level and only needs computing once per volume.
+
+    int gradientIndex = heightToIndex(gradientHeight);
+    QDomElement radar = configData->getConfig("radar");
+    float radarLat = configData->getParam(radar,"lat").toFloat();
+    float radarLon = configData->getParam(radar,"lon").toFloat();
+    float vortexLat = vortexData->getLat(gradientIndex);
+    float vortexLon = vortexData->getLon(gradientIndex);
+
+    float* distance = gridData->getCartesianPoint(&radarLat, &radarLon, &vortexLat, &vortexLon);
+    float rt = sqrt(distance[0]*distance[0]+distance[1]*distance[1]);
+    delete [] distance;
+
+    QList<LevelTask> tasks;
+    for(int storageIndex = 0; storageIndex < maxIndex; storageIndex++) {
 
         float referenceLat = vortexData->getLat(storageIndex);
         float referenceLon = vortexData->getLon(storageIndex);
@@ -144,77 +154,36 @@ void VortexThread::run()
 	if ( (referenceLat == -999) || (referenceLon == -999) )
 	  continue;
 
-        gridData->setAbsoluteReferencePoint(referenceLat, referenceLon, height);
-        if ((gridData->getRefPointI() < 0) || (gridData->getRefPointJ() < 0) ||(gridData->getRefPointK() < 0)) {
+        RingQuery center = gridData->getAbsoluteRingQuery(referenceLat, referenceLon, height);
+        if (!center.isInsideGrid()) {
             emit log(Message(QString("Simplex center is outside CAPPI"), 0, this->objectName(), Yellow));
             continue;
         }
 
-        // compute crossbeam wind to correct GBVTD result
-
-        int gradientIndex = heightToIndex(gradientHeight);
-        QDomElement radar = configData->getConfig("radar");
-        float radarLat = configData->getParam(radar,"lat").toFloat();
-        float radarLon = configData->getParam(radar,"lon").toFloat();
-        float vortexLat = vortexData->getLat(gradientIndex);
-        float vortexLon = vortexData->getLon(gradientIndex);
-
-        float* distance = gridData->getCartesianPoint(&radarLat, &radarLon, &vortexLat, &vortexLon);
-        float rt = sqrt(distance[0]*distance[0]+distance[1]*distance[1]);
-        float cca = atan2(distance[0], distance[1])*180/acos(-1);
-        delete [] distance;
-
-        Hvvp *hvvp = new Hvvp;
-        hvvp->setConfig(configData);
-        hvvp->setRadarData(radarVolume, rt, cca, vortexData->getAveRMW());
-
-	float Vm = 0.0;
-
-        // should we be incrementing radius using ringwidth? -LM
-        for (float radius = firstRing; radius <= lastRing; radius++) {
-            // Get the cartesian points
-            xCenter = gridData->getCartesianRefPointI();
-            yCenter = gridData->getCartesianRefPointJ();
-
-            // Get the data
-            int numData = gridData->getCylindricalAzimuthLength(radius, height);
-            float* ringData = new float[numData];
-            float* ringAzimuths = new float[numData];
-            gridData->getCylindricalAzimuthData(velField, numData, radius, height, ringData);
-            gridData->getCylindricalAzimuthPosition(numData, radius, height, ringAzimuths);
-
-            // Call gbvtd
-            if (vtd->analyzeRing(xCenter, yCenter, radius, height, numData, ringData,
-                                 ringAzimuths, vtdCoeffs, vtdStdDev)) {
-                if (vtdCoeffs[0].getParameter() == "VTC0") {
-                    // VT[v] = vtdCoeffs[0].getValue();
-                    if(vtdCoeffs[0].getValue() != -999.f){
-                        vtdCoeffs[0].setValue( vtdCoeffs[0].getValue()-Vm*radius/rt );
-                    }
-                } else {
-                    emit log(Message(QString("Error retrieving VTC0 in vortex!"),0,this->objectName(), Yellow));
-                }
-            } else {
-                QString err("Insufficient data for VTD winds: radius ");
-                QString loc;
-                err.append(loc.setNum(radius));
-                err.append(", height ");
-                err.append(loc.setNum(height));
-                emit log(Message(err));
-            }
-
-            delete[] ringData;
-            delete[] ringAzimuths;
+        LevelTask task;
+        task.vortex = this;
+        task.storageIndex = storageIndex;
+        task.height = height;
+        task.center = center;
+        task.rt = rt;
+        task.maxValidRadius = -999;
+        tasks.append(task);
+    }
 
-            // All done with this radius and height, archive it
-            archiveWinds(radius, storageIndex, maxCoeffs, vtdCoeffs);
-        }
+    // Levels are independent until the pressure deficit, and each one only
+    // writes its own slice of vortexData. The slices have to exist before
+    // the levels start.
+    vortexData->allocateCoefficients();
+    QtConcurrent::blockingMap(tasks, &VortexThread::runLevelTask);
+
+    for (int t = 0; t < tasks.size(); t++) {
+        for (int m = 0; m < tasks[t].messages.size(); m++)
+            emit log(tasks[t].messages[m]);
+        if (tasks[t].maxValidRadius > vortexData->getMaxValidRadius())
+            vortexData->setMaxValidRadius(tasks[t].maxValidRadius);
     }
     emit log(Message(QString(),15,this->objectName()));
 
-    // Clean up
-    delete vtd;
-
     // Integrate the winds to get the pressure deficit at the 2nd level (presumably 2km)
     // Gradient height is in km
 
@@ -234,14 +203,75 @@ void VortexThread::run()
     // Get the estimated surface wind
     getMaxSfcWind(vortexData);
 
-    delete [] vtdCoeffs;
     delete [] pressureDeficit;
 }
 
-void VortexThread::archiveWinds(float radius, int hIndex, int maxCoeffs, Coefficient* vtdCoeffs)
+void VortexThread::runLevelTask(LevelTask& task)
+{
+    task.vortex->analyzeLevel(task);
+}
+
+void VortexThread::analyzeLevel(LevelTask& task)
+{
+    // Run the VTD rings for one level. The VTD object and buffers belong to
+    // the task, and vortexData is only written at this level's index.
+    int maxCoeffs = maxWave * 2 + 3;
+    float height = task.height;
+
+    VTD* levelVtd = VTDFactory::createVTD(geometry, closure, maxWave, dataGaps,
+                                          hvvpResult);
+    Coefficient* vtdCoeffs = new Coefficient[20];
+    float levelStdDev;
+
+    float Vm = 0.0;
+
+    // should we be incrementing radius using ringwidth? -LM
+    for (float radius = firstRing; radius <= lastRing; radius++) {
+        // Get the cartesian points
+        float xCenter = task.center.cartesianI;
+        float yCenter = task.center.cartesianJ;
+
+        // Get the data
+        int numData = gridData->getCylindricalAzimuthLength(task.center, radius, height);
+        float* ringData = new float[numData];
+        float* ringAzimuths = new float[numData];
+        gridData->getCylindricalAzimuthRing(task.center, velField, numData, radius, height, ringData, ringAzimuths);
+
+        // Call gbvtd
+        if (levelVtd->analyzeRing(xCenter, yCenter, radius, height, numData, ringData,
+                                  ringAzimuths, vtdCoeffs, levelStdDev)) {
+            if (vtdCoeffs[0].getParameterIndex() == Coefficient::VTC0) {
+                // VT[v] = vtdCoeffs[0].getValue();
+                if(vtdCoeffs[0].getValue() != -999.f){
+                    vtdCoeffs[0].setValue( vtdCoeffs[0].getValue()-Vm*radius/task.rt );
+                }
+            } else {
+                task.messages.append(Message(QString("Error retrieving VTC0 in vortex!"),0,this->objectName(), Yellow));
+            }
+        } else {
+            QString err("Insufficient data for VTD winds: radius ");
+            QString loc;
+            err.append(loc.setNum(radius));
+            err.append(", height ");
+            err.append(loc.setNum(height));
+            task.messages.append(Message(err));
+        }
+
+        delete[] ringData;
+        delete[] ringAzimuths;
+
+        // All done with this radius and height, archive it
+        archiveWinds(task, radius, maxCoeffs, vtdCoeffs);
+    }
+
+    delete[] vtdCoeffs;
+    delete levelVtd;
+}
+
+void VortexThread::archiveWinds(LevelTask& task, float radius, int maxCoeffs, Coefficient* vtdCoeffs)
 {
     // Save the centers to the VortexData object
-    int level = hIndex;
+    int level = task.storageIndex;
     int ring = int(radius - firstRing);
 
     for (int coeff = 0; coeff < maxCoeffs; coeff++) {
@@ -254,9 +284,10 @@ void VortexThread::archiveWinds(float radius, int hIndex, int maxCoeffs, Coeffic
 	// 	  << ", param: " << current.getParameter().toLatin1().data()
 	// 	  << std::endl;
 
+	// The levels run concurrently, so the max is merged by run()
 	if((current.getValue() != -999) && (current.getValue() != 0)) {
-            if(current.getRadius() > vortexData->getMaxValidRadius())
-                vortexData->setMaxValidRadius(current.getRadius());
+            if(current.getRadius() > task.maxValidRadius)
+                task.maxValidRadius = current.getRadius();
         }
     }
 }
@@ -292,9 +323,9 @@ void VortexThread::getPressureDeficit(VortexData* data, float* pDeficit,const fl
     float f = 2 * 7.29e-5 * sin(data->getLat(heightIndex) * 3.141592653589793238462643 / 180.);
 
     for (float radius = firstRing; radius <= lastRing; radius++) {
-      // if (!(data->getCoefficient(height, radius, QString("VTC0")) == Coefficient())) {
-      if ( (data->getCoefficient(height, radius, QString("VTC0"))).isValid()) {
-            float meanVT = data->getCoefficient(height, radius, QString("VTC0")).getValue();
+      // if (!(data->getCoefficient(height, radius, Coefficient::VTC0) == Coefficient())) {
+      if ( (data->getCoefficient(height, radius, Coefficient::VTC0)).isValid()) {
+            float meanVT = data->getCoefficient(height, radius, Coefficient::VTC0).getValue();
             if (meanVT != 0) {
                 dpdr[(int)radius] = ((f * meanVT) + (meanVT * meanVT)/(radius * deltar)) * rhoBar[ (int) height - 1];
             }
@@ -430,7 +461,6 @@ void VortexThread::calcPressureUncertainty(float setLimit, QString nameAddition)
     // Acquire vortexData center uncertainty for the second level we examined
     int goodLevel = heightToIndex(gradientHeight);
     float height = vortexData->getHeight(goodLevel);
-    int   maxCoeffs = maxWave * 2 + 3;
     float centerStd = vortexData->getCenterStdDev(goodLevel);
 
     //Message::toScreen("VortexThread: CalcPressureUncertainty: Uncertainty of center from vortexData is "+QString().setNum(centerStd));
@@ -442,16 +472,18 @@ void VortexThread::calcPressureUncertainty(float setLimit, QString nameAddition)
     if(nameAddition!=QString())
         nameAddition = nameAddition+QString().setNum(centerStd);
 
-    // Now move this amount of space in each cardinal direction to get 4 additional pressure estimates
-    int numErrorPoints = 4;
+    // Perturb the center by this amount to get numErrorPoints additional
+    // pressure estimates. The default 4 are the cardinal directions, a
+    // larger ensemble draws the offsets from the center spread instead.
     float angle = 2 * acos(-1) / numErrorPoints;
+    std::mt19937 perturbationDraws(numErrorPoints);
+    std::normal_distribution<float> perturbationSpread(0., centerStd / sqrt(2.));
 
-    // Create a {GB|G}VTD object to process the rings
-
-    hvvpResult = 0.0;
+    // HVVP depends on the same center and RMW used by run(), so its wind is
+    // reused rather than recomputed
 
     if(closure.contains(QString("hvvp"), Qt::CaseInsensitive)) {
-      if( ! calcHVVP(false)) {
+      if( ! hvvpFound) {
 	emit log(Message(QString(), 0, this->objectName(), Yellow,
 			 QString("Could Not Retrieve HVVP Wind")));
         }
@@ -459,113 +491,92 @@ void VortexThread::calcPressureUncertainty(float setLimit, QString nameAddition)
 	emit log(Message(QString(), 0, this->objectName(), Green));
     }
 
-    vtd = VTDFactory::createVTD(geometry, closure, maxWave, dataGaps,
-				hvvpResult);
-
-    Coefficient* vtdCoeffs = new Coefficient[20];
-    VortexList errorVertices;
+    // The perturbed centers snap to grid cells, so members that land in the
+    // same cell share one analysis
     float refLat = vortexData->getLat(goodLevel);
     float refLon = vortexData->getLon(goodLevel);
-    float sqDeficitSum = 0;
-
+    QList<PerturbationTask> tasks;
+    QVector<int> memberTask(numErrorPoints);
     for(int p = 0; p < numErrorPoints; p++) {
-        VortexData* errorVertex = new VortexData(1, vortexData->getNumRadii(), vortexData->getNumWaveNum());
-        errorVertex->setTime(vortexData->getTime().addDays(p).addYears(2));
-        errorVertex->setHeight(0, vortexData->getHeight(goodLevel));
-        // Set the reference point
-        float* newLatLon = gridData->getAdjustedLatLon(refLat, refLon,
-						       centerStd * cos(p * angle),
-						       centerStd * sin(p * angle));
-        gridData->setAbsoluteReferencePoint(newLatLon[0], newLatLon[1], height);
+        float changeInX, changeInY;
+        if (numErrorPoints == 4) {
+            changeInX = centerStd * cos(p * angle);
+            changeInY = centerStd * sin(p * angle);
+        } else {
+            changeInX = perturbationSpread(perturbationDraws);
+            changeInY = perturbationSpread(perturbationDraws);
+        }
+        float* newLatLon = gridData->getAdjustedLatLon(refLat, refLon, changeInX, changeInY);
+        RingQuery center = gridData->getAbsoluteRingQuery(newLatLon[0], newLatLon[1], height);
         delete  [] newLatLon;
 
-        if ((gridData->getRefPointI() < 0) || (gridData->getRefPointJ() < 0) || (gridData->getRefPointK() < 0)) {
+        memberTask[p] = -1;
+        if (!center.isInsideGrid()) {
             // Out of bounds problem
             emit log(Message(QString("Error Vertex is outside CAPPI"), 0, this->objectName()));
             continue;
         }
 
-        for (float radius = firstRing; radius <= lastRing; radius++) {
-            // Get the cartesian points
-            float xCenter = gridData->getCartesianRefPointI();
-            float yCenter = gridData->getCartesianRefPointJ();
-
-            // Get the data
-            int numData = gridData->getCylindricalAzimuthLength(radius, height);
-            float* ringData = new float[numData];
-            float* ringAzimuths = new float[numData];
-
-            gridData->getCylindricalAzimuthData(velField, numData, radius, height, ringData);
-            gridData->getCylindricalAzimuthPosition(numData, radius, height, ringAzimuths);
+        for (int t = 0; t < tasks.size(); t++) {
+            if ((tasks[t].center.refI == center.refI) && (tasks[t].center.refJ == center.refJ))
+                memberTask[p] = t;
+        }
+        if (memberTask[p] >= 0)
+            continue;
 
-            // Call gbvtd
-            if (vtd->analyzeRing(xCenter, yCenter, radius, height, numData, ringData, ringAzimuths, vtdCoeffs, vtdStdDev)) {
-                if (vtdCoeffs[0].getParameter() != "VTC0") {
-                    emit log(Message(QString("CalcPressureUncertainty:Error retrieving VTC0 in vortex!"), 0, this->objectName()));
-                }
+        PerturbationTask task;
+        task.vortex = this;
+        task.center = center;
+        task.height = height;
+        task.level = goodLevel;
+        task.errorVertex = new VortexData(1, vortexData->getNumRadii(), vortexData->getNumWaveNum());
+        task.errorVertex->setTime(vortexData->getTime().addDays(p).addYears(2));
+        task.errorVertex->setHeight(0, vortexData->getHeight(goodLevel));
+        task.deficit = 0;
+        task.missingVTC0 = false;
+        memberTask[p] = tasks.size();
+        tasks.append(task);
+    }
 
-                // All done with this radius and height, archive it
-                archiveWinds(*errorVertex, radius, goodLevel, maxCoeffs, vtdCoeffs);
+    // The members are independent of each other
+    QtConcurrent::blockingMap(tasks, &VortexThread::runPerturbationTask);
 
-                // Clean up
-                delete[] ringData;
-                delete[] ringAzimuths;
-            }
-        }
-        // Now calculate central pressure for each of these
-        float* errorPressureDeficit = new float[(int)lastRing + 1];
-        getPressureDeficit(errorVertex,errorPressureDeficit, height);
-        errorVertex->setPressureDeficit(fabs(*errorPressureDeficit));
+    // Collect in member order so the result doesn't depend on scheduling
+    VortexList errorVertices;
+    float sqDeficitSum = 0;
+    int numValidMembers = 0;
+    for(int p = 0; p < numErrorPoints; p++) {
+        if (memberTask[p] < 0)
+            continue;
+        const PerturbationTask& task = tasks[memberTask[p]];
+        if (task.missingVTC0)
+            emit log(Message(QString("CalcPressureUncertainty:Error retrieving VTC0 in vortex!"), 0, this->objectName()));
 
         // Sum for Deficit Uncertainty
-        sqDeficitSum += (errorVertex->getPressureDeficit() - vortexData->getPressureDeficit())
-	  * (errorVertex->getPressureDeficit() - vortexData->getPressureDeficit());
-
-        // Add in uncertainty from multiple pressure measurements
-        if(_presObs.size() < 1){
-            // No outside data available use the 1013 bit.
-            errorVertex->setPressure(1013 - (errorPressureDeficit[(int)lastRing] - errorPressureDeficit[0]));
-            errorVertex->setPressureDeficit(errorPressureDeficit[(int)lastRing] - errorPressureDeficit[0]);
-        }
-        else {
-            for(int j = 0; j < _presObs.size(); j++) {
-
-                float obPressure = _presObs[j].getPressure();
-                float vortexLat = errorVertex->getLat(0);
-                float vortexLon = errorVertex->getLon(0);
-                float obLat = _presObs[j].getLat();
-                float obLon = _presObs[j].getLon();
-                float* relDist = gridData->getCartesianPoint(&vortexLat, &vortexLon, &obLat, &obLon);
-                float obRadius = sqrt(relDist[0] * relDist[0] + relDist[1] * relDist[1]);
-                delete [] relDist;
-                float pPrimeOuter;
-                if (obRadius >= lastRing) {
-                    pPrimeOuter = errorPressureDeficit[(int)lastRing];
-                } else {
-                    pPrimeOuter = errorPressureDeficit[(int)obRadius];
-                }
-                //Message::toScreen("Calculating uncertainty calib "+QString().setNum(j)+" = "+QString().setNum(obPressure)+" @ "+QString().setNum(obRadius));
-                errorVertex->setPressure(obPressure - (pPrimeOuter - errorPressureDeficit[0]));
-                errorVertex->setPressureDeficit(errorPressureDeficit[(int)lastRing] - errorPressureDeficit[0]);
-            }
-        }
-        errorVertices.append(*errorVertex);
-        delete [] errorPressureDeficit;
-        delete errorVertex;
+        sqDeficitSum += (task.deficit - vortexData->getPressureDeficit())
+	  * (task.deficit - vortexData->getPressureDeficit());
+        numValidMembers++;
+        errorVertices.append(*task.errorVertex);
     }
+    for (int t = 0; t < tasks.size(); t++)
+        delete tasks[t].errorVertex;
 
-    delete[] vtdCoeffs;
-    delete vtd;
-
-    // Standard deviation from the center point
+    // Standard deviation from the center point. Only the members that
+    // landed in the grid count toward the spread, with fewer than two
+    // there is no spread, so no deficit error bar is drawn and the
+    // pressure falls back to the clamps below.
     float sqPressureSum = 0;
-    for(int i = 1; i < errorVertices.count();i++) {
+    for(int i = 0; i < errorVertices.count();i++) {
         float prsDelta=errorVertices.at(i).getPressure() - vortexData->getPressure();
         sqPressureSum += pow(prsDelta, 2);
     }
-    float pressureUncertainty = sqrt(sqPressureSum / (errorVertices.count() - 2));
-    float deficitUncertainty = sqrt(sqDeficitSum / (numErrorPoints - 1));
-    if((numEstimates <= 1)&&(pressureUncertainty < 2.5)) {
+    float pressureUncertainty = 0;
+    float deficitUncertainty = 0;
+    if (numValidMembers > 1) {
+        pressureUncertainty = sqrt(sqPressureSum / (numValidMembers - 1));
+        deficitUncertainty = sqrt(sqDeficitSum / (numValidMembers - 1));
+    }
+    if(((numEstimates <= 1)||(numValidMembers < 2))&&(pressureUncertainty < 2.5)) {
         pressureUncertainty = 2.5;
     }
     if(numEstimates == 0)
@@ -592,6 +603,88 @@ void VortexThread::calcPressureUncertainty(float setLimit, QString nameAddition)
     vortexData->setAveRMWUncertainty(aveRMWUncertainty / (1.0 * goodrmw));
 }
 
+void VortexThread::runPerturbationTask(PerturbationTask& task)
+{
+    task.vortex->analyzePerturbation(task);
+}
+
+void VortexThread::analyzePerturbation(PerturbationTask& task)
+{
+    // Redo the VTD rings and the pressure for one perturbed center. Only
+    // the task is written to, so members can run on the thread pool.
+    int   maxCoeffs = maxWave * 2 + 3;
+    float height = task.height;
+    VortexData* errorVertex = task.errorVertex;
+
+    VTD* memberVtd = VTDFactory::createVTD(geometry, closure, maxWave, dataGaps,
+                                           hvvpResult);
+    Coefficient* vtdCoeffs = new Coefficient[20];
+    float memberStdDev;
+
+    for (float radius = firstRing; radius <= lastRing; radius++) {
+        // Get the cartesian points
+        float xCenter = task.center.cartesianI;
+        float yCenter = task.center.cartesianJ;
+
+        // Get the data
+        int numData = gridData->getCylindricalAzimuthLength(task.center, radius, height);
+        float* ringData = new float[numData];
+        float* ringAzimuths = new float[numData];
+
+        gridData->getCylindricalAzimuthRing(task.center, velField, numData, radius, height, ringData, ringAzimuths);
+
+        // Call gbvtd
+        if (memberVtd->analyzeRing(xCenter, yCenter, radius, height, numData, ringData, ringAzimuths, vtdCoeffs, memberStdDev)) {
+            if (vtdCoeffs[0].getParameterIndex() != Coefficient::VTC0)
+                task.missingVTC0 = true;
+
+            // All done with this radius and height, archive it
+            archiveWinds(*errorVertex, radius, task.level, maxCoeffs, vtdCoeffs);
+        }
+
+        // Clean up
+        delete[] ringData;
+        delete[] ringAzimuths;
+    }
+    delete[] vtdCoeffs;
+    delete memberVtd;
+
+    // Now calculate central pressure for this center
+    float* errorPressureDeficit = new float[(int)lastRing + 1];
+    getPressureDeficit(errorVertex,errorPressureDeficit, height);
+    errorVertex->setPressureDeficit(fabs(*errorPressureDeficit));
+    task.deficit = errorVertex->getPressureDeficit();
+
+    // Add in uncertainty from multiple pressure measurements
+    if(_presObs.size() < 1){
+        // No outside data available use the 1013 bit.
+        errorVertex->setPressure(1013 - (errorPressureDeficit[(int)lastRing] - errorPressureDeficit[0]));
+        errorVertex->setPressureDeficit(errorPressureDeficit[(int)lastRing] - errorPressureDeficit[0]);
+    }
+    else {
+        for(int j = 0; j < _presObs.size(); j++) {
+
+            float obPressure = _presObs[j].getPressure();
+            float vortexLat = errorVertex->getLat(0);
+            float vortexLon = errorVertex->getLon(0);
+            float obLat = _presObs[j].getLat();
+            float obLon = _presObs[j].getLon();
+            float* relDist = gridData->getCartesianPoint(&vortexLat, &vortexLon, &obLat, &obLon);
+            float obRadius = sqrt(relDist[0] * relDist[0] + relDist[1] * relDist[1]);
+            delete [] relDist;
+            float pPrimeOuter;
+            if (obRadius >= lastRing) {
+                pPrimeOuter = errorPressureDeficit[(int)lastRing];
+            } else {
+                pPrimeOuter = errorPressureDeficit[(int)obRadius];
+            }
+            errorVertex->setPressure(obPressure - (pPrimeOuter - errorPressureDeficit[0]));
+            errorVertex->setPressureDeficit(errorPressureDeficit[(int)lastRing] - errorPressureDeficit[0]);
+        }
+    }
+    delete [] errorPressureDeficit;
+}
+
 int VortexThread::heightToIndex(const float height)
 {
   return  (int) ( (height - firstLevel) / gridData->getKGridsp() );
@@ -651,7 +744,23 @@ void VortexThread::readInConfig()
       gradientHeight = gradientConfig.toFloat();
     if(gradientHeight < firstLevel) {
       gradientHeight = firstLevel;
-      std::cout << "Warning: VortexThread gradientHeight adjusted to " << firstLevel << std::endl;
+      emit log(Message(QString("Warning: VortexThread gradientHeight adjusted to ")
+                       + QString().setNum(firstLevel), 0, this->objectName()));
+    }
+    // Number of perturbed centers for the pressure uncertainty
+    numErrorPoints = 4;
+    QString errorPointsConfig = configData->getParam(pressureConfig, "uncertaintycenters");
+    if(errorPointsConfig != "")
+      numErrorPoints = errorPointsConfig.toInt();
+    if(numErrorPoints < 4) {
+      numErrorPoints = 4;
+      emit log(Message(QString("Warning: VortexThread uncertaintycenters adjusted to ")
+                       + QString().setNum(numErrorPoints), 0, this->objectName()));
+    }
+    if(numErrorPoints > 64) {
+      numErrorPoints = 64;
+      emit log(Message(QString("Warning: VortexThread uncertaintycenters adjusted to ")
+                       + QString().setNum(numErrorPoints), 0, this->objectName()));
     }
     envPressure = -999;
 }
@@ -740,8 +849,8 @@ void VortexThread::getMaxSfcWind(VortexData* data)
 
 	// Set the reference point
 
-        gridData->setAbsoluteReferencePoint(referenceLat, referenceLon, height);
-        if ((gridData->getRefPointI() < 0) || (gridData->getRefPointJ() < 0) || (gridData->getRefPointK() < 0)) {
+        RingQuery center = gridData->getAbsoluteRingQuery(referenceLat, referenceLon, height);
+        if (!center.isInsideGrid()) {
             emit log(Message(QString("Simplex center is outside CAPPI"),0,this->objectName(),Yellow));
             continue;
         }
@@ -750,8 +859,8 @@ void VortexThread::getMaxSfcWind(VortexData* data)
 
 	  if(fabs(radius - vortexData->getAveRMW()) > 20) continue;
             // Get the cartesian points
-            xCenter = gridData->getCartesianRefPointI();
-            yCenter = gridData->getCartesianRefPointJ();
+            xCenter = center.cartesianI;
+            yCenter = center.cartesianJ;
 
 	    // Get thetaT
 	    float thetaT = atan2(yCenter, xCenter);
@@ -759,14 +868,14 @@ void VortexThread::getMaxSfcWind(VortexData* data)
 	    // float centerDistance = sqrt(xCenter * xCenter + yCenter * yCenter);
 
             // Get the winds
-	    // if (!(data->getCoefficient(height, radius, QString("VTC0")) == Coefficient())) {
-	    if ( (data->getCoefficient(height, radius, QString("VTC0"))).isValid()) {
-
-	      float vtc0 = data->getCoefficient(height, radius, QString("VTC0")).getValue();
-	      float vrc0 = data->getCoefficient(height, radius, QString("VRC0")).getValue();
-	      float vmc0 = data->getCoefficient(height, radius, QString("VMC0")).getValue();
-	      float vtc1 = data->getCoefficient(height, radius, QString("VTC1")).getValue();
-	      float vts1 = data->getCoefficient(height, radius, QString("VTS1")).getValue();
+	    // if (!(data->getCoefficient(height, radius, Coefficient::VTC0) == Coefficient())) {
+	    if ( (data->getCoefficient(height, radius, Coefficient::VTC0)).isValid()) {
+
+	      float vtc0 = data->getCoefficient(height, radius, Coefficient::VTC0).getValue();
+	      float vrc0 = data->getCoefficient(height, radius, Coefficient::VRC0).getValue();
+	      float vmc0 = data->getCoefficient(height, radius, Coefficient::VMC0).getValue();
+	      float vtc1 = data->getCoefficient(height, radius, Coefficient::VTC1).getValue();
+	      float vts1 = data->getCoefficient(height, radius, Coefficient::VTS1).getValue();
 	      double PI = acos(-1.0);
 
 	      for (int i = 0; i < 360; i++) {
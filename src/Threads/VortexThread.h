@@ -47,6 +47,36 @@ class VortexThread : public QObject
      void log(const Message& message);
  
  private:
+
+     // One perturbed center of the pressure uncertainty ensemble. Each task
+     // owns its VortexData so the members can run on the thread pool.
+     class PerturbationTask {
+     public:
+         VortexThread* vortex;
+         RingQuery center;
+         float height;
+         int level;
+         VortexData* errorVertex;
+         float deficit;
+         bool missingVTC0;
+     };
+     static void runPerturbationTask(PerturbationTask& task);
+
+     // The VTD rings for one analysis level. Log messages are held until
+     // all levels finish so they come out in level order.
+     class LevelTask {
+     public:
+         VortexThread* vortex;
+         int storageIndex;
+         float height;
+         RingQuery center;
+         float rt;
+         float maxValidRadius;
+         QList<Message> messages;
+     };
+     static void runLevelTask(LevelTask& task);
+     void analyzeLevel(LevelTask& task);
+     void analyzePerturbation(PerturbationTask& task);
      
      GriddedData *gridData;
      RadarData *radarVolume;
@@ -55,7 +85,6 @@ class VortexThread : public QObject
      Configuration *configData;
      
      float* dataGaps;
-     VTD* vtd;
 
      QString vortexPath;
      QString geometry;
@@ -80,9 +109,11 @@ class VortexThread : public QObject
 
      float vtdStdDev;
      float convergingCenters;
+     bool hvvpFound;
+     int numErrorPoints;
      float rhoBar[16];
 
-     void archiveWinds(float radius,int height,int maxCoeffs, Coefficient *vtdCoeffs);
+     void archiveWinds(LevelTask& task, float radius, int maxCoeffs, Coefficient *vtdCoeffs);
      void archiveWinds(VortexData& data, float& radius,int& height,int& maxCoeffs, Coefficient *vtdCoeffs);
      // void getPressureDeficit(const float& height);
      void getPressureDeficit(VortexData* data, float* pDeficit,const float& height);
@@ -75,7 +75,8 @@ void workThread::run()
 
 	//initialize the saving path of data-list
 	_simplexList.setFilePath(workingDir.filePath(namePrefix+"simplexlist.xml"));
-	_vortexList.setFilePath(workingDir.filePath(namePrefix+"vortexlist.xml"));
+	if(!_vortexList.setFilePath(workingDir.filePath(namePrefix+"vortexlist.xml")))
+		emit log(Message(QString("Could not move the vortex coefficient store to "+_vortexList.coefficientStorePath()),0,this->objectName(),Yellow));
 	_pressureList.setFilePath(workingDir.filePath(namePrefix+"pressurelist.xml"));
 
 	if(continuePreviousRun){
@@ -102,6 +103,9 @@ void workThread::run()
 
 	bool just_display = "true" == configData->getParam(configData->getConfig("cappi"),
 							 "just_display");
+	// QC of the finished sweeps of a volume that is still streaming in
+	RadarQC *sweepQC = NULL;
+
 	// Begin working loop
 
 	while(!abort) {
@@ -114,15 +118,41 @@ void workThread::run()
 			//STEP 2: Select a volume off the queue,try to read it
 			RadarData *newVolume = dataSource->getUnprocessedData();
 			if(newVolume == NULL) {
+				// Data that is not all here yet. The sweeps of a
+				// streamed volume that are in get their QC now, then
+				// check back when the watcher sees the directory change
+				LdmLevelII *partialVolume = dataSource->getStreamVolume();
+				if((partialVolume != NULL) && !preGridded) {
+				  if(sweepQC == NULL) {
+				    sweepQC = new RadarQC(partialVolume);
+				    connect(sweepQC,SIGNAL(log(const Message&)),
+					    this,SLOT(catchLog(const Message&)));
+				    sweepQC->getConfig(configData->getConfig("qc"));
+				  }
+				  sweepQC->qcSweeps(partialVolume->getNumFinishedSweeps());
+				}
+				if(dataSource->isWaiting())
+					dataSource->waitForChange(1000);
 				continue;
 			}
 
+			// The early QC is only good for the volume it was started on
+			RadarQC *earlyQC = NULL;
+			if(sweepQC != NULL) {
+			  if(sweepQC->getRadarData() == newVolume)
+			    earlyQC = sweepQC;
+			  else
+			    delete sweepQC;
+			  sweepQC = NULL;
+			}
+
 			emit log(Message("Found file:" + newVolume->getFileName(), -1, this->objectName()));
 
 			// Check to makes sure that the file still exists and is readable
 			if((!newVolume->fileIsReadable()) or (!newVolume->readVolume())) {
 			  emit log(Message(QString("The radar data file " + newVolume->getFileName() +
 						   " is not readable"), -1, this->objectName()));
+			  delete earlyQC;
 			  delete newVolume;
 			  continue;
 			}
@@ -156,11 +186,16 @@ void workThread::run()
 			  if(abort) break;
 			} else {
 
-			  //radar data quality control
-			  RadarQC* dealiaser=new RadarQC(newVolume);
-			  connect(dealiaser,SIGNAL(log(const Message&)),
-				  this,SLOT(catchLog(const Message&)));
-			  dealiaser->getConfig(configData->getConfig("qc"));
+			  //radar data quality control, picking up from the sweeps
+			  //QC'd while the volume streamed in
+			  RadarQC* dealiaser = earlyQC;
+			  earlyQC = NULL;
+			  if(dealiaser == NULL) {
+			    dealiaser=new RadarQC(newVolume);
+			    connect(dealiaser,SIGNAL(log(const Message&)),
+				    this,SLOT(catchLog(const Message&)));
+			    dealiaser->getConfig(configData->getConfig("qc"));
+			  }
 			  dealiaser->dealias();
 			  emit log(Message("Finished QC and Dealiasing",10, this->objectName()));
 			  delete dealiaser;
@@ -265,7 +300,8 @@ void workThread::run()
 	            delete pVtd;
 
 		    if (vortexData->getMaxValidRadius() != -999) {
-		      _vortexList.append(*vortexData);
+		      if (!_vortexList.append(*vortexData))
+			emit log(Message(QString("Could not store the coefficients of this analysis, keeping them in memory"),0,this->objectName(),Yellow));
 		      QString values;
 		      QString result = "Central Pressure estimate " + values.setNum(vortexData->getPressure());
 		      result += " +/- " + values.setNum(vortexData->getPressureUncertainty()) + " hPa";
@@ -313,8 +349,8 @@ void workThread::run()
             _pressureList.saveXML();
 	    vortexData->saveCoefficients(coeffFilePath);
         } else {
-            //if there's no data, have a little rest
-            sleep(2);
+            //if there's no data, have a little rest until a file lands
+            dataSource->waitForData(2000);
             //if in batch mode, abort
             if (this->parent()){
 				std::cout<<"Finished processing all files in batch mode\n";
@@ -324,6 +360,7 @@ void workThread::run()
         }
 
 	} // while ! abort
+    delete sweepQC;
     delete dataSource;
     delete pressureSource;
 }
@@ -442,7 +479,8 @@ void workThread::checkListConsistency()
 		}
 		if(!foundMatch) {
 			emit log(Message(QString("Removing Vortex Entry @ "+_vortexList.at(vv).getTime().toString(Qt::ISODate)+" because no matching simplex was found"),0,this->objectName()));
-			_vortexList.removeAt(vv);
+			if (!_vortexList.removeAt(vv))
+			  emit log(Message(QString("Could not compact "+_vortexList.coefficientStorePath()),0,this->objectName(),Yellow));
 		}
 	}
 
@@ -461,7 +499,8 @@ void workThread::checkListConsistency()
 	// to data integrity
 	_simplexList.removeAt(_simplexList.count()-1);
 	_simplexList.saveXML();
-	_vortexList.removeAt(_vortexList.count()-1);
+	if (!_vortexList.removeAt(_vortexList.count()-1))
+	  emit log(Message(QString("Could not compact "+_vortexList.coefficientStorePath()),0,this->objectName(),Yellow));
 	_vortexList.saveXML();
 }
 
@@ -14,6 +14,7 @@
 #include <math.h>
 #include "IO/Message.h"
 #include "Math/Matrix.h"
+#include "Math/VectorTrig.h"
 
 
 GVTD::GVTD(QString& initClosure, int& wavenumbers, float*& gaps, float hvvpwind)
@@ -33,10 +34,7 @@ bool GVTD::analyzeRing(float& xCenter, float& yCenter, float& radius, float& hei
 
   // Make a Psi array
   
-  ringPsi = new float[numData];
-  vel = new float[numData];
-  psi = new float[numData];
-  float *ringDistance = new float[numData];
+  reserveRing(numData);
 
   // Get thetaT
   thetaT = atan2(yCenter,xCenter);
@@ -46,11 +44,14 @@ bool GVTD::analyzeRing(float& xCenter, float& yCenter, float& radius, float& hei
   for (int i = 0; i < numData; i++) {
     // Convert to Psi
     float angle = ringAzimuths[i] * DEG2RAD - thetaT;
-    angle = fixAngle(angle);
-    float xx = xCenter + radius * cos(angle + thetaT);
-    float yy = yCenter + radius * sin(angle + thetaT);
-    ringDistance[i] = sqrt(xx * xx + yy * yy);
-    ringPsi[i] = angle;
+    ringPsi[i] = fixAngle(angle);
+  }
+  VectorTrig::sinCos(ringPsi, ringSin, ringCos, numData);
+  for (int i = 0; i < numData; i++) {
+    // Law of cosines, the center is centerDistance from the radar and the
+    // ring point is radius from the center at angle
+    ringDistance[i] = sqrt(centerDistance * centerDistance + radius * radius
+                           + 2 * centerDistance * radius * ringCos[i]);
   }
 
   // Threshold bad values
@@ -76,53 +77,17 @@ bool GVTD::analyzeRing(float& xCenter, float& yCenter, float& radius, float& hei
     }
     vtdStdDev = -999;
     setWindCoefficients(radius, height, numCoeffs, FourierCoeffs, vtdCoeffs);
-    delete[] ringPsi;
-    delete[] vel;
-    delete[] psi;
-    delete[] ringDistance;
     return false;
   }
 
   // Least squares
-  
-  float** xLLS = new float*[numCoeffs];
-  for (int i = 0; i <= numCoeffs - 1; i++) {
-    xLLS[i] = new float[numData];
-  }
-  float* yLLS = new float[numData];
-  for (int i = 0; i <= numData - 1; i++) {
-    xLLS[0][i] = 1.;
-    for (int j = 1; j <= (numCoeffs / 2); j++) {
-      xLLS[2 * j - 1][i] = sin(float(j) * psi[i]);
-      xLLS[ 2 * j][i] = cos(float(j) * psi[i]);
-    }
-    yLLS[i] = vel[i];
-  }
-
-  float* stdError = new float[numCoeffs];
-  if( ! Matrix::lls(numCoeffs, numData, xLLS, yLLS, vtdStdDev, FourierCoeffs, stdError)) {
-    for (int i = 0; i <= numCoeffs - 1; i++)
-      delete[] xLLS[i];
-    delete[] yLLS;
-    delete[] stdError;
-    delete[] ringPsi;
-    delete[] vel;
-    delete[] psi;
+  if( ! fitFourierCoefficients(numCoeffs, numData, vtdStdDev)) {
+    //Message::toScreen("GVTD Returned Nothing from LLS");
     return false;
   }
 
   // Convert Fourier coefficients into wind coefficients
   setWindCoefficients(radius, height, numCoeffs, FourierCoeffs, vtdCoeffs);
-  
-  for (int i = 0; i <= numCoeffs - 1; i++)
-    delete[] xLLS[i];
-  
-  delete[] xLLS;
-  delete[] yLLS;
-  delete[] stdError;
-  delete[] ringPsi;
-  delete[] vel;
-  delete[] psi;
 
   return true;
 }
@@ -130,19 +95,10 @@ bool GVTD::analyzeRing(float& xCenter, float& yCenter, float& radius, float& hei
 void GVTD::setWindCoefficients(float& radius, float& level, int& numCoeffs, float*& FourierCoeffs,
 				Coefficient*& vtdCoeffs)
 {
-    // Allocate and initialize the A & B coefficient arrays
-  
-    float* A;
-    float* B;
-    int maxIndex = numCoeffs / 2 + 1;
+    // Initialize the A & B coefficient arrays from the workspace
     
-    if (maxIndex > 5) {
-        A = new float[numCoeffs / 2 + 1];
-        B = new float[numCoeffs / 2 + 1];
-    } else {
-        A = new float[5];
-        B = new float[5];
-    }
+    float* A = waveA;
+    float* B = waveB;
     for (int i=0; i <= 4; i++) {
         A[i] = 0;
         B[i] = 0;
@@ -189,14 +145,14 @@ void GVTD::setWindCoefficients(float& radius, float& level, int& numCoeffs, floa
       // Implement GVTD by Ting-Yu Cha 11/03/2017
       vtdCoeffs[0].setLevel(level);
       vtdCoeffs[0].setRadius(radius);
-      vtdCoeffs[0].setParameter("VTC0");
+      vtdCoeffs[0].setParameter(Coefficient::VTC0);
       float value;
       value = - B[1] - B[3];
       vtdCoeffs[0].setValue(value);
 
       vtdCoeffs[1].setLevel(level);
       vtdCoeffs[1].setRadius(radius);
-      vtdCoeffs[1].setParameter("VRC0");
+      vtdCoeffs[1].setParameter(Coefficient::VRC0);
       value = (A[0] + A[1] + A[2] + A[3] + A[4]) / ( 1 + radius / centerDistance);
       vtdCoeffs[1].setValue(value);
 
@@ -206,27 +162,22 @@ void GVTD::setWindCoefficients(float& radius, float& level, int& numCoeffs, floa
       for (int i=3; i <= numCoeffs - 1; i += 2) {
 	vtdCoeffs[i].setLevel(level);
 	vtdCoeffs[i].setRadius(radius);
-	QString param = "VTC" + QString().setNum(int(i / 2));
-	vtdCoeffs[i].setParameter(param);
+	vtdCoeffs[i].setParameter(Coefficient::cosineParameter(i / 2));
 	value = -2. * B[i / 2 + 1];
 	vtdCoeffs[i].setValue(value);
 
 	vtdCoeffs[i+1].setLevel(level);
 	vtdCoeffs[i+1].setRadius(radius);
-	param = "VTS" + QString().setNum(int(i / 2));
-	vtdCoeffs[i + 1].setParameter(param);
+	vtdCoeffs[i + 1].setParameter(Coefficient::sineParameter(i / 2));
 	value = 2 * A[i / 2 + 1];
 	vtdCoeffs[i + 1].setValue(value);
       }
       
       vtdCoeffs[2].setLevel(level);
       vtdCoeffs[2].setRadius(radius);
-      vtdCoeffs[2].setParameter("VMC0");
+      vtdCoeffs[2].setParameter(Coefficient::VMC0);
       value = A[0] - ( radius / centerDistance * vtdCoeffs[1].getValue() ) + 0.5 * vtdCoeffs[4].getValue();
       // rhs value is VRC0 value computed just above
       vtdCoeffs[2].setValue(value);
     }
-
-    delete[] A;
-    delete[] B;
 }
@@ -1,98 +1,277 @@
-/*
- *  GBVTD.cpp
- *  vortrac
- *
- *  Created by Michael Bell on 5/6/06.
- *  Copyright 2006 University Corporation for Atmospheric Research.
- *  All rights reserved.
- *
- */
-
-#include "VTD.h"
-#include "GBVTD.h"
-#include "GVTD.h"
-
-#include <math.h>
-#include "IO/Message.h"
-#include "Math/Matrix.h"
-
-const float VTD::PI      = 3.1415926f;
-const float VTD::DEG2RAD = PI/180.f;
-const float VTD::RAD2DEG = 180.f/PI;
-
-VTD::VTD(QString& initClosure, int& wavenumbers, float*& gaps, float hvvpwind)
-{
-    closure = initClosure;
-    _maxWaveNum = wavenumbers;
-    dataGaps = gaps;
-    FourierCoeffs = new float[_maxWaveNum * 2 + 3];
-    _hvvpMean = hvvpwind;
-}
-
-VTD::~VTD()
-{
-    // Default destructor
-    delete[] FourierCoeffs;
-}
-
-int VTD::getNumCoefficients(int& numData)
-{
-    int maxCoeffs = _maxWaveNum*2 + 3;
-    int numCoeffs = maxCoeffs;
-
-    // Find the data gaps
-    bool degreeSector[360];
-    for (int i=0; i<360; i++) degreeSector[i]=false;
-
-    for (int i=0; i<=numData-1; i++) {
-        int j = int(psi[i]*RAD2DEG);
-        if (j > 359) j = j - 360;
-        degreeSector[j] = true;
-    }
-
-    // Check the width of the gap
-    // Run completely around circle in case there is a gap at the beginning
-
-    int gapSum = 0;
-    for (int deg=0; deg<720; deg++) {
-        int j = deg%360;
-        if (degreeSector[j]) {
-            gapSum = 0;
-            if (deg >= 360) {
-                // We've come back around the circle, send back the current coefficient number
-                return numCoeffs;
-            }
-        } else {
-            gapSum++;
-            for (int i=_maxWaveNum; i>=1; i--) {
-                if (gapSum > dataGaps[i]) {
-                    // Gap is too large, reduce the number of coefficients
-                    numCoeffs = (i-1)*2 + 3;
-                }
-            }
-            if (gapSum > dataGaps[0]) {
-                // Can't even fit wavenumber zero
-                return 0;
-            }
-        }
-    }
-
-    // Shouldn't get here, if we do return 0
-    return 0;
-}
-
-float VTD::fixAngle(float& angle)
-{
-    // Make sure an angle is between 0 and 2Pi
-  
-    if (fabs(angle) < 1.0e-06) angle = 0.0;
-    if (angle > (2*PI)) angle = angle - 2*PI;
-    if (angle < 0.) angle = angle + 2*PI;
-    return angle;
-
-}
-
-void VTD::setHVVP(const float& meanWind)
-{
-    _hvvpMean = meanWind;
-}
+/*
+ *  GBVTD.cpp
+ *  vortrac
+ *
+ *  Created by Michael Bell on 5/6/06.
+ *  Copyright 2006 University Corporation for Atmospheric Research.
+ *  All rights reserved.
+ *
+ */
+
+#include "VTD.h"
+#include "GBVTD.h"
+#include "GVTD.h"
+
+#include <math.h>
+#include "IO/Message.h"
+#include "Math/Matrix.h"
+#include "Math/VectorTrig.h"
+
+const float VTD::PI      = 3.1415926f;
+const float VTD::DEG2RAD = PI/180.f;
+const float VTD::RAD2DEG = 180.f/PI;
+
+VTD::VTD(QString& initClosure, int& wavenumbers, float*& gaps, float hvvpwind)
+{
+    closure = initClosure;
+    _maxWaveNum = wavenumbers;
+    dataGaps = gaps;
+    FourierCoeffs = new float[_maxWaveNum * 2 + 3];
+    _hvvpMean = hvvpwind;
+
+    // Allocate the fit workspace once so analyzing a ring doesn't touch the heap
+    int maxCoeffs = _maxWaveNum * 2 + 3;
+    normalMatrix = new float[maxCoeffs * maxCoeffs];
+    normalRows = new float*[maxCoeffs];
+    normalRhs = new float[maxCoeffs];
+    rhsRows = new float*[maxCoeffs];
+    for (int row = 0; row < maxCoeffs; row++)
+        rhsRows[row] = normalRhs + row;
+
+    // setWindCoefficients always looks at the first 5 wavenumbers
+    int maxIndex = maxCoeffs / 2 + 1;
+    if (maxIndex < 5)
+        maxIndex = 5;
+    waveA = new float[maxIndex];
+    waveB = new float[maxIndex];
+
+    normalSolver = NULL;
+
+    ringCapacity = 0;
+    ringPsi = NULL;
+    vel = NULL;
+    psi = NULL;
+    ringDistance = NULL;
+    ringFit = NULL;
+    ringSin = NULL;
+    ringCos = NULL;
+    basisTable = NULL;
+}
+
+VTD::~VTD()
+{
+    // Default destructor
+    delete[] FourierCoeffs;
+    delete[] normalMatrix;
+    delete[] normalRows;
+    delete[] normalRhs;
+    delete[] rhsRows;
+    delete[] waveA;
+    delete[] waveB;
+    delete[] ringPsi;
+    delete[] vel;
+    delete[] psi;
+    delete[] ringDistance;
+    delete[] ringFit;
+    delete[] ringSin;
+    delete[] ringCos;
+    delete[] basisTable;
+}
+
+void VTD::reserveRing(int numData)
+{
+    if (numData <= ringCapacity)
+        return;
+
+    delete[] ringPsi;
+    delete[] vel;
+    delete[] psi;
+    delete[] ringDistance;
+    delete[] ringFit;
+    delete[] ringSin;
+    delete[] ringCos;
+    delete[] basisTable;
+    ringCapacity = numData;
+    ringPsi = new float[ringCapacity];
+    vel = new float[ringCapacity];
+    psi = new float[ringCapacity];
+    ringDistance = new float[ringCapacity];
+    ringFit = new float[ringCapacity];
+    ringSin = new float[ringCapacity];
+    ringCos = new float[ringCapacity];
+    basisTable = new float[(_maxWaveNum * 2 + 3) * ringCapacity];
+}
+
+void VTD::fourierBasis(int numCoeffs, int numData)
+{
+    // sin and cos are only evaluated for psi itself, four points at a
+    // time, and the higher wavenumbers come from the angle addition
+    // formulas
+    //   sin((j+1)psi) = sin(j psi) cos(psi) + cos(j psi) sin(psi)
+    //   cos((j+1)psi) = cos(j psi) cos(psi) - sin(j psi) sin(psi)
+    // Every loop runs over contiguous points so the compiler can vectorize
+    // it. The recurrence error grows about linearly with j, which keeps it
+    // at the size of the rounding of float(j)*psi in the direct form.
+
+    float* ones = basisTable;
+    for (int i = 0; i < numData; i++)
+        ones[i] = 1.;
+    if (numCoeffs < 3)
+        return;
+
+    float* sin1 = basisTable + ringCapacity;
+    float* cos1 = basisTable + 2 * ringCapacity;
+    VectorTrig::sinCos(psi, sin1, cos1, numData);
+
+    for (int j = 2; j <= (numCoeffs / 2); j++) {
+        const float* sinPrev = basisTable + (2 * j - 3) * ringCapacity;
+        const float* cosPrev = basisTable + (2 * j - 2) * ringCapacity;
+        float* sinJ = basisTable + (2 * j - 1) * ringCapacity;
+        float* cosJ = basisTable + (2 * j) * ringCapacity;
+        for (int i = 0; i < numData; i++) {
+            sinJ[i] = sinPrev[i] * cos1[i] + cosPrev[i] * sin1[i];
+            cosJ[i] = cosPrev[i] * cos1[i] - sinPrev[i] * sin1[i];
+        }
+    }
+}
+
+bool VTD::fitFourierCoefficients(int numCoeffs, int numData, float& stdDev)
+{
+    // Same fit as Matrix::lls with a design matrix of 1, sin(j*psi) and
+    // cos(j*psi), but the normal equations are accumulated directly from
+    // each point's basis instead of building the design matrix first.
+    // They are stored contiguously as numCoeffs x numCoeffs, and being
+    // symmetric only the lower triangle is accumulated.
+
+    if (numData < numCoeffs)
+        return false;
+
+    int n = numCoeffs;
+    for (int row = 0; row < n; row++) {
+        for (int col = 0; col < n; col++)
+            normalMatrix[row * n + col] = 0;
+        normalRhs[row] = 0;
+        FourierCoeffs[row] = 0;
+    }
+
+    // The basis is evaluated once and shared by the fit and the residual
+    fourierBasis(numCoeffs, numData);
+
+    for (int row = 0; row < n; row++) {
+        const float* basisRow = basisTable + row * ringCapacity;
+        for (int col = 0; col <= row; col++) {
+            const float* basisCol = basisTable + col * ringCapacity;
+            float sum = 0;
+            for (int i = 0; i < numData; i++)
+                sum += (basisRow[i]*basisCol[i]);
+            normalMatrix[row * n + col] = sum;
+        }
+        float rhs = 0;
+        for (int i = 0; i < numData; i++)
+            rhs += (basisRow[i]*vel[i]);
+        normalRhs[row] = rhs;
+    }
+
+    bool solved = false;
+    if (normalSolver != NULL)
+        solved = normalSolver(n, normalMatrix, normalRhs);
+    if (!solved) {
+        // No fixed size kernel, or the matrix isn't positive definite
+        for (int row = 0; row < n; row++) {
+            normalRows[row] = normalMatrix + row * n;
+            for (int col = row + 1; col < n; col++)
+                normalMatrix[row * n + col] = normalMatrix[col * n + row];
+        }
+        if (!Matrix::gaussJordan(normalRows, rhsRows, n, 1))
+            return false;
+    }
+
+    for (int row = 0; row < numCoeffs; row++)
+        FourierCoeffs[row] = normalRhs[row];
+
+    // Standard deviation of the fit
+    for (int i = 0; i < numData; i++)
+        ringFit[i] = 0;
+    for (int j = 0; j < numCoeffs; j++) {
+        const float* basisRow = basisTable + j * ringCapacity;
+        for (int i = 0; i < numData; i++)
+            ringFit[i] += FourierCoeffs[j]*basisRow[i];
+    }
+    float sum = 0;
+    for (int i = 0; i < numData; i++)
+        sum += ((vel[i]-ringFit[i])*(vel[i]-ringFit[i]));
+
+    if (numData != numCoeffs)
+        stdDev = sqrt(sum/float(numData-long(numCoeffs)));
+    else
+        stdDev = sqrt(sum);
+
+    return true;
+}
+
+int VTD::getNumCoefficients(int& numData)
+{
+    int maxCoeffs = _maxWaveNum*2 + 3;
+    int numCoeffs = maxCoeffs;
+
+    // Find the data gaps
+    bool degreeSector[360];
+    for (int i=0; i<360; i++) degreeSector[i]=false;
+
+    for (int i=0; i<=numData-1; i++) {
+        int j = int(psi[i]*RAD2DEG);
+        if (j > 359) j = j - 360;
+        degreeSector[j] = true;
+    }
+
+    // Check the width of the gap
+    // Run completely around circle in case there is a gap at the beginning
+
+    int gapSum = 0;
+    for (int deg=0; deg<720; deg++) {
+        int j = deg%360;
+        if (degreeSector[j]) {
+            gapSum = 0;
+            if (deg >= 360) {
+                // We've come back around the circle, send back the current coefficient number
+                return numCoeffs;
+            }
+        } else {
+            gapSum++;
+            for (int i=_maxWaveNum; i>=1; i--) {
+                if (gapSum > dataGaps[i]) {
+                    // Gap is too large, reduce the number of coefficients
+                    numCoeffs = (i-1)*2 + 3;
+                }
+            }
+            if (gapSum > dataGaps[0]) {
+                // Can't even fit wavenumber zero
+                return 0;
+            }
+        }
+    }
+
+    // Shouldn't get here, if we do return 0
+    return 0;
+}
+
+float VTD::fixAngle(float& angle)
+{
+    // Make sure an angle is between 0 and 2Pi
+  
+    if (fabs(angle) < 1.0e-06) angle = 0.0;
+    if (angle > (2*PI)) angle = angle - 2*PI;
+    if (angle < 0.) angle = angle + 2*PI;
+    return angle;
+
+}
+
+void VTD::setHVVP(const float& meanWind)
+{
+    _hvvpMean = meanWind;
+}
+
+void VTD::setNormalSolver(NormalSolver solver)
+{
+    normalSolver = solver;
+}
@@ -12,6 +12,7 @@
 
 #include <QString>
 #include "DataObjects/Coefficient.h"
+#include "Math/SmallMatrix.h"
 
 class VTD
 {
@@ -36,10 +37,24 @@ class VTD
     
   void setHVVP(const float& meanWind);
 
+  // Fixed size normal equation solver, Gauss-Jordan is used without one
+  void setNormalSolver(NormalSolver solver);
+
   int   getNumCoefficients(int& numData);
   float fixAngle(float& angle);
 
  protected:
+
+  // Make sure the ring workspace holds at least numData points
+  void reserveRing(int numData);
+
+  // Least squares fit of FourierCoeffs to vel at psi for the first
+  // numData points, using only the preallocated workspace
+  bool fitFourierCoefficients(int numCoeffs, int numData, float& stdDev);
+
+  // Fill basisTable with 1, sin(j*psi) and cos(j*psi) for the first
+  // numData points
+  void fourierBasis(int numCoeffs, int numData);
     
   static const float PI     ;
   static const float DEG2RAD;
@@ -60,6 +75,29 @@ class VTD
 
   float _hvvpMean;
 
+  // Workspace reused by every ring. The ring arrays grow to the largest
+  // ring seen; everything else is sized for _maxWaveNum up front.
+  int    ringCapacity;
+  float* ringDistance;
+  float* ringFit;
+  // sin and cos of each ring point's angle, see Math/VectorTrig.h
+  float* ringSin;
+  float* ringCos;
+  // One row of ringCapacity points per coefficient
+  float* basisTable;
+  float* normalMatrix;
+  float** normalRows;
+  float* normalRhs;
+  float** rhsRows;
+  float* waveA;
+  float* waveB;
+  NormalSolver normalSolver;
+
+ private:
+  // The workspace is owned by the object, don't allow copies
+  VTD(const VTD&);
+  VTD& operator=(const VTD&);
+
 };
 
 #endif
@@ -7,13 +7,18 @@
 VTD *VTDFactory::createVTD(QString& initGeometry, QString& initClosure,
 			   int& waveNumbers, float*& gaps, float hvvpWind)
 {
+  VTD *vtd = NULL;
   if (initGeometry == "GBVTD")
-    return new GBVTD(initClosure, waveNumbers, gaps, hvvpWind);
+    vtd = new GBVTD(initClosure, waveNumbers, gaps, hvvpWind);
   else if (initGeometry == "GVTD")
-    return new GVTD(initClosure, waveNumbers, gaps, hvvpWind);
+    vtd = new GVTD(initClosure, waveNumbers, gaps, hvvpWind);
   else
     std::cerr << "Unsupported geometry " << initGeometry.toLatin1().data() << std::endl;
-  
-  return NULL;
+
+  // Use the fixed size least squares kernels when maxWave has them
+  if (vtd != NULL)
+    vtd->setNormalSolver(SmallMatrix::normalSolver(waveNumbers));
+
+  return vtd;
 }
 
@@ -31,16 +31,15 @@ float MGBVTD::computeCrossBeamWind(float guessMax, QString& velField, GBVTD* gbv
 	std::vector<float> vt_rng;
 	//1. compute the radial profile of symmetric tangential wind  
 	for(float rng=m_rmw*1.2; rng<=.6*Rt; rng+=1.){
-		m_cappi.setCartesianReferencePoint(m_centerx, m_centery, m_centerz);
-		int numData = m_cappi.getCylindricalAzimuthLength(rng, m_centerz);
+		RingQuery center = m_cappi.getCartesianRingQuery(m_centerx, m_centery, m_centerz);
+		int numData = m_cappi.getCylindricalAzimuthLength(center, rng, m_centerz);
 		float* ringData = new float[numData];
 		float* ringAzi  = new float[numData];
-		m_cappi.getCylindricalAzimuthData(velField, numData, rng, m_centerz, ringData);
-        m_cappi.getCylindricalAzimuthPosition(numData, rng, m_centerz, ringAzi);
+		m_cappi.getCylindricalAzimuthRing(center, velField, numData, rng, m_centerz, ringData, ringAzi);
 		Coefficient* coeff = new Coefficient[20];
 		float vtdDev;
 		if(gbvtd->analyzeRing(m_centerx, m_centery, rng, m_centerz, numData, ringData, ringAzi, coeff, vtdDev)){
-			if(coeff[0].getParameter()=="VTC0"){
+			if(coeff[0].getParameterIndex()==Coefficient::VTC0){
 				vt.push_back(coeff[0].getValue());
 				vt_rng.push_back(rng);
 			}
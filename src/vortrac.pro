@@ -42,6 +42,7 @@ HEADERS += Threads/workThread.h \
            IO/Message.h \
            IO/Log.h \
            IO/ATCF.h \
+           IO/DirectoryWatcher.h \
            Radar/DateChecker.h \
            Radar/RadarFactory.h \
            Radar/LevelII.h \
@@ -55,12 +56,16 @@ HEADERS += Threads/workThread.h \
            Radar/RadarData.h \
            Radar/Ray.h \
            Radar/Sweep.h \
+           Radar/GateGeometry.h \
            VTD/VTD.h \
            VTD/GVTD.h \
            VTD/GBVTD.h \
            VTD/mgbvtd.h \
            VTD/VTDFactory.h \
            Math/Matrix.h \
+           Math/SmallMatrix.h \
+           Math/RunningMedian.h \
+           Math/VectorTrig.h \
            ChooseCenter.h \
            Pressure/PressureData.h \
            Pressure/PressureList.h \
@@ -107,6 +112,7 @@ SOURCES += main.cpp \
            IO/Message.cpp \
            IO/Log.cpp \
            IO/ATCF.cpp \
+           IO/DirectoryWatcher.cpp \
            Radar/DateChecker.cpp \
            Radar/RadarFactory.cpp \
            Radar/LevelII.cpp \
@@ -119,6 +125,7 @@ SOURCES += main.cpp \
            Radar/RadarData.cpp \
            Radar/Ray.cpp \
            Radar/Sweep.cpp \
+           Radar/GateGeometry.cpp \
            VTD/VTD.cpp \
            VTD/GVTD.cpp \
            VTD/GBVTD.cpp \
@@ -140,6 +147,9 @@ SOURCES += main.cpp \
 RESOURCES += vortrac.qrc
 # LIBS += -ludunits2 -lRadx -lbz2 -larmadillo -lhdf5_cpp -lnetcdf_c++
 LIBS += -lbz2 -larmadillo  -L/usr/local/lib -ludunits2 -lRadx -lnetcdf_c++ -lhdf5_cpp -lNcxx
-QT += xml network widgets
+QT += xml network widgets concurrent
 CONFIG += debug
+# Debug builds keep their symbols but are optimized, the analysis kernels
+# (VTD ring fits, Math/VectorTrig.h) are far too slow at -O0
+QMAKE_CXXFLAGS_DEBUG += -O2
 #CONFIG -= app_bundle